@@ -15,6 +15,124 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 #include "devices/PCI.h"
+#include "kernel/MemoryManager.h"
+#include "machine/APIC.h"
+
+uint8_t PCI::findCapability(const PCIDevice& pd, uint8_t id, uint8_t prev) {
+  if (!prev) {
+    if (!CapabilitiesList.get(Status(pd))) return 0;
+    prev = Capabilities(pd);
+  } else {
+    prev = readConfig<8>(pd, prev + 1);
+  }
+  for (int n = 0; prev && n < 48; n += 1) {        // bound malformed lists
+    prev &= 0xfc;
+    if (readConfig<8>(pd, prev) == id) return prev;
+    prev = readConfig<8>(pd, prev + 1);
+  }
+  return 0;
+}
+
+// MSI-X table entry: message address (low/high), data, vector control
+static const mword MsixEntrySize = 16;
+static const BitString<uint16_t, 0,11> MsixTableSize; // N-1
+static const BitString<uint16_t,14, 1> MsixFunctionMask;
+static const BitString<uint16_t,15, 1> MsixEnable;
+
+// MSI message control
+static const BitString<uint16_t, 0, 1> MsiEnable;
+static const BitString<uint16_t, 4, 3> MsiMultipleEnable;
+static const BitString<uint16_t, 7, 1> Msi64Bit;
+static const BitString<uint16_t, 8, 1> MsiPerVectorMask;
+
+static void disableLegacyIrq(const PCIDevice& pd) {
+  PCI::Command c(pd);
+  PCI::Command::write(pd, uint32_t(c | PCI::InterruptDisable()));
+}
+
+uint16_t PCI::msixCount(const PCIDevice& pd) {
+  uint8_t cap = findCapability(pd, CapMSIX);
+  if (!cap) return 0;
+  return MsixTableSize.get(readConfig<16>(pd, cap + 2)) + 1;
+}
+
+vaddr PCI::msixEnable(const PCIDevice& pd) {
+  uint8_t cap = findCapability(pd, CapMSIX);
+  KASSERT0(cap);
+  uint16_t ctrl = readConfig<16>(pd, cap + 2);
+  mword count = MsixTableSize.get(ctrl) + 1;
+  uint32_t tab = readConfig<32>(pd, cap + 4);           // offset | BAR index
+  paddr addr = pd.getBARAddress(tab & 0x7) + (tab & ~uint32_t(0x7));
+  KASSERT1(addr > (tab & ~uint32_t(0x7)), FmtHex(tab)); // memory BAR
+  paddr start = align_down(addr, pagesize<1>());
+  size_t size = align_up(addr + count * MsixEntrySize, pagesize<1>()) - start;
+  vaddr table = MemoryManager::map(size, start);
+  KASSERT0(table != topaddr);
+  table += addr - start;
+  // mask function while setting up entries, then mask each entry
+  writeConfig<16>(pd, cap + 2, ctrl | MsixFunctionMask() | MsixEnable());
+  for (mword i = 0; i < count; i += 1) {
+    volatile uint32_t* e = (volatile uint32_t*)(table + i * MsixEntrySize);
+    e[3] = e[3] | 0x1;
+  }
+  disableLegacyIrq(pd);
+  writeConfig<16>(pd, cap + 2, (ctrl | MsixEnable()) & ~MsixFunctionMask());
+  DBG::outl(DBG::PCI, "MSI-X: ", FmtHex(pd.getBus(),2), '/', FmtHex(pd.getDevice(),2), '/',
+    FmtHex(pd.getFunction(),2), " entries: ", count, " table: ", FmtHex(addr));
+  return table;
+}
+
+// multiple-message MSI shares one target (and needs an aligned vector
+// block), which defeats per-core steering -> single message only
+bool PCI::msiEnable(const PCIDevice& pd) {
+  uint8_t cap = findCapability(pd, CapMSI);
+  if (!cap) return false;
+  uint16_t ctrl = readConfig<16>(pd, cap + 2);
+  ctrl &= ~(MsiEnable() | MsiMultipleEnable());
+  writeConfig<16>(pd, cap + 2, ctrl);
+  disableLegacyIrq(pd);
+  DBG::outl(DBG::PCI, "MSI: ", FmtHex(pd.getBus(),2), '/', FmtHex(pd.getDevice(),2), '/',
+    FmtHex(pd.getFunction(),2), (Msi64Bit.get(ctrl) ? " 64-bit" : " 32-bit"),
+    (MsiPerVectorMask.get(ctrl) ? " maskable" : ""));
+  return true;
+}
+
+void MsiSource::program(uint8_t vector, uint8_t apicID) {
+  uint32_t addr = APIC::msiAddress(apicID);
+  uint32_t data = APIC::msiData(vector);
+  if (table) {
+    volatile uint32_t* e = (volatile uint32_t*)(table + entry * MsixEntrySize);
+    e[3] = e[3] | 0x1;                    // mask during update
+    e[0] = addr;
+    e[1] = 0;
+    e[2] = data;
+    e[3] = e[3] & ~uint32_t(0x1);         // pending message delivered now
+  } else {
+    uint16_t ctrl = PCI::readConfig<16>(dev, cap + 2);
+    uint8_t dataOff = Msi64Bit.get(ctrl) ? 12 : 8;
+    bool maskable = MsiPerVectorMask.get(ctrl);
+    if (maskable) PCI::writeConfig<32>(dev, cap + dataOff + 4, 1);
+    // otherwise: a message is sent with either the old or the new address
+    PCI::writeConfig<32>(dev, cap + 4, addr);
+    if (Msi64Bit.get(ctrl)) PCI::writeConfig<32>(dev, cap + 8, 0);
+    PCI::writeConfig<16>(dev, cap + dataOff, data);
+    if (maskable) PCI::writeConfig<32>(dev, cap + dataOff + 4, 0);
+    PCI::writeConfig<16>(dev, cap + 2, ctrl | MsiEnable());
+  }
+}
+
+// MSI without per-vector masking: disable; messages are lost meanwhile
+void MsiSource::mask() {
+  if (table) {
+    volatile uint32_t* e = (volatile uint32_t*)(table + entry * MsixEntrySize);
+    e[3] = e[3] | 0x1;
+  } else {
+    uint16_t ctrl = PCI::readConfig<16>(dev, cap + 2);
+    uint8_t dataOff = Msi64Bit.get(ctrl) ? 12 : 8;
+    if (MsiPerVectorMask.get(ctrl)) PCI::writeConfig<32>(dev, cap + dataOff + 4, 1);
+    else PCI::writeConfig<16>(dev, cap + 2, ctrl & ~MsiEnable());
+  }
+}
 
 // handle multiple PCI host controllers
 void PCI::checkAllBuses(list<PCIDevice>& pciDevList) {
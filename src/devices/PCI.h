@@ -37,6 +37,22 @@ public:
   uint8_t getFunction() const { return func; }
   uint8_t getIrq() const { return irq; }
   inline uint32_t getBARSize(uint8_t idx) const;
+  inline paddr getBARAddress(uint8_t idx) const;
+};
+
+// One message-signalled interrupt: the MSI capability of a device or one
+// entry of its MSI-X table.  The message encodes vector and target APIC,
+// so each source can be retargeted by rewriting it.
+class MsiSource {
+  PCIDevice dev;
+  uint8_t   cap;          // config space offset of MSI/MSI-X capability
+  uint16_t  entry;        // MSI-X table index
+  vaddr     table;        // mapped MSI-X table, 0 for MSI
+public:
+  MsiSource(const PCIDevice& d, uint8_t c, uint16_t e = 0, vaddr t = 0)
+  : dev(d), cap(c), entry(e), table(t) {}
+  void program(uint8_t vector, uint8_t apicID); // write message & unmask
+  void mask();
 };
 
 namespace PCI {
@@ -181,6 +197,20 @@ namespace PCI {
 
   // BridgeCardbus registers - not needed
 
+  // capability list: offset of next capability 'id' after 'prev', 0 if none
+  uint8_t findCapability(const PCIDevice& pd, uint8_t id, uint8_t prev = 0);
+
+  // message-signalled interrupts, cf. PCI Local Bus Spec 3.0, Section 6.8
+  static const uint8_t CapMSI  = 0x05;
+  static const uint8_t CapMSIX = 0x11;
+
+  // MSI-X: table size (0 if not supported); set up table with all entries
+  // masked, enable MSI-X, and disable legacy interrupts; returns table
+  uint16_t msixCount(const PCIDevice& pd);
+  vaddr msixEnable(const PCIDevice& pd);
+  // MSI: single message (masked, if supported); disables legacy interrupts
+  bool msiEnable(const PCIDevice& pd);
+
   void checkAllBuses(list<PCIDevice>& pciDevList);
   void checkBus(uint8_t bus, list<PCIDevice>& pciDevList);
   void checkDevice(uint8_t bus, uint8_t dev, list<PCIDevice>& pciDevList);
@@ -195,4 +225,13 @@ uint32_t PCIDevice::getBARSize(uint8_t idx) const {
   return ~mask + 1;                        // compute & return size
 }
 
+// memory BARs only, 0 for I/O space
+paddr PCIDevice::getBARAddress(uint8_t idx) const {
+  uint32_t bar = PCI::BAR(*this,idx);
+  if (bar & 0x1) return 0;
+  paddr addr = bar & 0xfffffff0;
+  if (((bar & 0x6) >> 1) == 0x02) addr += paddr(PCI::BAR(*this,idx+1)) << 32;
+  return addr;
+}
+
 #endif /* _PCI_h_ */
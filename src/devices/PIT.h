@@ -2,8 +2,8 @@
 #define _PIT_h_ 1
 
 class PIT {
-  static const int frequency = 1000;
 public:
+  static const int frequency = 1000;
   void init()                                          __section(".boot.text");
 };
 
@@ -26,6 +26,7 @@ class DebugDevice : public NoObject {
   static void init() { valid = (CPU::in8(0xE9) == 0xE9); }
 public:
   static inline void write(char c);
+  static inline void write(const char* s, size_t n);
 };
 
 static const int maxSerial = 2;
@@ -58,12 +59,25 @@ public:
     while ((CPU::in8(SerialPort[idx] + 5) & 1) == 0);
     return CPU::in8(SerialPort[idx]);
   }
+  // fill the 16-byte transmit FIFO per status poll
+  static void write(const char* s, size_t n, uint16_t idx = 0) {
+    for (size_t i = 0; i < n; ) {
+      while ((CPU::in8(SerialPort[idx] + 5) & 0x20) == 0);
+      for (int f = 0; f < 15 && i < n; f += 1, i += 1) {
+        CPU::out8(SerialPort[idx], s[i]);
+        if (s[i] == '\n') { CPU::out8(SerialPort[idx], '\r'); f += 1; }
+      }
+    }
+  }
   static void dbgwrite(char c) {
     for (uint16_t idx = gdb ? 1 : 0; idx < maxSerial; idx += 1) {
       write(c, idx);
       if (c == '\n') write('\r', idx);
     }
   }
+  static void dbgwrite(const char* s, size_t n) {
+    for (uint16_t idx = gdb ? 1 : 0; idx < maxSerial; idx += 1) write(s, n, idx);
+  }
 };
 
 void DebugDevice::write(char c) {
@@ -71,4 +85,9 @@ void DebugDevice::write(char c) {
   SerialDevice::dbgwrite(c);
 }
 
+void DebugDevice::write(const char* s, size_t n) {
+  if (valid) CPU::outs8(0xE9, s, n);
+  SerialDevice::dbgwrite(s, n);
+}
+
 #endif /* _Serial_h_ */
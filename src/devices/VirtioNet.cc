@@ -0,0 +1,496 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "runtime/Thread.h"
+#include "kernel/IrqPoll.h"
+#include "kernel/MemoryManager.h"
+#include "kernel/Output.h"
+#include "machine/Machine.h"
+#include "machine/Paging.h"
+#include "machine/Processor.h"
+#include "devices/PCI.h"
+#include "devices/VirtioNet.h"
+#include "uio.h"
+
+#include "lwip/netif.h"
+
+#include <cstring>
+
+extern netif* lwip_add_netif(ptr_t device, const uint8_t* mac, int (*send)(ptr_t, ptr_t, size_t, const netif_tx_offload*), uint8_t offload);
+extern void lwip_net_receive_iov(netif*, const struct iovec* iov, size_t cnt, bool csumValid);
+
+// PCI capabilities (section 4.1.4)
+enum : uint8_t {
+  VendorCap = 0x09,
+  CommonCfg = 1,
+  NotifyCfg = 2,
+  IsrCfg    = 3,
+  DeviceCfg = 4,
+};
+
+// struct virtio_pci_common_cfg
+enum : mword {
+  DeviceFeatureSelect = 0,
+  DeviceFeature       = 4,
+  DriverFeatureSelect = 8,
+  DriverFeature       = 12,
+  MsixConfig          = 16,
+  NumQueues           = 18,
+  DeviceStatus        = 20,
+  ConfigGeneration    = 21,
+  QueueSelect         = 22,
+  QueueSize           = 24,
+  QueueMsixVector     = 26,
+  QueueEnable         = 28,
+  QueueNotifyOff      = 30,
+  QueueDesc           = 32,
+  QueueDriver         = 40,
+  QueueDevice         = 48,
+};
+
+enum : uint8_t {
+  Acknowledge = 1,
+  Driver      = 2,
+  DriverOk    = 4,
+  FeaturesOk  = 8,
+  Failed      = 128,
+};
+
+static const uint16_t NoVector = 0xffff;
+
+// struct virtio_net_config
+static const mword ConfigMac = 0;
+static const mword ConfigMaxPairs = 8;
+
+static vaddr mapRegion(paddr addr, size_t len) {
+  paddr start = align_down(addr, pagesize<1>());
+  size_t size = align_up(addr + len, pagesize<1>()) - start;
+  vaddr v = MemoryManager::map(size, start);
+  KASSERT0(v != topaddr);
+  return v + (addr - start);
+}
+
+void VirtQueue::init(uint16_t idx, uint16_t sz, paddr& pdesc, paddr& pavail, paddr& pused) {
+  index = idx;
+  size = sz;
+  size_t availOff = sizeof(Desc) * sz;
+  size_t usedOff = align_up(availOff + sizeof(Avail) + sizeof(uint16_t) * (sz + 1), size_t(64));
+  size_t total = usedOff + sizeof(Used) + sizeof(UsedElem) * sz + sizeof(uint16_t);
+  vaddr mem = MemoryManager::allocContig(total, pagesize<1>(), topaddr);
+  memset((ptr_t)mem, 0, total);
+  paddr phys = Paging::vtop(mem);
+  desc = (Desc*)mem;
+  avail = (Avail*)(mem + availOff);
+  used = (Used*)(mem + usedOff);
+  pdesc = phys;
+  pavail = phys + availOff;
+  pused = phys + usedOff;
+  for (uint16_t i = 0; i < sz; i += 1) desc[i].next = i + 1;
+  freeHead = 0;
+  numFree = sz;
+  availIdx = lastUsed = 0;
+}
+
+int VirtQueue::allocDesc() {
+  if (numFree == 0) return -1;
+  uint16_t id = freeHead;
+  freeHead = desc[id].next;
+  numFree -= 1;
+  return id;
+}
+
+void VirtQueue::freeDesc(uint16_t id) {
+  desc[id].next = freeHead;
+  freeHead = id;
+  numFree += 1;
+}
+
+void VirtQueue::freeChain(uint16_t id) {
+  for (;;) {
+    uint16_t flags = desc[id].flags;
+    uint16_t next = desc[id].next;
+    freeDesc(id);
+    if (!(flags & DescNext)) return;
+    id = next;
+  }
+}
+
+// the device sets 'UsedNoNotify' while it is processing the queue anyway
+void VirtQueue::kick() {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (!(used->flags & UsedNoNotify)) *notifyAddr = index;
+}
+
+void VirtioNet::setStatus(uint8_t s) {
+  writeCommon<uint8_t>(DeviceStatus, readCommon<uint8_t>(DeviceStatus) | s);
+}
+
+// use the first usable capability of each type
+bool VirtioNet::mapCapabilities(const PCIDevice& pd) {
+  for (uint8_t cap = PCI::findCapability(pd, VendorCap); cap; cap = PCI::findCapability(pd, VendorCap, cap)) {
+    uint8_t type = PCI::readConfig<8>(pd, cap + 3);
+    uint8_t bar = PCI::readConfig<8>(pd, cap + 4);
+    uint32_t offset = PCI::readConfig<32>(pd, cap + 8);
+    uint32_t length = PCI::readConfig<32>(pd, cap + 12);
+    if (bar > 5 || type < CommonCfg || type > DeviceCfg) continue;
+    paddr base = pd.getBARAddress(bar);
+    if (!base) continue;
+    switch (type) {
+      case CommonCfg: if (!common) common = (uint8_t*)mapRegion(base + offset, length); break;
+      case IsrCfg:    if (!isr) isr = (uint8_t*)mapRegion(base + offset, length); break;
+      case DeviceCfg: if (!config) config = (uint8_t*)mapRegion(base + offset, length); break;
+      case NotifyCfg:
+        if (!notifyBase) {
+          notifyBase = mapRegion(base + offset, length);
+          notifyMult = PCI::readConfig<32>(pd, cap + 16);
+        }
+        break;
+    }
+  }
+  return common && isr && config && notifyBase;
+}
+
+bool VirtioNet::negotiate() {
+  writeCommon<uint32_t>(DeviceFeatureSelect, 0);
+  uint64_t offered = readCommon<uint32_t>(DeviceFeature);
+  writeCommon<uint32_t>(DeviceFeatureSelect, 1);
+  offered |= uint64_t(readCommon<uint32_t>(DeviceFeature)) << 32;
+  features = offered & Wanted;
+  if (!(features & F_VERSION_1)) return false;      // legacy-only device
+  if (!(features & F_CTRL_VQ)) features &= ~F_MQ;
+  if (!(features & F_CSUM)) features &= ~F_HOST_TSO4; // spec: depends on CSUM
+  writeCommon<uint32_t>(DriverFeatureSelect, 0);
+  writeCommon<uint32_t>(DriverFeature, features);
+  writeCommon<uint32_t>(DriverFeatureSelect, 1);
+  writeCommon<uint32_t>(DriverFeature, features >> 32);
+  setStatus(FeaturesOk);
+  return readCommon<uint8_t>(DeviceStatus) & FeaturesOk;
+}
+
+bool VirtioNet::setupQueue(VirtQueue& vq, uint16_t idx, uint16_t vector) {
+  writeCommon<uint16_t>(QueueSelect, idx);
+  uint16_t size = readCommon<uint16_t>(QueueSize);
+  if (size == 0) return false;
+  if (size > MaxQueueSize) {
+    size = MaxQueueSize;
+    writeCommon<uint16_t>(QueueSize, size);
+  }
+  paddr pdesc, pavail, pused;
+  vq.init(idx, size, pdesc, pavail, pused);
+  // 64-bit fields written as two 32-bit halves, see section 4.1.3.1
+  writeCommon<uint32_t>(QueueDesc, pdesc);
+  writeCommon<uint32_t>(QueueDesc + 4, pdesc >> 32);
+  writeCommon<uint32_t>(QueueDriver, pavail);
+  writeCommon<uint32_t>(QueueDriver + 4, pavail >> 32);
+  writeCommon<uint32_t>(QueueDevice, pused);
+  writeCommon<uint32_t>(QueueDevice + 4, pused >> 32);
+  writeCommon<uint16_t>(QueueMsixVector, vector);
+  if (readCommon<uint16_t>(QueueMsixVector) != vector) return false;
+  uint16_t off = readCommon<uint16_t>(QueueNotifyOff);
+  vq.setNotify((volatile uint16_t*)(notifyBase + off * notifyMult));
+  writeCommon<uint16_t>(QueueEnable, 1);
+  return true;
+}
+
+// VIRTIO_NET_CTRL_MQ / VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, polled at boot
+bool VirtioNet::setPairs(mword n) {
+  ctrlBuf[0] = 4;
+  ctrlBuf[1] = 0;
+  *(uint16_t*)(ctrlBuf + 2) = n;
+  ctrlBuf[8] = 0xff;
+  int cmd = ctrl.allocDesc();
+  int ack = ctrl.allocDesc();
+  KASSERT0(cmd >= 0 && ack >= 0);
+  volatile VirtQueue::Desc& dc = ctrl.getDesc(cmd);
+  volatile VirtQueue::Desc& da = ctrl.getDesc(ack);
+  dc.addr = ctrlPhys;
+  dc.len = 4;
+  dc.flags = VirtQueue::DescNext;
+  dc.next = ack;
+  da.addr = ctrlPhys + 8;
+  da.len = 1;
+  da.flags = VirtQueue::DescWrite;
+  ctrl.post(cmd);
+  ctrl.publish();
+  ctrl.kick();
+  for (mword spin = 0; !ctrl.pending(); spin += 1) {
+    if (spin > (1 << 26)) return false;            // leave descriptors in use
+    CPU::Pause();
+  }
+  ctrl.consume();
+  ctrl.freeDesc(ack);
+  ctrl.freeDesc(cmd);
+  return __atomic_load_n(&ctrlBuf[8], __ATOMIC_ACQUIRE) == 0;
+}
+
+// descriptor i permanently refers to buffer i
+void VirtioNet::fillRx(QueuePair& q) {
+  for (uint16_t i = 0; i < q.rx.getSize(); i += 1) {
+    volatile VirtQueue::Desc& d = q.rx.getDesc(i);
+    d.addr = q.rxPhys + i * BufferSize;
+    d.len = BufferSize;
+    d.flags = VirtQueue::DescWrite;
+    q.rx.post(i);
+  }
+  q.rx.publish();
+}
+
+// the device publishes all buffers of a merged frame at once, so a
+// frame cut short by an empty used ring is malformed and dropped
+size_t VirtioNet::receive(QueuePair& q, size_t budget) {
+  size_t done = 0;
+  while (done < budget && q.rx.pending()) {
+    VirtQueue::UsedElem e = q.rx.consume();
+    Header* h = (Header*)(q.rxBuf + e.id * BufferSize);
+    size_t cnt = (features & F_MRG_RXBUF) ? max(size_t(h->numBuffers), size_t(1)) : 1;
+    bool drop = e.len < sizeof(Header) || cnt > MaxMerge;
+    uint16_t ids[MaxMerge];
+    struct iovec iov[MaxMerge];
+    size_t n = 0;
+    for (;;) {
+      if (n < MaxMerge) {
+        ids[n] = e.id;
+        iov[n].iov_base = q.rxBuf + e.id * BufferSize;
+        iov[n].iov_len = e.len;
+      } else {
+        q.rx.post(e.id);
+      }
+      n += 1;
+      if (n == cnt || !q.rx.pending()) break;
+      e = q.rx.consume();
+    }
+    if (n < cnt) drop = true;
+    n = min(n, MaxMerge);
+    if (!drop) {
+      iov[0].iov_base = (uint8_t*)iov[0].iov_base + sizeof(Header);
+      iov[0].iov_len -= sizeof(Header);
+      // a partial checksum (NEEDS_CSUM) comes from a local sender and,
+      // like a validated one, need not be checked by lwIP
+      bool csumValid = h->flags & (HdrNeedsCsum | HdrDataValid);
+      lwip_net_receive_iov(nif, iov, n, csumValid);   // copies
+    }
+    for (size_t i = 0; i < n; i += 1) q.rx.post(ids[i]);
+    done += 1;
+  }
+  if (done) {
+    q.rx.publish();
+    q.rx.kick();
+  }
+  return done;
+}
+
+// interrupt context; reading ISR acknowledges and deasserts INTx
+int VirtioNet::mask(VirtioNet* vn) {
+  uint8_t status = *vn->isr;
+  if (!(status & 1)) return 0;                      // config change or other device
+  for (mword i = 0; i < vn->pairs; i += 1) vn->qp[i].rx.suppress(true);
+  return 1;
+}
+
+size_t VirtioNet::pollRx(VirtioNet* vn, size_t budget) {
+  size_t done = 0;
+  for (mword i = 0; i < vn->pairs && done < budget; i += 1) {
+    done += vn->receive(vn->qp[(vn->rxStart + i) % vn->pairs], budget - done);
+  }
+  vn->rxStart = (vn->rxStart + 1) % vn->pairs;
+  return done;
+}
+
+// suppression is checked by the device before it raises an interrupt:
+// frames that arrived in between must be picked up here
+void VirtioNet::unmask(VirtioNet* vn) {
+  for (mword i = 0; i < vn->pairs; i += 1) vn->qp[i].rx.suppress(false);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (mword i = 0; i < vn->pairs; i += 1) {
+    if (vn->qp[i].rx.pending()) {
+      for (mword j = 0; j < vn->pairs; j += 1) vn->qp[j].rx.suppress(true);
+      vn->poll->schedule();
+      return;
+    }
+  }
+}
+
+// MSI-X: edge-triggered and not shared
+int VirtioNet::maskQueue(QueuePair* q) {
+  q->rx.suppress(true);
+  return 1;
+}
+
+size_t VirtioNet::pollQueue(QueuePair* q, size_t budget) {
+  return q->vn->receive(*q, budget);
+}
+
+void VirtioNet::unmaskQueue(QueuePair* q) {
+  q->rx.suppress(false);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (q->rx.pending()) {
+    q->rx.suppress(true);
+    q->poll->schedule();
+  }
+}
+
+// transmit queue by core; completed descriptors are reclaimed here.  The
+// header and frame are copied into a chain of buffers, more than one only
+// for TSO segments.
+int VirtioNet::send(VirtioNet* vn, ptr_t buffer, size_t size, const netif_tx_offload* off) {
+  QueuePair& q = vn->qp[LocalProcessor::getIndex() % vn->pairs];
+  if ((!off || !off->mss) && size > BufferSize - sizeof(Header)) size = BufferSize - sizeof(Header);
+  size_t total = sizeof(Header) + size;
+  size_t cnt = divup(total, BufferSize);
+  ScopedLock<> sl(q.txLock);
+  while (q.tx.pending()) q.tx.freeChain(q.tx.consume().id);
+  if (q.tx.getFree() < cnt) return -1;
+  Header h;
+  memset(&h, 0, sizeof(Header));
+  if (off) {
+    h.flags = HdrNeedsCsum;
+    h.csumStart = off->csum_start;
+    h.csumOffset = off->csum_offset;
+    if (off->mss) {
+      h.gsoType = GsoTcpV4;
+      h.hdrLen = off->hdr_len;
+      h.gsoSize = off->mss;
+    }
+  }
+  int head = -1;
+  volatile VirtQueue::Desc* prev = nullptr;
+  for (size_t done = 0; done < total; done += BufferSize) {
+    int id = q.tx.allocDesc();
+    KASSERT0(id >= 0);
+    uint8_t* buf = q.txBuf + id * BufferSize;
+    size_t len = min(total - done, BufferSize);
+    if (done == 0) {
+      memcpy(buf, &h, sizeof(Header));
+      memcpy(buf + sizeof(Header), buffer, len - sizeof(Header));
+      head = id;
+    } else {
+      memcpy(buf, (uint8_t*)buffer + done - sizeof(Header), len);
+      prev->flags = VirtQueue::DescNext;
+      prev->next = id;
+    }
+    volatile VirtQueue::Desc& d = q.tx.getDesc(id);
+    d.addr = q.txPhys + id * BufferSize;
+    d.len = len;
+    d.flags = 0;
+    prev = &d;
+  }
+  q.tx.post(head);
+  q.tx.publish();
+  q.tx.kick();
+  return 0;
+}
+
+// device initialization, see section 3.1.1
+bool VirtioNet::init(const PCIDevice& pd) {
+  uint16_t cmd = PCI::Command(pd);
+  cmd |= PCI::MemorySpace() | PCI::BusMaster();
+  cmd &= ~PCI::InterruptDisable();
+  PCI::Command::write(pd, uint32_t(cmd));
+
+  if (!mapCapabilities(pd)) return false;
+
+  writeCommon<uint8_t>(DeviceStatus, 0);           // reset
+  while (readCommon<uint8_t>(DeviceStatus) != 0) CPU::Pause();
+  setStatus(Acknowledge);
+  setStatus(Driver);
+  if (!negotiate()) {
+    setStatus(Failed);
+    return false;
+  }
+  writeCommon<uint16_t>(MsixConfig, NoVector);
+
+  mword maxPairs = (features & F_MQ) ? *(volatile uint16_t*)(config + ConfigMaxPairs) : 1;
+  pairs = min(min(maxPairs, Machine::getProcessorCount()), MaxPairs);
+
+  // one MSI-X vector per receive queue, spread across cores
+  mword msiIrq = 0;
+  mword vectors = Machine::allocMsi(pd, pairs, msiIrq);
+  if (vectors) pairs = vectors;
+  for (mword i = 0; i < pairs; i += 1) {
+    QueuePair& q = qp[i];
+    q.vn = this;
+    q.poll = nullptr;
+    if (!setupQueue(q.rx, 2 * i, vectors ? i : NoVector) || !setupQueue(q.tx, 2 * i + 1, NoVector)) {
+      setStatus(Failed);
+      return false;
+    }
+    size_t rxSize = q.rx.getSize() * BufferSize;
+    q.rxBuf = (uint8_t*)MemoryManager::allocContig(rxSize, pagesize<1>(), topaddr);
+    q.rxPhys = Paging::vtop(vaddr(q.rxBuf));
+    size_t txSize = q.tx.getSize() * BufferSize;
+    q.txBuf = (uint8_t*)MemoryManager::allocContig(txSize, pagesize<1>(), topaddr);
+    q.txPhys = Paging::vtop(vaddr(q.txBuf));
+    fillRx(q);
+    q.rx.suppress(true);                            // until poll thread runs
+    q.tx.suppress(true);
+  }
+  if (features & F_CTRL_VQ) {
+    if (!setupQueue(ctrl, 2 * maxPairs, NoVector)) {
+      setStatus(Failed);
+      return false;
+    }
+    size_t ctrlSize = pagesize<1>();
+    ctrlBuf = (uint8_t*)MemoryManager::allocContig(ctrlSize, pagesize<1>(), topaddr);
+    ctrlPhys = Paging::vtop(vaddr(ctrlBuf));
+  }
+
+  if (features & F_MAC) {
+    for (int i = 0; i < 6; i += 1) mac[i] = config[ConfigMac + i];
+  } else {
+    const uint8_t def[6] = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x57 };
+    memcpy(mac, def, sizeof(mac));
+  }
+
+  setStatus(DriverOk);
+  if (pairs > 1 && !setPairs(pairs)) pairs = 1;    // device keeps using pair 0
+  for (mword i = 0; i < pairs; i += 1) qp[i].rx.kick();
+
+  uint8_t offload = 0;
+  if (features & F_CSUM) offload |= NETIF_OFFLOAD_TX_CSUM;
+  // a TSO segment must fit into a (small) transmit queue several times over
+  if ((features & F_HOST_TSO4) && qp[0].tx.getSize() >= 4 * divup(size_t(0x10000), BufferSize)) {
+    offload |= NETIF_OFFLOAD_TSO;
+  }
+  nif = lwip_add_netif(this, mac, (int (*)(ptr_t, ptr_t, size_t, const netif_tx_offload*))send, offload);
+  if (vectors) {
+    for (mword i = 0; i < pairs; i += 1) {
+      QueuePair& q = qp[i];
+      q.poll = knew<IrqPoll>("virtio-net", &q, (IrqPoll::MaskFunc)maskQueue, (IrqPoll::PollFunc)pollQueue, (IrqPoll::UnmaskFunc)unmaskQueue);
+      q.poll->start(msiIrq + i);
+      unmaskQueue(&q);
+    }
+  } else {
+    poll = knew<IrqPoll>("virtio-net", this, (IrqPoll::MaskFunc)mask, (IrqPoll::PollFunc)pollRx, (IrqPoll::UnmaskFunc)unmask);
+    poll->start(pd.getIrq());
+    unmask(this);
+  }
+
+  DBG::outl(DBG::Devices, "virtio-net: IRQ ", (vectors ? msiIrq : pd.getIrq()), (vectors ? " (MSI-X), " : ", "), pairs, " queue pairs, features ", FmtHex(features),
+    ", MAC ", FmtHex(mac[0],2), ':', FmtHex(mac[1],2), ':', FmtHex(mac[2],2), ':', FmtHex(mac[3],2), ':', FmtHex(mac[4],2), ':', FmtHex(mac[5],2));
+  return true;
+}
+
+// modern device 0x1041, or transitional device 0x1000 with subsystem 1
+bool VirtioNet::probe(const PCIDevice& pd) {
+  if (PCI::VendorID(pd) != 0x1af4) return false;
+  uint16_t did = PCI::DeviceID(pd);
+  if (did != 0x1041 && !(did == 0x1000 && PCI::SubSystemID(pd) == 1)) return false;
+  VirtioNet* vn = knew<VirtioNet>();
+  if (vn->init(pd)) return true;
+  DBG::outl(DBG::Devices, "virtio-net: no usable modern interface");
+  kdelete(vn);
+  return false;
+}
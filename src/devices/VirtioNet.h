@@ -0,0 +1,204 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+// details taken from the Virtual I/O Device (VIRTIO) Version 1.0 spec
+// http://docs.oasis-open.org/virtio/virtio/v1.0/virtio-v1.0.html
+
+#ifndef _VirtioNet_h_
+#define _VirtioNet_h_ 1
+
+#include "machine/SpinLock.h"
+
+class IrqPoll;
+class PCIDevice;
+struct netif;
+struct netif_tx_offload;
+
+// split virtqueue (section 2.4), one contiguous allocation
+class VirtQueue {
+public:
+  struct Desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+  } __packed;
+  struct Avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[0];
+  } __packed;
+  struct UsedElem {
+    uint32_t id;
+    uint32_t len;
+  } __packed;
+  struct Used {
+    uint16_t flags;
+    uint16_t idx;
+    UsedElem ring[0];
+  } __packed;
+
+  static const uint16_t DescNext  = 1;
+  static const uint16_t DescWrite = 2;
+  static const uint16_t AvailNoInterrupt = 1;
+  static const uint16_t UsedNoNotify = 1;
+
+private:
+  volatile Desc*  desc;
+  volatile Avail* avail;
+  volatile Used*  used;
+  volatile uint16_t* notifyAddr;
+  uint16_t index;
+  uint16_t size;
+  uint16_t availIdx;      // next avail ring entry
+  uint16_t lastUsed;      // next used ring entry to consume
+  uint16_t freeHead;      // descriptor free list, linked through 'next'
+  uint16_t numFree;
+
+public:
+  VirtQueue() : desc(nullptr), avail(nullptr), used(nullptr), notifyAddr(nullptr),
+    index(0), size(0), availIdx(0), lastUsed(0), freeHead(0), numFree(0) {}
+
+  // allocate rings for 'size' descriptors; returns physical addresses
+  void init(uint16_t idx, uint16_t size, paddr& pdesc, paddr& pavail, paddr& pused);
+  void setNotify(volatile uint16_t* addr) { notifyAddr = addr; }
+
+  uint16_t getIndex() const { return index; }
+  uint16_t getSize() const { return size; }
+  volatile Desc& getDesc(uint16_t id) { return desc[id]; }
+
+  int allocDesc();
+  void freeDesc(uint16_t id);
+  void freeChain(uint16_t id);
+  uint16_t getFree() const { return numFree; }
+
+  // put descriptor (chain) into avail ring; 'publish' makes it visible
+  void post(uint16_t id) { avail->ring[availIdx % size] = id; availIdx += 1; }
+  void publish() { __atomic_store_n(&avail->idx, availIdx, __ATOMIC_RELEASE); }
+  void kick();
+
+  bool pending() const { return lastUsed != __atomic_load_n(&used->idx, __ATOMIC_ACQUIRE); }
+  UsedElem consume() { UsedElem e = { used->ring[lastUsed % size].id, used->ring[lastUsed % size].len }; lastUsed += 1; return e; }
+
+  void suppress(bool s) {
+    if (s) avail->flags = AvailNoInterrupt;
+    else avail->flags = 0;
+  }
+};
+
+// virtio-net over modern (1.0) virtio-pci: split virtqueues, mergeable
+// receive buffers, multiple queue pairs.  Receive uses IrqPoll: with
+// MSI-X, each receive queue has its own vector and poll thread on its own
+// core; the interrupt suppresses notifications on that queue only.
+// Otherwise, the shared INTx interrupt suppresses notifications on all
+// receive queues and a single poll thread processes them.  Transmit
+// notifications are always suppressed; the sender reclaims descriptors
+// itself.  Frames are copied between lwIP and the queues' buffers; a TSO
+// segment spans a chain of transmit buffers.  Checksums are left to the
+// device in both directions, if offered.
+class VirtioNet {
+  static const uint64_t F_CSUM       = 1ull <<  0;
+  static const uint64_t F_GUEST_CSUM = 1ull <<  1;
+  static const uint64_t F_MAC        = 1ull <<  5;
+  static const uint64_t F_GUEST_TSO4 = 1ull <<  7;
+  static const uint64_t F_HOST_TSO4  = 1ull << 11;
+  static const uint64_t F_MRG_RXBUF  = 1ull << 15;
+  static const uint64_t F_STATUS     = 1ull << 16;
+  static const uint64_t F_CTRL_VQ    = 1ull << 17;
+  static const uint64_t F_MQ         = 1ull << 22;
+  static const uint64_t F_VERSION_1  = 1ull << 32;
+
+  // GUEST_TSO4 is not requested: lwIP does not accept segments larger
+  // than the MSS it announces
+  static const uint64_t Wanted = F_CSUM | F_GUEST_CSUM | F_MAC | F_HOST_TSO4
+                               | F_MRG_RXBUF | F_STATUS | F_CTRL_VQ | F_MQ
+                               | F_VERSION_1;
+
+  struct Header {
+    uint8_t  flags;
+    uint8_t  gsoType;
+    uint16_t hdrLen;
+    uint16_t gsoSize;
+    uint16_t csumStart;
+    uint16_t csumOffset;
+    uint16_t numBuffers;   // version 1: always present
+  } __packed;
+  static const uint8_t HdrNeedsCsum = 1;
+  static const uint8_t HdrDataValid = 2;
+  static const uint8_t GsoTcpV4 = 1;
+
+  static const size_t   BufferSize = 2048;
+  static const uint16_t MaxQueueSize = 256;
+  static const mword    MaxPairs = 8;
+  static const size_t   MaxMerge = 32;
+
+  struct QueuePair {
+    VirtQueue rx;
+    VirtQueue tx;
+    uint8_t*  rxBuf;
+    paddr     rxPhys;
+    uint8_t*  txBuf;
+    paddr     txPhys;
+    SpinLock  txLock;
+    VirtioNet* vn;
+    IrqPoll*  poll;        // MSI-X only
+  };
+
+  volatile uint8_t* common;
+  volatile uint8_t* isr;
+  volatile uint8_t* config;
+  vaddr     notifyBase;
+  uint32_t  notifyMult;
+  uint64_t  features;
+  mword     pairs;
+  QueuePair qp[MaxPairs];
+  VirtQueue ctrl;
+  uint8_t*  ctrlBuf;
+  paddr     ctrlPhys;
+  uint8_t   mac[6];
+  netif*    nif;
+  IrqPoll*  poll;
+  mword     rxStart;       // receive queue polled first, rotates
+
+  template<typename T> T    readCommon(mword off) { return *(volatile T*)(common + off); }
+  template<typename T> void writeCommon(mword off, T val) { *(volatile T*)(common + off) = val; }
+  void setStatus(uint8_t s);
+
+  bool mapCapabilities(const PCIDevice& pd);
+  bool negotiate();
+  bool setupQueue(VirtQueue& vq, uint16_t idx, uint16_t vector);
+  bool setPairs(mword n);
+  void fillRx(QueuePair& q);
+  size_t receive(QueuePair& q, size_t budget);
+
+  static int mask(VirtioNet* vn);
+  static size_t pollRx(VirtioNet* vn, size_t budget);
+  static void unmask(VirtioNet* vn);
+  static int maskQueue(QueuePair* q);
+  static size_t pollQueue(QueuePair* q, size_t budget);
+  static void unmaskQueue(QueuePair* q);
+  static int send(VirtioNet* vn, ptr_t buffer, size_t size, const netif_tx_offload* off);
+
+  bool init(const PCIDevice& pd);
+
+public:
+  VirtioNet() : common(nullptr), isr(nullptr), config(nullptr), notifyBase(0),
+    notifyMult(0), features(0), pairs(0), ctrlBuf(nullptr), ctrlPhys(0),
+    nif(nullptr), poll(nullptr), rxStart(0) {}
+  static bool probe(const PCIDevice& pd);
+};
+
+#endif /* _VirtioNet_h_ */
@@ -15,6 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 #include "runtime/BlockingSync.h"
+#include "kernel/IrqPoll.h"
 #include "kernel/MemoryManager.h"
 #include "kernel/Output.h"
 #include "machine/Machine.h"
@@ -35,6 +36,7 @@ extern "C" void cdi_printf(const char* fmt, ...) {
 }
 
 #include "cdi.h"
+#include "cdi/net.h"
 #include "cdi/pci.h"
 
 // see http://stackoverflow.com/questions/16552710/how-do-you-get-the-start-and-end-addresses-of-a-custom-elf-section-in-c-gcc
@@ -43,10 +45,13 @@ extern struct cdi_driver* __stop_cdi_drivers;   // 1 past last driver
 
 list<cdi_driver*> driverList;
 
-struct netif;
+#include "lwip/netif.h"
+
 static netif* lwip_netif = nullptr;
-extern netif* lwip_add_netif(void *ethif);
+extern netif* lwip_add_netif(ptr_t device, const uint8_t* mac, int (*send)(ptr_t, ptr_t, size_t, const netif_tx_offload*), uint8_t offload);
+static int cdi_net_send(ptr_t device, ptr_t buffer, size_t size, const netif_tx_offload* off);
 extern void lwip_net_receive(netif*, bufptr_t buffer, size_t size);
+extern bool lwip_net_receive_zc(netif*, bufptr_t buffer, size_t size, bool csumValid, ptr_t meta, size_t metaSize, funcvoid2_t release, ptr_t device);
 
 void initCdiDrivers() {
   for (cdi_driver** pdrv = &__start_cdi_drivers; pdrv < &__stop_cdi_drivers; pdrv += 1) {
@@ -119,7 +124,15 @@ bool findCdiDriver(const PCIDevice &pciDev) {
         device->driver = (*it);
         cdi_list_push((*it)->devices, device);
         cdi_printf("PCI device %02X:%02X:%02X - driver found: %s\n", cpd->bus, cpd->dev, cpd->function, (*it)->name);
-        lwip_netif = lwip_add_netif(device);
+        if ((*it)->type == CDI_NETWORK) {
+          cdi_net_device* nd = (cdi_net_device*)device;
+          uint8_t mac[6];
+          for (int b = 0; b < 6; b += 1) mac[b] = (nd->mac >> (8 * b)) & 0xff;
+          uint8_t offload = 0;
+          if (nd->offload & CDI_NET_OFFLOAD_TX_CSUM) offload |= NETIF_OFFLOAD_TX_CSUM;
+          if (nd->offload & CDI_NET_OFFLOAD_TSO) offload |= NETIF_OFFLOAD_TSO;
+          lwip_netif = lwip_add_netif(nd, mac, cdi_net_send, offload);
+        }
         return true;
       }
     }
@@ -215,6 +228,10 @@ void cdi_register_irq(uint8_t irq, void (*handler)(cdi_device *), cdi_device* de
   Machine::registerIrqAsync(irq, (funcvoid1_t)handler, (void*)device);
 }
 
+void cdi_set_irq_affinity(uint8_t irq, unsigned int cpu) {
+  Machine::setIrqAffinity(irq, cpu % Machine::getProcessorCount());
+}
+
 void cdi_sleep_ms(uint32_t ms) {
   Timeout::sleep(ms);
 }
@@ -245,11 +262,32 @@ void cdi_net_receive(cdi_net_device* device, ptr_t buffer, size_t size) {
   if (lwip_netif) lwip_net_receive(lwip_netif, (bufptr_t)buffer, size);
 }
 
-// just send via first available interface
-void cdi_net_send(ptr_t buffer, size_t size) {
-  cdi_net_device* dev = (cdi_net_device*)cdi_list_get(netcard_list, 0);
+// pbuf bookkeeping is placed in the headroom in front of the buffer
+int cdi_net_receive_zc(cdi_net_device* device, ptr_t buffer, size_t size, int flags, cdi_net_release_fn release) {
+#if TESTING_NET_COPY_RX
+  return 0;
+#else
+  if (!lwip_netif) return 0;
+  return lwip_net_receive_zc(lwip_netif, (bufptr_t)buffer, size, flags & CDI_NET_RX_CSUM_OK, (bufptr_t)buffer - CDI_NET_RX_HEADROOM,
+    CDI_NET_RX_HEADROOM, (funcvoid2_t)release, device);
+#endif
+}
+
+void cdi_net_register_poll(cdi_net_device* device, uint8_t irq, const cdi_net_poll_ops* ops) {
+  IrqPoll* ip = knew<IrqPoll>("net", (ptr_t)device, (IrqPoll::MaskFunc)ops->mask,
+    (IrqPoll::PollFunc)ops->poll, (IrqPoll::UnmaskFunc)ops->unmask);
+  ip->start(irq);
+}
+
+// lwIP transmit for a CDI network device; -1: transmit ring full
+static int cdi_net_send(ptr_t device, ptr_t buffer, size_t size, const netif_tx_offload* off) {
+  cdi_net_device* dev = (cdi_net_device*)device;
   cdi_net_driver* driver = (cdi_net_driver*)dev->dev.driver;
-  driver->send_packet(dev, buffer, size);
+  if (off) {
+    cdi_net_offload co = { off->csum_start, off->csum_offset, off->hdr_len, off->mss };
+    return driver->send_packet(dev, buffer, size, &co);
+  }
+  return driver->send_packet(dev, buffer, size, nullptr);
   //DBG::outl(DBG::CDI, "packet sent: ", size);
 }
 
@@ -273,6 +311,14 @@ void cdi_pci_free_ioports(cdi_pci_device* device) {
   }
 }
 
+unsigned int cdi_pci_alloc_msi(cdi_pci_device* device, unsigned int count, uint8_t* irq) {
+  PCIDevice pd(device->bus, device->dev, device->function, device->irq);
+  mword first;
+  mword n = Machine::allocMsi(pd, count, first);
+  if (n) *irq = first;
+  return n;
+}
+
 struct cdi_list_implementation {
   list<ptr_t> impl;
 };
@@ -45,8 +45,60 @@
 #define PHYS(netcard, field) \
     (netcard->phys + offsetof(struct e1000_device, field))
 
-static void e1000_handle_interrupt(struct cdi_device* device);
 static uint64_t get_mac_address(struct e1000_device* device);
+static const struct cdi_net_poll_ops e1000_poll_ops;
+
+static inline uint8_t* rx_buffer(struct e1000_device* netcard, uint32_t slot)
+{
+    return &netcard->rx_buffer[slot * RX_BUFFER_SIZE + CDI_NET_RX_HEADROOM];
+}
+
+static inline uint64_t rx_buffer_phys(struct e1000_device* netcard, uint32_t slot)
+{
+    return PHYS(netcard, rx_buffer) + slot * RX_BUFFER_SIZE + CDI_NET_RX_HEADROOM;
+}
+
+static inline uint64_t tx_buffer_phys(struct e1000_device* netcard, uint32_t slot)
+{
+    return PHYS(netcard, tx_buffer) + slot * TX_BUFFER_SIZE;
+}
+
+/*
+ * Spare buffers are kept in a private list used only by the interrupt
+ * handler.  The stack returns buffers from arbitrary threads by pushing
+ * onto 'rx_free'; the handler takes that whole list at once when its own
+ * list runs empty, so there is no ABA problem.
+ */
+static int e1000_rx_get(struct e1000_device* netcard)
+{
+    if (netcard->rx_local == 0) {
+        netcard->rx_local =
+            __atomic_exchange_n(&netcard->rx_free, 0, __ATOMIC_ACQUIRE);
+        if (netcard->rx_local == 0) {
+            return -1;
+        }
+    }
+    uint32_t slot = netcard->rx_local - 1;
+    netcard->rx_local = netcard->rx_next[slot];
+    return slot;
+}
+
+static void e1000_rx_put(struct e1000_device* netcard, uint32_t slot)
+{
+    netcard->rx_next[slot] = netcard->rx_local;
+    netcard->rx_local = slot + 1;
+}
+
+static void e1000_rx_release(struct cdi_net_device* device, void* buffer)
+{
+    struct e1000_device* netcard = (struct e1000_device*) device;
+    uint32_t slot = ((uint8_t*) buffer - netcard->rx_buffer) / RX_BUFFER_SIZE;
+    uint32_t old = __atomic_load_n(&netcard->rx_free, __ATOMIC_RELAXED);
+    do {
+        netcard->rx_next[slot] = old;
+    } while (!__atomic_compare_exchange_n(&netcard->rx_free, &old, slot + 1,
+        1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
 
 static uint32_t e1000_reg_read(struct e1000_device *device, uint16_t offset)
 {
@@ -282,8 +334,9 @@ static void reset_nic(struct e1000_device* netcard)
         RX_BUFFER_NUM * sizeof(struct e1000_rx_descriptor));
     reg_outl(netcard, REG_RXDESC_HEAD, 0);
     reg_outl(netcard, REG_RXDESC_TAIL, RX_BUFFER_NUM - 1);
-    reg_outl(netcard, REG_RX_DELAY_TIMER, 0);
-    reg_outl(netcard, REG_RADV, 0);
+    reg_outl(netcard, REG_RX_DELAY_TIMER, E1000_RDTR);
+    reg_outl(netcard, REG_RADV, E1000_RADV);
+    reg_outl(netcard, REG_INTR_THROTTLE, E1000_ITR);
 
     reg_outl(netcard, REG_TXDESC_ADDR_HI, 0);
     reg_outl(netcard, REG_TXDESC_ADDR_LO, PHYS(netcard, tx_desc[0]));
@@ -306,10 +359,17 @@ static void reset_nic(struct e1000_device* netcard)
     netcard->net.mac = mac;
     printf("e1000: MAC-Adresse: %012llx\n", (uint64_t) netcard->net.mac);
 
-    // Rx-Deskriptoren aufsetzen
+    // Rx-Deskriptoren aufsetzen, restliche Puffer in Reserve
+    netcard->rx_local = 0;
+    netcard->rx_free = 0;
+    for (i = RX_POOL_NUM - 1; i >= RX_BUFFER_NUM; i--) {
+        e1000_rx_put(netcard, i);
+    }
     for (i = 0; i < RX_BUFFER_NUM; i++) {
+        netcard->rx_slot[i] = i;
         netcard->rx_desc[i].length = RX_BUFFER_SIZE;
-        netcard->rx_desc[i].buffer = PHYS(netcard, rx_buffer[i * RX_BUFFER_SIZE]);
+        netcard->rx_desc[i].status = 0;
+        netcard->rx_desc[i].buffer = rx_buffer_phys(netcard, i);
 
 #ifdef DEBUG
         printf("e1000: [%d] Rx: Buffer @ phys %08x, Desc @ phys %08x\n",
@@ -319,9 +379,20 @@ static void reset_nic(struct e1000_device* netcard)
 #endif
     }
 
+    // Tx-Deskriptoren gelten als erledigt
+    for (i = 0; i < TX_BUFFER_NUM; i++) {
+        netcard->tx_desc[i].buffer = tx_buffer_phys(netcard, i);
+        netcard->tx_desc[i].status = TX_STATUS_DD;
+    }
+
     netcard->tx_cur_buffer = 0;
+    netcard->tx_clean = 0;
+    netcard->tx_context = 0;
     netcard->rx_cur_buffer = 0;
 
+    // TCP/UDP-Pruefsummen empfangener Pakete prueft die Karte
+    reg_outl(netcard, REG_RXCSUM, RXCSUM_TUOFL);
+
     // Rx/Tx aktivieren
     reg_outl(netcard, REG_RX_CTL, RCTL_ENABLE | RCTL_BROADCAST
         | RCTL_2K_BUFSIZE);
@@ -385,7 +456,6 @@ found:
 
     // PCI-bezogenes Zeug initialisieren
     netcard->revision = pci->rev_id;
-    cdi_register_irq(pci->irq, e1000_handle_interrupt, &netcard->net.dev);
     cdi_pci_alloc_ioports(pci);
 
     cdi_list_t reslist = pci->resources;
@@ -404,11 +474,14 @@ found:
     printf("e1000: Fuehre Reset der Karte durch\n");
     reset_nic(netcard);
 
+    // Pruefsummen und TCP-Segmentierung beim Senden uebernimmt die Karte
+    netcard->net.offload = CDI_NET_OFFLOAD_TX_CSUM | CDI_NET_OFFLOAD_TSO;
     cdi_net_device_init(&netcard->net);
 
-    // Interrupts aktivieren
-    reg_outl(netcard, REG_INTR_MASK_CLR, 0xFFFF);
-    reg_outl(netcard, REG_INTR_MASK, 0xFFFF);
+    // Interrupts aktivieren, Empfang im Poll-Modus
+    reg_outl(netcard, REG_INTR_MASK_CLR, 0xFFFFFFFF);
+    cdi_net_register_poll(&netcard->net, pci->irq, &e1000_poll_ops);
+    reg_outl(netcard, REG_INTR_MASK, E1000_IMS);
 
     return &netcard->net.dev;
 }
@@ -429,109 +502,291 @@ void e1000_remove_device(struct cdi_device* device)
  * Die Hardware erhoeht ihrerseits Head, wenn sie ein Paket abgeschickt hat.
  * Wenn Head = Tail ist, ist die Sendewarteschlange leer.
  */
-void e1000_send_packet(struct cdi_net_device* device, void* data, size_t size)
+/*
+ * Every descriptor is queued with Report Status, so the card sets DD once
+ * it is done with it.  Reclaiming walks from tx_clean over those, without
+ * reading the Head register.  Senders are serialized by the lwIP core lock,
+ * so neither index needs locking.
+ */
+static void e1000_tx_reclaim(struct e1000_device* netcard)
+{
+    while (netcard->tx_clean != netcard->tx_cur_buffer) {
+        volatile struct e1000_tx_descriptor* desc =
+            &netcard->tx_desc[netcard->tx_clean];
+        if ((desc->status & TX_STATUS_DD) == 0) {
+            break;
+        }
+        netcard->tx_clean++;
+        netcard->tx_clean %= TX_BUFFER_NUM;
+    }
+}
+
+static uint32_t e1000_tx_free(struct e1000_device* netcard)
+{
+    return (netcard->tx_clean + TX_BUFFER_NUM - netcard->tx_cur_buffer - 1)
+        % TX_BUFFER_NUM;
+}
+
+/*
+ * Offloads are described by a context descriptor in front of the data
+ * descriptors.  A checksum context stays loaded for later packets, so it is
+ * only queued when the offsets change; a TSO context carries the length of
+ * its packet and is queued every time.  The network stack sends untagged
+ * IPv4 frames, so the IP header follows the Ethernet header directly.
+ */
+#define TX_IP_START 14
+
+static uint32_t e1000_tx_context_key(const struct cdi_net_offload* offload)
+{
+    return 1 | (offload->csum_start << 8)
+        | ((offload->csum_start + offload->csum_offset) << 16);
+}
+
+static void e1000_tx_context(struct e1000_device* netcard, uint32_t cur,
+    const uint8_t* frame, size_t size, const struct cdi_net_offload* offload)
+{
+    struct e1000_tx_context_descriptor* ctx =
+        (struct e1000_tx_context_descriptor*) &netcard->tx_desc[cur];
+    uint32_t tucmd = TX_TUCMD_IP | TX_CMD_DEXT | TX_CMD_RS;
+
+    if (frame[TX_IP_START + 9] == 6) {
+        tucmd |= TX_TUCMD_TCP;
+    }
+
+    ctx->ipcss = TX_IP_START;
+    ctx->ipcso = TX_IP_START + 10;
+    ctx->ipcse = offload->csum_start - 1;
+    ctx->tucss = offload->csum_start;
+    ctx->tucso = offload->csum_start + offload->csum_offset;
+    ctx->tucse = 0;
+    ctx->status = 0;
+
+    if (offload->mss) {
+        tucmd |= TX_CMD_TSE;
+        ctx->paylen = size - offload->hdr_len;
+        ctx->hdr_len = offload->hdr_len;
+        ctx->mss = offload->mss;
+        netcard->tx_context = 0;
+    } else {
+        ctx->paylen = 0;
+        ctx->hdr_len = 0;
+        ctx->mss = 0;
+        netcard->tx_context = e1000_tx_context_key(offload);
+    }
+    ctx->paylen |= tucmd << 24;
+}
+
+/*
+ * TSO: the card sets IP length and checksum of each segment and adds the
+ * segment length to the TCP checksum, which therefore starts out as the
+ * pseudo-header sum without length.
+ */
+static void e1000_tso_headers(uint8_t* frame,
+    const struct cdi_net_offload* offload)
+{
+    uint8_t* ip = frame + TX_IP_START;
+    uint8_t* csum = frame + offload->csum_start + offload->csum_offset;
+    uint32_t sum = ip[9];
+    int i;
+
+    ip[2] = ip[3] = 0;
+    ip[10] = ip[11] = 0;
+    for (i = 12; i < 20; i += 2) {
+        sum += (ip[i] << 8) | ip[i + 1];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    csum[0] = sum >> 8;
+    csum[1] = sum & 0xFF;
+}
+
+int e1000_send_packet(struct cdi_net_device* device, void* data, size_t size,
+    const struct cdi_net_offload* offload)
 {
     struct e1000_device* netcard = (struct e1000_device*) device;
-    uint32_t cur, head;
+    uint32_t cur, count, context, i;
+    uint8_t cmd = TX_CMD_IFCS | TX_CMD_RS, dtyp = 0, popts = 0;
 
 #ifdef DEBUG
     printf("e1000: e1000_send_packet\n");
 #endif
 
-    // Aktuellen Deskriptor erhoehen
+    // Nur TSO-Segmente verteilen sich auf mehrere Puffer
+    if ((offload == NULL || offload->mss == 0) && size > TX_BUFFER_SIZE) {
+        size = TX_BUFFER_SIZE;
+    }
+    count = (size + TX_BUFFER_SIZE - 1) / TX_BUFFER_SIZE;
+    context = offload != NULL && (offload->mss
+        || netcard->tx_context != e1000_tx_context_key(offload));
+
+    // Erst bei vollem Ring aufraeumen; volle Ringe meldet der Aufrufer weiter
+    if (e1000_tx_free(netcard) < count + context) {
+        e1000_tx_reclaim(netcard);
+        if (e1000_tx_free(netcard) < count + context) {
+            return -1;
+        }
+    }
+
     cur = netcard->tx_cur_buffer;
-    netcard->tx_cur_buffer++;
-    netcard->tx_cur_buffer %= TX_BUFFER_NUM;
-
-    // Head auslesen
-    head = reg_inl(netcard, REG_TXDESC_HEAD);
-    if (netcard->tx_cur_buffer == head) {
-        printf("e1000: Kein Platz in der Sendewarteschlange!\n");
-        return;
+    if (offload != NULL) {
+        if (context) {
+            e1000_tx_context(netcard, cur, data, size, offload);
+            cur = (cur + 1) % TX_BUFFER_NUM;
+        }
+        cmd |= TX_CMD_DEXT;
+        dtyp = TX_DTYP_DATA;
+        popts = TX_POPTS_TXSM;
+        if (offload->mss) {
+            cmd |= TX_CMD_TSE;
+            popts |= TX_POPTS_IXSM;
+        }
     }
 
-    // Buffer befuellen
-    if (size > TX_BUFFER_SIZE) {
-        size = TX_BUFFER_SIZE;
+    // Buffer befuellen und TX-Deskriptoren setzen; der Kontext-Deskriptor
+    // hat die Pufferadresse seines Slots ueberschrieben
+    for (i = 0; i < count; i++) {
+        size_t len = size - i * TX_BUFFER_SIZE;
+        if (len > TX_BUFFER_SIZE) {
+            len = TX_BUFFER_SIZE;
+        }
+        memcpy(netcard->tx_buffer + cur * TX_BUFFER_SIZE,
+            (uint8_t*) data + i * TX_BUFFER_SIZE, len);
+        if (i == 0 && offload != NULL && offload->mss) {
+            e1000_tso_headers(netcard->tx_buffer + cur * TX_BUFFER_SIZE,
+                offload);
+        }
+
+        netcard->tx_desc[cur].buffer = tx_buffer_phys(netcard, cur);
+        netcard->tx_desc[cur].length = len;
+        netcard->tx_desc[cur].checksum_offset = dtyp;
+        netcard->tx_desc[cur].cmd = cmd | (i == count - 1 ? TX_CMD_EOP : 0);
+        netcard->tx_desc[cur].status = 0;
+        netcard->tx_desc[cur].checksum_start = popts;
+        netcard->tx_desc[cur].special = 0;
+        cur = (cur + 1) % TX_BUFFER_NUM;
     }
-    memcpy(netcard->tx_buffer + cur * TX_BUFFER_SIZE, data, size);
 
-    // TX-Deskriptor setzen und Tail erhoehen
-    netcard->tx_desc[cur].cmd = TX_CMD_EOP | TX_CMD_IFCS;
-    netcard->tx_desc[cur].length = size;
-    netcard->tx_desc[cur].buffer =
-        PHYS(netcard, tx_buffer) + (cur * TX_BUFFER_SIZE);
+    netcard->tx_cur_buffer = cur;
 
 #ifdef DEBUG
-    printf("e1000: Setze Tail auf %d, Head = %d\n", netcard->tx_cur_buffer, head);
+    printf("e1000: Setze Tail auf %d\n", cur);
 #endif
-    reg_outl(netcard, REG_TXDESC_TAIL, netcard->tx_cur_buffer);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    reg_outl(netcard, REG_TXDESC_TAIL, cur);
+    return 0;
 }
 
-static void e1000_handle_interrupt(struct cdi_device* device)
+/*
+ * Empfang im Poll-Modus: Der Interrupt maskiert nur die Karte, der
+ * Poll-Thread arbeitet den Ring ab und gibt die Interrupts erst wieder
+ * frei, wenn keine Pakete mehr anliegen.
+ */
+static int e1000_irq_mask(struct cdi_net_device* device)
 {
     struct e1000_device* netcard = (struct e1000_device*) device;
 
+    // Waehrend gepollt wird, bleibt ICR stehen, damit beim Demaskieren
+    // neue Ursachen sofort wieder einen Interrupt ausloesen
+    if (netcard->irq_masked) {
+        return 0;
+    }
+
+    // ICR lesen quittiert; leer heisst, der Interrupt kam von woanders
     uint32_t icr = reg_inl(netcard, REG_INTR_CAUSE);
+    if (icr == 0) {
+        return 0;
+    }
+    reg_outl(netcard, REG_INTR_MASK_CLR, 0xFFFFFFFF);
+    netcard->irq_masked = 1;
 
 #ifdef DEBUG
     printf("e1000: Interrupt, ICR = %08x\n", icr);
 #endif
+    return 1;
+}
+
+static void e1000_irq_unmask(struct cdi_net_device* device)
+{
+    struct e1000_device* netcard = (struct e1000_device*) device;
 
-    if (icr & ICR_RECEIVE) {
+    // Inzwischen gesetzte Ursachen loesen sofort wieder einen Interrupt aus
+    netcard->irq_masked = 0;
+    reg_outl(netcard, REG_INTR_MASK, E1000_IMS);
+}
 
-        uint32_t head = reg_inl(netcard, REG_RXDESC_HEAD);
+static size_t e1000_poll(struct cdi_net_device* device, size_t budget)
+{
+    struct e1000_device* netcard = (struct e1000_device*) device;
+    size_t done = 0;
 
-        while (netcard->rx_cur_buffer != head) {
+    while (done < budget) {
 
-            size_t size = netcard->rx_desc[netcard->rx_cur_buffer].length;
-            uint8_t status = netcard->rx_desc[netcard->rx_cur_buffer].status;
+        volatile struct e1000_rx_descriptor* desc =
+            &netcard->rx_desc[netcard->rx_cur_buffer];
+        uint8_t status = desc->status;
 
-            // Wenn Descriptor Done nicht gesetzt ist, war die Hardware
-            // noch nicht gant fertig mit Kopieren
-            if ((status & 0x1) == 0) {
-                break;
-            }
+        // Wenn Descriptor Done nicht gesetzt ist, war die Hardware
+        // noch nicht gant fertig mit Kopieren
+        if ((status & 0x1) == 0) {
+            break;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        // 4 Bytes CRC von der Laenge abziehen
+        size_t size = desc->length - 4;
 
-            // 4 Bytes CRC von der Laenge abziehen
-            size -= 4;
+        // Von der Karte gepruefte TCP/UDP-Pruefsumme
+        int flags = 0;
+        if ((status & (RX_STATUS_IXSM | RX_STATUS_TCPCS)) == RX_STATUS_TCPCS
+            && (desc->error & RX_ERROR_TCPE) == 0)
+        {
+            flags = CDI_NET_RX_CSUM_OK;
+        }
 
 #ifdef DEBUG
-            printf("e1000: %d Bytes empfangen (status = %x)\n", size, status);
-/*
-            int i;
-            for (i = 0; i < (size < 49 ? size : 49); i++) {
-                printf("%02hhx ", netcard->rx_buffer[
-                    netcard->rx_cur_buffer * RX_BUFFER_SIZE + i]);
-                if (i % 25 == 0) {
-                    printf("\n");
-                }
-            }
-            printf("\n\n");
-*/
+        printf("e1000: %d Bytes empfangen (status = %x)\n", size, status);
 #endif
 
+        // Pass the buffer itself up and refill the descriptor with a
+        // spare one; copy, if no spare is left or the stack declines.
+        uint32_t slot = netcard->rx_slot[netcard->rx_cur_buffer];
+        int spare = e1000_rx_get(netcard);
+        if (spare >= 0 && cdi_net_receive_zc(
+            (struct cdi_net_device*) netcard, rx_buffer(netcard, slot),
+            size, flags, e1000_rx_release))
+        {
+            netcard->rx_slot[netcard->rx_cur_buffer] = spare;
+            desc->buffer = rx_buffer_phys(netcard, spare);
+        } else {
+            if (spare >= 0) {
+                e1000_rx_put(netcard, spare);
+            }
             cdi_net_receive(
                 (struct cdi_net_device*) netcard,
-                &netcard->rx_buffer[netcard->rx_cur_buffer * RX_BUFFER_SIZE],
+                rx_buffer(netcard, slot),
                 size);
-
-            netcard->rx_cur_buffer++;
-            netcard->rx_cur_buffer %= RX_BUFFER_NUM;
         }
+        desc->status = 0;
 
-        if (netcard->rx_cur_buffer == head) {
-            reg_outl(netcard, REG_RXDESC_TAIL,
-                (head + RX_BUFFER_NUM - 1) % RX_BUFFER_NUM);
-        } else {
-            reg_outl(netcard, REG_RXDESC_TAIL, netcard->rx_cur_buffer);
-        }
+        netcard->rx_cur_buffer++;
+        netcard->rx_cur_buffer %= RX_BUFFER_NUM;
+        done++;
+    }
 
-    } else if (icr & ICR_TRANSMIT) {
-        // Nichts zu tun
-    } else {
-#ifdef DEBUG
-        printf("e1000: Unerwarteter Interrupt.\n");
-#endif
+    // Abgearbeitete Deskriptoren zurueckgeben; Tail bleibt einen hinter
+    // dem naechsten zu lesenden, damit der Ring nie als leer gilt
+    if (done > 0) {
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        reg_outl(netcard, REG_RXDESC_TAIL,
+            (netcard->rx_cur_buffer + RX_BUFFER_NUM - 1) % RX_BUFFER_NUM);
     }
+
+    return done;
 }
+
+static const struct cdi_net_poll_ops e1000_poll_ops = {
+    .mask   = e1000_irq_mask,
+    .poll   = e1000_poll,
+    .unmask = e1000_irq_unmask,
+};
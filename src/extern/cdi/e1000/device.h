@@ -44,6 +44,7 @@ enum {
     REG_VET             =   0x38, /* VLAN */
 
     REG_INTR_CAUSE      =   0xc0, /* ICR */
+    REG_INTR_THROTTLE   =   0xc4, /* ITR */
     REG_INTR_MASK       =   0xd0, /* IMS */
     REG_INTR_MASK_CLR   =   0xd8, /* IMC */
 
@@ -70,6 +71,7 @@ enum {
     REG_TX_DELAY_TIMER  = 0x3820,
     REG_TADV            = 0x382c,
 
+    REG_RXCSUM          = 0x5000, /* Receive Checksum Control */
     REG_RECV_ADDR_LIST  = 0x5400, /* RAL */
 };
 
@@ -86,6 +88,10 @@ enum {
     RCTL_2K_BUFSIZE = (0 << 16), /* BSIZE */
 };
 
+enum {
+    RXCSUM_TUOFL    = (1 <<  9), /* TCP/UDP checksum offload */
+};
+
 enum {
     TCTL_ENABLE     = (1 <<  1),
     TCTL_PADDING    = (1 <<  2),
@@ -94,10 +100,32 @@ enum {
 };
 
 enum {
-    ICR_TRANSMIT    = (1 <<  0),
-    ICR_RECEIVE     = (1 <<  7),
+    ICR_TRANSMIT    = (1 <<  0), /* TXDW */
+    ICR_LINK_CHANGE = (1 <<  2), /* LSC */
+    ICR_RX_MIN_THR  = (1 <<  4), /* RXDMT0 */
+    ICR_RX_OVERRUN  = (1 <<  6), /* RXO */
+    ICR_RECEIVE     = (1 <<  7), /* RXT0 */
 };
 
+/*
+ * Interrupt moderation.  ITR is the minimum interval between interrupts in
+ * 256ns units; the delay timers count 1.024us.  RDTR restarts with every
+ * frame, RADV bounds the total delay of the first one.  TX interrupts are
+ * not enabled at all, descriptors are reclaimed by the sender.
+ */
+#ifndef E1000_ITR
+#define E1000_ITR       488     /* ~8000 interrupts/s */
+#endif
+#ifndef E1000_RDTR
+#define E1000_RDTR      32
+#endif
+#ifndef E1000_RADV
+#define E1000_RADV      128
+#endif
+
+#define E1000_IMS       (ICR_RECEIVE | ICR_RX_OVERRUN | ICR_RX_MIN_THR \
+                         | ICR_LINK_CHANGE)
+
 enum {
     EEPROM_OFS_MAC      = 0x0,
 };
@@ -132,8 +160,24 @@ enum {
 //#define RX_BUFFER_NUM   64
 
 // Die Anzahl von Deskriptoren muss jeweils ein vielfaches von 8 sein
-#define RX_BUFFER_NUM   8
-#define TX_BUFFER_NUM   8
+#ifndef E1000_RX_RING
+#define E1000_RX_RING   256
+#endif
+#ifndef E1000_TX_RING
+#define E1000_TX_RING   256
+#endif
+#define RX_BUFFER_NUM   E1000_RX_RING
+#define TX_BUFFER_NUM   E1000_TX_RING
+
+_Static_assert(RX_BUFFER_NUM % 8 == 0 && RX_BUFFER_NUM <= 4096,
+    "e1000: RX ring size must be a multiple of 8");
+_Static_assert(TX_BUFFER_NUM % 8 == 0 && TX_BUFFER_NUM <= 4096,
+    "e1000: TX ring size must be a multiple of 8");
+
+// Receive buffers handed to the network stack are replaced by spare ones
+// from a pool.  The card writes behind CDI_NET_RX_HEADROOM; with long
+// packets disabled, a frame (at most 1522 bytes) still fits into the rest.
+#define RX_POOL_NUM     (2 * RX_BUFFER_NUM)
 
 struct e1000_tx_descriptor {
     uint64_t            buffer;
@@ -148,6 +192,50 @@ struct e1000_tx_descriptor {
 enum {
     TX_CMD_EOP  = 0x01,
     TX_CMD_IFCS = 0x02,
+    TX_CMD_TSE  = 0x04, /* TCP Segmentation Enable (extended descriptors) */
+    TX_CMD_RS   = 0x08, /* Report Status: write back DD */
+    TX_CMD_DEXT = 0x20, /* Descriptor Extension */
+};
+
+enum {
+    TX_STATUS_DD = 0x01,
+};
+
+/*
+ * Extended data descriptors share the layout of legacy descriptors: the
+ * descriptor type sits in the upper half of checksum_offset, the packet
+ * options (POPTS) take the place of checksum_start.
+ */
+enum {
+    TX_DTYP_DATA    = 0x10,
+    TX_POPTS_IXSM   = 0x01, /* insert IP checksum */
+    TX_POPTS_TXSM   = 0x02, /* insert TCP/UDP checksum */
+};
+
+/*
+ * TCP/IP context descriptor: describes checksum offload and TSO for the
+ * data descriptors that follow.  It occupies a slot of the transmit ring.
+ */
+struct e1000_tx_context_descriptor {
+    uint8_t             ipcss;  /* IP checksum start */
+    uint8_t             ipcso;  /* IP checksum offset */
+    uint16_t            ipcse;  /* IP checksum end (inclusive) */
+    uint8_t             tucss;  /* TCP/UDP checksum start */
+    uint8_t             tucso;  /* TCP/UDP checksum offset */
+    uint16_t            tucse;  /* TCP/UDP checksum end, 0: end of packet */
+    uint32_t            paylen; /* TSO payload length, TUCMD in bits 24-31 */
+    uint8_t             status;
+    uint8_t             hdr_len;
+    uint16_t            mss;
+} __attribute__((packed)) __attribute__((aligned (4)));
+
+_Static_assert(sizeof(struct e1000_tx_context_descriptor)
+    == sizeof(struct e1000_tx_descriptor),
+    "e1000: context descriptor must fill a descriptor slot");
+
+enum {
+    TX_TUCMD_TCP    = 0x01, /* TCP, not UDP */
+    TX_TUCMD_IP     = 0x02, /* IPv4 */
 };
 
 struct e1000_rx_descriptor {
@@ -159,6 +247,16 @@ struct e1000_rx_descriptor {
     uint16_t            padding2;
 } __attribute__((packed)) __attribute__((aligned (4)));
 
+enum {
+    RX_STATUS_DD    = 0x01,
+    RX_STATUS_IXSM  = 0x04, /* ignore checksum indication */
+    RX_STATUS_TCPCS = 0x20, /* TCP/UDP checksum calculated */
+};
+
+enum {
+    RX_ERROR_TCPE   = 0x20, /* TCP/UDP checksum error */
+};
+
 struct e1000_device {
     struct cdi_net_device       net;
 
@@ -167,19 +265,27 @@ struct e1000_device {
     struct e1000_tx_descriptor  tx_desc[TX_BUFFER_NUM] __attribute__((aligned(16)));
     uint8_t                     tx_buffer[TX_BUFFER_NUM * TX_BUFFER_SIZE];
     uint32_t                    tx_cur_buffer;
+    uint32_t                    tx_clean;   // oldest descriptor not reclaimed
+    uint32_t                    tx_context; // checksum context in use (0: none)
 
     struct e1000_rx_descriptor  rx_desc[RX_BUFFER_NUM] __attribute__((aligned(16)));
-    uint8_t                     rx_buffer[RX_BUFFER_NUM * RX_BUFFER_SIZE];
+    uint8_t                     rx_buffer[RX_POOL_NUM * RX_BUFFER_SIZE];
     uint32_t                    rx_cur_buffer;
+    uint32_t                    rx_slot[RX_BUFFER_NUM]; // pool buffer per descriptor
+    uint32_t                    rx_next[RX_POOL_NUM];   // free list links
+    uint32_t                    rx_local;   // spare buffers (index + 1, 0: none)
+    uint32_t                    rx_free;    // buffers released by the stack
 
     void*                       mem_base;
     uint8_t                     revision;
+    volatile uint8_t            irq_masked; // poll thread active
 };
 
 struct cdi_device* e1000_init_device(struct cdi_bus_data* bus_data);
 void e1000_remove_device(struct cdi_device* device);
 
-void e1000_send_packet
-    (struct cdi_net_device* device, void* data, size_t size);
+int e1000_send_packet
+    (struct cdi_net_device* device, void* data, size_t size,
+    const struct cdi_net_offload* offload);
 
 #endif
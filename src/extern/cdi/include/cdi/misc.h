@@ -29,6 +29,12 @@ extern "C" {
 void cdi_register_irq(uint8_t irq, void (*handler)(struct cdi_device*), 
     struct cdi_device* device);
 
+/**
+ * KOS extension: deliver 'irq' to processor 'cpu' from now on.  The
+ * handler's poll thread (see cdi_net_register_poll) follows the irq.
+ */
+void cdi_set_irq_affinity(uint8_t irq, unsigned int cpu);
+
 /**
  * Setzt den IRQ-Zaehler fuer cdi_wait_irq zurueck.
  *
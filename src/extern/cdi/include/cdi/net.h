@@ -26,13 +26,66 @@ struct cdi_net_device {
     struct cdi_device   dev;
     uint64_t            mac : 48;
     int                 number;
+
+    /** KOS: offloads provided by the driver, see CDI_NET_OFFLOAD_* */
+    int                 offload;
+};
+
+/**
+ * KOS extension: offload capabilities.  With CDI_NET_OFFLOAD_TX_CSUM, the
+ * network stack leaves TCP/UDP checksums to the device; the checksum field
+ * then holds the pseudo-header sum.  With CDI_NET_OFFLOAD_TSO, it passes
+ * TCP segments of up to 64K that the device splits.
+ */
+#define CDI_NET_OFFLOAD_TX_CSUM 0x1
+#define CDI_NET_OFFLOAD_TSO     0x2
+
+/**
+ * KOS extension: offloads requested for one packet.  Offsets count from
+ * the start of the Ethernet frame.
+ */
+struct cdi_net_offload {
+    uint16_t            csum_start;     // 0: checksum complete
+    uint16_t            csum_offset;    // relative to csum_start
+    uint16_t            hdr_len;        // TSO: Ethernet/IP/TCP headers
+    uint16_t            mss;            // TSO: 0: send packet as is
 };
 
 struct cdi_net_driver {
     struct cdi_driver   drv;
 
-    void (*send_packet)
-        (struct cdi_net_device* device, void* data, size_t size);
+    /**
+     * KOS: returns 0, or -1 if the packet was not queued (ring full);
+     * 'offload' is NULL unless the device completes the checksum or
+     * splits the packet
+     */
+    int (*send_packet)
+        (struct cdi_net_device* device, void* data, size_t size,
+        const struct cdi_net_offload* offload);
+};
+
+/**
+ * KOS extension: space in front of a receive buffer passed to
+ * cdi_net_receive_zc() that the network stack uses for bookkeeping.
+ */
+#define CDI_NET_RX_HEADROOM 128
+
+typedef void (*cdi_net_release_fn)(struct cdi_net_device* device, void* buffer);
+
+/** KOS extension: flags for cdi_net_receive_zc() */
+#define CDI_NET_RX_CSUM_OK  0x1     // device has verified TCP/UDP checksum
+
+/**
+ * KOS extension: poll-mode receive.  'mask' runs in interrupt context,
+ * acknowledges and masks the device's interrupts, and returns nonzero if
+ * the device has raised the interrupt (the line may be shared).  'poll'
+ * processes at most 'budget' received packets and returns their number.
+ * 'unmask' enables the device's interrupts again.
+ */
+struct cdi_net_poll_ops {
+    int (*mask)(struct cdi_net_device* device);
+    size_t (*poll)(struct cdi_net_device* device, size_t budget);
+    void (*unmask)(struct cdi_net_device* device);
 };
 
 
@@ -64,6 +117,23 @@ void cdi_net_device_init(struct cdi_net_device* device);
 void cdi_net_receive(
     struct cdi_net_device* device, void* buffer, size_t size);
 
+/**
+ * KOS extension: zero-copy receive.  Returns 1, if the network stack has
+ * taken over the buffer; it calls 'release' once the packet is consumed
+ * and the buffer can be reused.  Returns 0, if the caller keeps the buffer
+ * and should fall back to cdi_net_receive().  'flags' are CDI_NET_RX_*.
+ */
+int cdi_net_receive_zc(struct cdi_net_device* device, void* buffer,
+    size_t size, int flags, cdi_net_release_fn release);
+
+/**
+ * KOS extension: service the device by polling instead of an interrupt
+ * handler registered with cdi_register_irq().  The interrupt only masks
+ * the device and wakes a poll thread, which unmasks it when drained.
+ */
+void cdi_net_register_poll(struct cdi_net_device* device, uint8_t irq,
+    const struct cdi_net_poll_ops* ops);
+
 #ifdef __cplusplus
 }; // extern "C"
 #endif
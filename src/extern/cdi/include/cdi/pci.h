@@ -324,6 +324,17 @@ void cdi_pci_config_writew(struct cdi_pci_device* device, uint8_t offset,
 void cdi_pci_config_writel(struct cdi_pci_device* device, uint8_t offset,
     uint32_t value);
 
+/**
+ * KOS extension: message-signalled interrupts.  Sets up to 'count'
+ * vectors for the device, one per MSI-X table entry (or a single MSI
+ * vector), and disables its legacy interrupt.  Vector i arrives as irq
+ * '*irq + i', to be used with cdi_register_irq() or cdi_net_register_poll()
+ * instead of device->irq, and initially targets processor i.  Returns the
+ * number of vectors, 0 if the device supports legacy interrupts only.
+ */
+unsigned int cdi_pci_alloc_msi(struct cdi_pci_device* device,
+    unsigned int count, uint8_t* irq);
+
 #ifdef __cplusplus
 }; // extern "C"
 #endif
@@ -4,6 +4,7 @@
 #include <ctype.h>
 #include <stdint.h>
 #include <sys/param.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
 /* Define generic types used in lwIP */
@@ -13,6 +14,7 @@ typedef uint16_t u16_t;
 typedef  int16_t s16_t;
 typedef uint32_t u32_t;
 typedef  int32_t s32_t;
+typedef uint64_t u64_t;
 
 typedef uintptr_t mem_ptr_t;
 
@@ -5,6 +5,7 @@ void sys_init(void);
 u32_t sys_now(void);
 
 typedef void* sys_sem_t;
+typedef void* sys_mutex_t;
 typedef void* sys_mbox_t;
 typedef void* sys_thread_t;
 
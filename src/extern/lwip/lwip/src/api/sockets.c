@@ -1643,7 +1643,13 @@ lwip_getsockopt(int s, int level, int optname, void *optval, socklen_t *optlen)
   data.optval = optval;
   data.optlen = optlen;
   data.err = err;
+#if LWIP_TCPIP_CORE_LOCKING
+  LOCK_TCPIP_CORE();
+  lwip_getsockopt_internal(&data);
+  UNLOCK_TCPIP_CORE();
+#else /* LWIP_TCPIP_CORE_LOCKING */
   tcpip_callback(lwip_getsockopt_internal, &data);
+#endif /* LWIP_TCPIP_CORE_LOCKING */
   sys_arch_sem_wait(&sock->conn->op_completed, 0);
   /* maybe lwip_getsockopt_internal has changed err */
   err = data.err;
@@ -2060,7 +2066,13 @@ lwip_setsockopt(int s, int level, int optname, const void *optval, socklen_t opt
   data.optval = (void*)optval;
   data.optlen = &optlen;
   data.err = err;
+#if LWIP_TCPIP_CORE_LOCKING
+  LOCK_TCPIP_CORE();
+  lwip_setsockopt_internal(&data);
+  UNLOCK_TCPIP_CORE();
+#else /* LWIP_TCPIP_CORE_LOCKING */
   tcpip_callback(lwip_setsockopt_internal, &data);
+#endif /* LWIP_TCPIP_CORE_LOCKING */
   sys_arch_sem_wait(&sock->conn->op_completed, 0);
   /* maybe lwip_setsockopt_internal has changed err */
   err = data.err;
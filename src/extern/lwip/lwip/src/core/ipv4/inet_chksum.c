@@ -52,7 +52,7 @@
  * #define LWIP_CHKSUM <your_checksum_routine> 
  *
  * Or you can select from the implementations below by defining
- * LWIP_CHKSUM_ALGORITHM to 1, 2 or 3.
+ * LWIP_CHKSUM_ALGORITHM to 1, 2, 3 or 4.
  */
 
 #ifndef LWIP_CHKSUM
@@ -256,6 +256,126 @@ lwip_standard_chksum(void *dataptr, int len)
 }
 #endif
 
+#if (LWIP_CHKSUM_ALGORITHM == 4) /* Alternative version #4 */
+/** Add a 64-bit word to a 64-bit one's complement sum */
+#define CHKSUM_ADD64(sum, w) do { u64_t w_ = (w); (sum) += w_; (sum) += ((sum) < w_); } while (0)
+
+/**
+ * KOS: version #3 widened for 64-bit targets. After summing 16-bit words up
+ * to an 8-byte boundary, the inner loop adds 32 bytes at a time as 64-bit
+ * words and adds each carry back. Since 2^16 = 1 modulo 0xffff, 16-bit
+ * words may be added at any position; folding the 64-bit sum down to 16 bits
+ * yields the Internet sum.
+ *
+ * @arg start of buffer to be checksummed. May be an odd byte address.
+ * @len number of bytes in the buffer to be checksummed.
+ * @return host order (!) lwip checksum (non-inverted Internet sum)
+ */
+
+static u16_t
+lwip_standard_chksum(void *dataptr, int len)
+{
+  u8_t *pb = (u8_t *)dataptr;
+  u16_t *ps, t = 0;
+  u64_t *pq;
+  u64_t sum = 0;
+  /* starts at odd byte address? */
+  int odd = ((mem_ptr_t)pb & 1);
+
+  if (odd && len > 0) {
+    ((u8_t *)&t)[1] = *pb++;
+    len--;
+  }
+
+  ps = (u16_t *)pb;
+
+  while (((mem_ptr_t)ps & 7) && len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+
+  pq = (u64_t *)ps;
+
+  while (len > 31) {
+    CHKSUM_ADD64(sum, pq[0]);
+    CHKSUM_ADD64(sum, pq[1]);
+    CHKSUM_ADD64(sum, pq[2]);
+    CHKSUM_ADD64(sum, pq[3]);
+    pq += 4;
+    len -= 32;
+  }
+
+  while (len > 7) {
+    CHKSUM_ADD64(sum, *pq++);
+    len -= 8;
+  }
+
+  /* make room in upper bits */
+  sum = (sum >> 32) + (sum & 0xffffffffULL);
+
+  ps = (u16_t *)pq;
+
+  /* 16-bit aligned word remaining? */
+  while (len > 1) {
+    sum += *ps++;
+    len -= 2;
+  }
+
+  /* dangling tail byte remaining? */
+  if (len > 0) {                /* include odd byte */
+    ((u8_t *)&t)[0] = *(u8_t *)ps;
+  }
+
+  sum += t;                     /* add end bytes */
+
+  /* Fold 64-bit sum to 16 bits */
+  sum = (sum >> 32) + (sum & 0xffffffffULL);
+  sum = (sum >> 32) + (sum & 0xffffffffULL);
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+
+  if (odd) {
+    sum = SWAP_BYTES_IN_WORD(sum);
+  }
+
+  return (u16_t)sum;
+}
+#endif
+
+/* inet_chksum_pseudo_hdr:
+ *
+ * KOS: Calculates the sum over the pseudo header only, for a device that
+ * completes TCP and UDP checksums (NETIF_OFFLOAD_TX_CSUM).
+ * IP addresses are expected to be in network byte order.
+ *
+ * @param src source ip address
+ * @param dst destination ip address
+ * @param proto ip protocol
+ * @param proto_len length of the ip data part
+ * @return non-inverted sum (as u16_t) to be saved directly in the protocol
+ *         header; the device adds the ip data part and inverts the result
+ */
+u16_t
+inet_chksum_pseudo_hdr(ip_addr_t *src, ip_addr_t *dest,
+       u8_t proto, u16_t proto_len)
+{
+  u32_t acc;
+  u32_t addr;
+
+  addr = ip4_addr_get_u32(src);
+  acc = (addr & 0xffffUL);
+  acc += ((addr >> 16) & 0xffffUL);
+  addr = ip4_addr_get_u32(dest);
+  acc += (addr & 0xffffUL);
+  acc += ((addr >> 16) & 0xffffUL);
+  acc += (u32_t)htons((u16_t)proto);
+  acc += (u32_t)htons(proto_len);
+
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+  return (u16_t)acc;
+}
+
 /* inet_chksum_pseudo:
  *
  * Calculates the pseudo Internet checksum used by TCP and UDP for a pbuf chain.
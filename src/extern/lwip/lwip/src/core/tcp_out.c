@@ -80,6 +80,28 @@
 /* Forward declarations.*/
 static void tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb);
 
+#if CHECKSUM_GEN_TCP
+/** KOS: Checksum of a segment of at most one MSS: a device that completes
+ * checksums (NETIF_OFFLOAD_TX_CSUM) only gets the pseudo-header sum and the
+ * pbuf is marked with PBUF_FLAG_CSUM_PARTIAL.
+ *
+ * @param p pbuf starting with the tcp_hdr, checksum field set to 0
+ * @param local_ip source address of the segment
+ * @param remote_ip destination address, used to find the netif
+ * @return checksum to be saved directly in the tcp_hdr
+ */
+static u16_t
+tcp_chksum(struct pbuf *p, ip_addr_t *local_ip, ip_addr_t *remote_ip)
+{
+  struct netif *netif = ip_route(remote_ip);
+  if ((netif != NULL) && (netif->offload & NETIF_OFFLOAD_TX_CSUM)) {
+    p->flags |= PBUF_FLAG_CSUM_PARTIAL;
+    return inet_chksum_pseudo_hdr(local_ip, remote_ip, IP_PROTO_TCP, p->tot_len);
+  }
+  return inet_chksum_pseudo(p, local_ip, remote_ip, IP_PROTO_TCP, p->tot_len);
+}
+#endif /* CHECKSUM_GEN_TCP */
+
 /** Allocate a pbuf and create a tcphdr at p->payload, used for output
  * functions other than the default tcp_output -> tcp_output_segment
  * (e.g. tcp_send_empty_ack, etc.)
@@ -334,6 +356,32 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
   return ERR_OK;
 }
 
+/**
+ * KOS: Largest segment built by tcp_write(). A device that segments TCP
+ * (NETIF_OFFLOAD_TSO) takes a multiple of the MSS up to TCP_TSO_MAX. Like
+ * a single MSS, a segment must not exceed half the largest window the
+ * peer has advertised; it must also fit into the congestion window,
+ * otherwise tcp_output() would have to split it (see tcp_split_segment).
+ *
+ * @param pcb Protocol control block for the TCP connection
+ * @return maximum length of segment data
+ */
+static u16_t
+tcp_write_mss(struct tcp_pcb *pcb)
+{
+  struct netif *netif;
+  u16_t mss_local = LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
+
+  if (pcb->snd_wnd_max/2 >= 2 * pcb->mss && pcb->cwnd >= 2 * pcb->mss) {
+    netif = ip_route(&(pcb->remote_ip));
+    if ((netif != NULL) && (netif->offload & NETIF_OFFLOAD_TSO)) {
+      mss_local = (u16_t)LWIP_MIN(LWIP_MIN(TCP_TSO_MAX, pcb->snd_wnd_max/2), pcb->cwnd);
+      mss_local -= mss_local % pcb->mss;
+    }
+  }
+  return mss_local;
+}
+
 /**
  * Write data for sending (but does not send it immediately).
  *
@@ -370,7 +418,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 #endif /* TCP_CHECKSUM_ON_COPY */
   err_t err;
   /* don't allocate segments bigger than half the maximum window we ever received */
-  u16_t mss_local = LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
+  u16_t mss_local = tcp_write_mss(pcb);
 
 #if LWIP_NETIF_TX_SINGLE_PBUF
   /* Always copy to try to create single pbufs for TX */
@@ -872,8 +920,7 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
 #endif 
 
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, &(pcb->local_ip), &(pcb->remote_ip),
-        IP_PROTO_TCP, p->tot_len);
+  tcphdr->chksum = tcp_chksum(p, &(pcb->local_ip), &(pcb->remote_ip));
 #endif
 #if LWIP_NETIF_HWADDRHINT
   ip_output_hinted(p, &(pcb->local_ip), &(pcb->remote_ip), pcb->ttl, pcb->tos,
@@ -887,6 +934,61 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   return ERR_OK;
 }
 
+/**
+ * KOS: Split an unsent segment after 'split' bytes of data. The rest is
+ * copied into a new segment queued behind it, which also takes over FIN
+ * and PSH. The segment may have been sent before (retransmission), so
+ * its data is located relative to the TCP header.
+ *
+ * @param pcb the tcp_pcb owning the segment
+ * @param seg the segment to split
+ * @param split data bytes to keep in seg
+ * @return ERR_OK or ERR_MEM
+ */
+static err_t
+tcp_split_segment(struct tcp_pcb *pcb, struct tcp_seg *seg, u16_t split)
+{
+  struct tcp_seg *tail;
+  struct pbuf *p;
+  u16_t remainder = seg->len - split;
+  u16_t offset = (u16_t)((u8_t *)seg->tcphdr - (u8_t *)seg->p->payload) +
+                 TCPH_HDRLEN(seg->tcphdr) * 4;
+  u8_t optflags = seg->flags & (TF_SEG_OPTS_MSS | TF_SEG_OPTS_TS);
+  u8_t optlen = LWIP_TCP_OPT_LENGTH(optflags);
+  u8_t flags = TCPH_FLAGS(seg->tcphdr) & (TCP_FIN | TCP_PSH);
+
+  p = pbuf_alloc(PBUF_TRANSPORT, optlen + remainder, PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  pbuf_copy_partial(seg->p, (u8_t *)p->payload + optlen, remainder, offset + split);
+  tail = tcp_create_segment(pcb, p, flags, ntohl(seg->tcphdr->seqno) + split, optflags);
+  if (tail == NULL) {
+    return ERR_MEM;
+  }
+
+  pcb->snd_queuelen -= pbuf_clen(seg->p);
+  pbuf_realloc(seg->p, offset + split);
+  pcb->snd_queuelen += pbuf_clen(seg->p) + pbuf_clen(tail->p);
+  seg->len = split;
+  TCPH_UNSET_FLAG(seg->tcphdr, TCP_FIN | TCP_PSH);
+#if TCP_CHECKSUM_ON_COPY
+  seg->flags &= ~TF_SEG_DATA_CHECKSUMMED;
+#endif /* TCP_CHECKSUM_ON_COPY */
+#if TCP_OVERSIZE
+  if (seg->next == NULL) {
+    /* the tail is now the last unsent segment and has no spare room */
+    pcb->unsent_oversize = 0;
+  }
+#endif /* TCP_OVERSIZE */
+#if TCP_OVERSIZE_DBGCHECK
+  seg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+  tail->next = seg->next;
+  seg->next = tail;
+  return ERR_OK;
+}
+
 /**
  * Find out what we can send and send it
  *
@@ -919,6 +1021,20 @@ tcp_output(struct tcp_pcb *pcb)
 
   seg = pcb->unsent;
 
+  /* KOS: a TSO segment built for a larger window (or queued again by a
+     retransmission after cwnd collapsed) would wait forever when nothing
+     before it is in flight, since no ACK opens the window: send what
+     fits, at least one MSS. On ERR_MEM, the next call retries. */
+  if (seg != NULL && seg->len > pcb->mss &&
+      (pcb->unacked == NULL || ntohl(seg->tcphdr->seqno) == pcb->lastack) &&
+      ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len > wnd) {
+    u32_t avail = wnd - LWIP_MIN(wnd, ntohl(seg->tcphdr->seqno) - pcb->lastack);
+    u32_t split = LWIP_MAX((u32_t)pcb->mss, avail - avail % pcb->mss);
+    if (split < seg->len) {
+      tcp_split_segment(pcb, seg, (u16_t)split);
+    }
+  }
+
   /* If the TF_ACK_NOW flag is set and no data will be sent (either
    * because the ->unsent queue is empty or because the window does
    * not allow it), construct an empty ACK segment and send it.
@@ -1093,9 +1209,10 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   }
 
   /* If we don't have a local IP address, we get one by
-     calling ip_route(). */
+     calling ip_route(). KOS: the netif also tells whether the device
+     completes the checksum and splits segments larger than the MSS. */
+  netif = ip_route(&(pcb->remote_ip));
   if (ip_addr_isany(&(pcb->local_ip))) {
-    netif = ip_route(&(pcb->remote_ip));
     if (netif == NULL) {
       return;
     }
@@ -1120,6 +1237,19 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   seg->p->payload = seg->tcphdr;
 
   seg->tcphdr->chksum = 0;
+  seg->p->flags &= ~PBUF_FLAG_CSUM_PARTIAL;
+  seg->p->tso_mss = 0;
+  if ((netif != NULL) && (netif->offload & NETIF_OFFLOAD_TX_CSUM) &&
+      ((seg->len <= pcb->mss) || (netif->offload & NETIF_OFFLOAD_TSO))) {
+    seg->p->flags |= PBUF_FLAG_CSUM_PARTIAL;
+    if (seg->len > pcb->mss) {
+      seg->p->tso_mss = pcb->mss;
+    }
+#if CHECKSUM_GEN_TCP
+    seg->tcphdr->chksum = inet_chksum_pseudo_hdr(&(pcb->local_ip),
+           &(pcb->remote_ip), IP_PROTO_TCP, seg->p->tot_len);
+#endif /* CHECKSUM_GEN_TCP */
+  } else {
 #if CHECKSUM_GEN_TCP
 #if TCP_CHECKSUM_ON_COPY
   {
@@ -1160,6 +1290,7 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
          IP_PROTO_TCP, seg->p->tot_len);
 #endif /* TCP_CHECKSUM_ON_COPY */
 #endif /* CHECKSUM_GEN_TCP */
+  }
   TCP_STATS_INC(tcp.xmit);
 
 #if LWIP_NETIF_HWADDRHINT
@@ -1217,8 +1348,7 @@ tcp_rst(u32_t seqno, u32_t ackno,
   tcphdr->urgp = 0;
 
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, local_ip, remote_ip,
-              IP_PROTO_TCP, p->tot_len);
+  tcphdr->chksum = tcp_chksum(p, local_ip, remote_ip);
 #endif
   TCP_STATS_INC(tcp.xmit);
   snmp_inc_tcpoutrsts();
@@ -1382,8 +1512,7 @@ tcp_keepalive(struct tcp_pcb *pcb)
   tcphdr = (struct tcp_hdr *)p->payload;
 
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, &pcb->local_ip, &pcb->remote_ip,
-                                      IP_PROTO_TCP, p->tot_len);
+  tcphdr->chksum = tcp_chksum(p, &pcb->local_ip, &pcb->remote_ip);
 #endif
   TCP_STATS_INC(tcp.xmit);
 
@@ -1463,8 +1592,7 @@ tcp_zero_window_probe(struct tcp_pcb *pcb)
   }
 
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, &pcb->local_ip, &pcb->remote_ip,
-                                      IP_PROTO_TCP, p->tot_len);
+  tcphdr->chksum = tcp_chksum(p, &pcb->local_ip, &pcb->remote_ip);
 #endif
   TCP_STATS_INC(tcp.xmit);
 
@@ -325,7 +325,8 @@ udp_input(struct pbuf *p, struct netif *inp)
 #endif /* LWIP_UDPLITE */
     {
 #if CHECKSUM_CHECK_UDP
-      if (udphdr->chksum != 0) {
+      /* KOS: unless already verified by the device */
+      if ((udphdr->chksum != 0) && !(p->flags & PBUF_FLAG_CSUM_VALID)) {
         if (inet_chksum_pseudo(p, ip_current_src_addr(), ip_current_dest_addr(),
                                IP_PROTO_UDP, p->tot_len) != 0) {
           LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_LEVEL_SERIOUS,
@@ -697,10 +698,17 @@ udp_sendto_if_chksum(struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *dst_ip,
   {      /* UDP */
     LWIP_DEBUGF(UDP_DEBUG, ("udp_send: UDP packet length %"U16_F"\n", q->tot_len));
     udphdr->len = htons(q->tot_len);
+    q->flags &= ~PBUF_FLAG_CSUM_PARTIAL;
     /* calculate checksum */
 #if CHECKSUM_GEN_UDP
     if ((pcb->flags & UDP_FLAGS_NOCHKSUM) == 0) {
       u16_t udpchksum;
+      if ((netif->offload & NETIF_OFFLOAD_TX_CSUM) &&
+          ((netif->mtu == 0) || (q->tot_len + IP_HLEN <= netif->mtu))) {
+        /* KOS: the device completes the checksum, unless fragmented */
+        udpchksum = inet_chksum_pseudo_hdr(src_ip, dst_ip, IP_PROTO_UDP, q->tot_len);
+        q->flags |= PBUF_FLAG_CSUM_PARTIAL;
+      } else
 #if LWIP_CHECKSUM_ON_COPY
       if (have_chksum) {
         u32_t acc;
@@ -78,6 +78,8 @@ u16_t inet_chksum_pseudo(struct pbuf *p,
 u16_t inet_chksum_pseudo_partial(struct pbuf *p,
        ip_addr_t *src, ip_addr_t *dest,
        u8_t proto, u16_t proto_len, u16_t chksum_len);
+u16_t inet_chksum_pseudo_hdr(ip_addr_t *src, ip_addr_t *dest,
+       u8_t proto, u16_t proto_len);
 #if LWIP_CHKSUM_COPY_ALGORITHM
 u16_t lwip_chksum_copy(void *dst, const void *src, u16_t len);
 #endif /* LWIP_CHKSUM_COPY_ALGORITHM */
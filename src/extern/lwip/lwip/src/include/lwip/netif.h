@@ -94,6 +94,31 @@ extern "C" {
  * Set by the netif driver in its init function. */
 #define NETIF_FLAG_IGMP         0x80U
 
+/** KOS: The device completes TCP and UDP checksums. For segments that are
+ * not fragmented, the stack may store only the pseudo-header sum in the
+ * checksum field (see inet_chksum_pseudo_hdr) and mark the pbuf with
+ * PBUF_FLAG_CSUM_PARTIAL; the driver is told where to complete it
+ * (struct netif_tx_offload).
+ * Set by the netif driver in its init function. */
+#define NETIF_OFFLOAD_TX_CSUM   0x01U
+/** KOS: The device segments TCP. The stack passes segments of up to
+ * TCP_TSO_MAX bytes and sets pbuf->tso_mss. Requires NETIF_OFFLOAD_TX_CSUM.
+ * Set by the netif driver in its init function. */
+#define NETIF_OFFLOAD_TSO       0x02U
+
+/** KOS: offloads requested for one frame, passed from the link output
+ * function to the driver. Offsets count from the start of the frame. */
+struct netif_tx_offload {
+  /** start of the TCP/UDP header, 0: frame needs no checksum completion */
+  u16_t csum_start;
+  /** position of the checksum field, relative to csum_start */
+  u16_t csum_offset;
+  /** TSO: length of the Ethernet, IP and TCP headers */
+  u16_t hdr_len;
+  /** TSO: segment size, 0: frame is sent as is */
+  u16_t mss;
+};
+
 /** Function prototype for netif init functions. Set up flags and output/linkoutput
  * callback functions in this function.
  *
@@ -190,6 +215,8 @@ struct netif {
   u8_t hwaddr[NETIF_MAX_HWADDR_LEN];
   /** flags (see NETIF_FLAG_ above) */
   u8_t flags;
+  /** KOS: offload capabilities (see NETIF_OFFLOAD_ above) */
+  u8_t offload;
   /** descriptive abbreviation */
   char name[2];
   /** number of this interface */
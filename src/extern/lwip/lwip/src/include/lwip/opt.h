@@ -977,6 +977,15 @@
 #define TCP_SND_BUF                     (2 * TCP_MSS)
 #endif
 
+/**
+ * TCP_TSO_MAX: KOS: largest segment (bytes) passed to a netif that segments
+ * TCP (NETIF_OFFLOAD_TSO). Rounded down to a multiple of the MSS; headers
+ * must still fit into a pbuf (u16_t tot_len).
+ */
+#ifndef TCP_TSO_MAX
+#define TCP_TSO_MAX                     0xF000
+#endif
+
 /**
  * TCP_SND_QUEUELEN: TCP sender buffer space (pbufs). This must be at least
  * as much as (2 * TCP_SND_BUF/TCP_MSS) for things to work.
@@ -75,6 +75,11 @@ typedef enum {
 #define PBUF_FLAG_LLMCAST   0x10U
 /** indicates this pbuf includes a TCP FIN flag */
 #define PBUF_FLAG_TCP_FIN   0x20U
+/** KOS: indicates the device has verified this packet's TCP/UDP checksum */
+#define PBUF_FLAG_CSUM_VALID 0x40U
+/** KOS: indicates the TCP/UDP checksum field holds only the pseudo-header
+    sum, to be completed by the device (NETIF_OFFLOAD_TX_CSUM) */
+#define PBUF_FLAG_CSUM_PARTIAL 0x80U
 
 struct pbuf {
   /** next pbuf in singly linked pbuf chain */
@@ -107,6 +112,10 @@ struct pbuf {
    * the stack itself, or pbuf->next pointers from a chain.
    */
   u16_t ref;
+
+  /** KOS: segment size for a device that segments TCP (NETIF_OFFLOAD_TSO),
+   *  0 if this packet is sent as is */
+  u16_t tso_mss;
 };
 
 #if LWIP_SUPPORT_CUSTOM_PBUF
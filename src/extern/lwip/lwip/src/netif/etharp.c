@@ -1097,6 +1097,10 @@ etharp_query(struct netif *netif, ip_addr_t *ipaddr, struct pbuf *q)
         if (pbuf_copy(p, q) != ERR_OK) {
           pbuf_free(p);
           p = NULL;
+        } else {
+          /* KOS: keep the offloads requested from the device */
+          p->flags |= (q->flags & PBUF_FLAG_CSUM_PARTIAL);
+          p->tso_mss = q->tso_mss;
         }
       }
     } else {
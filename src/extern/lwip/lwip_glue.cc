@@ -1,6 +1,7 @@
 extern "C" {
 #include "lwip/def.h"
 #include "lwip/dhcp.h"
+#include "lwip/ip.h"
 #include "lwip/ip_addr.h"
 #include "lwip/mem.h"
 #include "lwip/netbuf.h"
@@ -10,13 +11,17 @@ extern "C" {
 #include "lwip/snmp.h"
 #include "lwip/stats.h"
 #include "lwip/sys.h"
+#include "lwip/tcp_impl.h"
 #include "lwip/tcpip.h"
+#include "lwip/udp.h"
 #include "netif/etharp.h"
 #include "netif/ppp_oe.h"
 }
 
 #include "kernel/MemoryManager.h"
 #include "kernel/Output.h"
+#include "kernel/Tracepoint.h"
+#include "uio.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -27,25 +32,26 @@ extern "C" {
 
 // see lwip/src/netif/ethernetif.c for explanations
 
-struct cdi_net_device;
-void cdi_net_send(ptr_t buffer, size_t size);
+// transmit one frame, completing its checksum or splitting it as requested
+// by 'off' (nullptr: none); returns -1, if the device's transmit ring is full
+typedef int (*netif_send_t)(ptr_t device, ptr_t buffer, size_t size, const netif_tx_offload* off);
 
 struct ethernetif {
   struct eth_addr *ethaddr;
-  struct cdi_net_device* device;
+  ptr_t device;
+  netif_send_t send;
+  uint8_t offload;              // NETIF_OFFLOAD_* provided by the device
+  uint8_t mac[ETHARP_HWADDR_LEN];
 };
 
 void low_level_init(struct netif *netif) {
+  struct ethernetif* ethernetif = (struct ethernetif*)netif->state;
+
   /* set MAC hardware address length */
   netif->hwaddr_len = ETHARP_HWADDR_LEN;
 
-  /* set MAC hardware address */// 52 54 00 12 34 56
-  netif->hwaddr[0] = 0x52;
-  netif->hwaddr[1] = 0x54;
-  netif->hwaddr[2] = 0x00;
-  netif->hwaddr[3] = 0x12;
-  netif->hwaddr[4] = 0x34;
-  netif->hwaddr[5] = 0x56;
+  /* set MAC hardware address */
+  memcpy(netif->hwaddr, ethernetif->mac, ETHARP_HWADDR_LEN);
 
   /* maximum transfer unit */
   netif->mtu = 1500;
@@ -53,30 +59,77 @@ void low_level_init(struct netif *netif) {
   /* device capabilities */
   /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
   netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+  netif->offload = ethernetif->offload;
+}
+
+// Locate the checksum that lwIP left to the device (PBUF_FLAG_CSUM_PARTIAL)
+// and the headers to repeat when splitting a TSO segment.  lwIP builds
+// headers in the first pbuf and never adds a VLAN tag.
+static bool tx_offload(struct pbuf* p, const uint8_t* frame, netif_tx_offload& off) {
+  if (!(p->flags & PBUF_FLAG_CSUM_PARTIAL)) return false;
+  const struct eth_hdr* ethhdr = (const struct eth_hdr*)frame;
+  if (ethhdr->type != PP_HTONS(ETHTYPE_IP)) return false;
+  const struct ip_hdr* iphdr = (const struct ip_hdr*)(frame + SIZEOF_ETH_HDR);
+  off.csum_start = SIZEOF_ETH_HDR + IPH_HL(iphdr) * 4;
+  off.hdr_len = 0;
+  off.mss = 0;
+  switch (IPH_PROTO(iphdr)) {
+  case IP_PROTO_TCP:
+    off.csum_offset = offsetof(struct tcp_hdr, chksum);
+    if (p->tso_mss) {
+      const struct tcp_hdr* tcphdr = (const struct tcp_hdr*)(frame + off.csum_start);
+      off.hdr_len = off.csum_start + TCPH_HDRLEN(tcphdr) * 4;
+      off.mss = p->tso_mss;
+    }
+    return true;
+  case IP_PROTO_UDP:
+    off.csum_offset = offsetof(struct udp_hdr, chksum);
+    return true;
+  default:
+    return false;
+  }
 }
 
 err_t low_level_output(struct netif *netif, struct pbuf *p) {
+  Tracepoint::instant(TraceNetOutput, p->tot_len);
 #if ETH_PAD_SIZE
   pbuf_header(p, -ETH_PAD_SIZE); /* drop the padding word */
 #endif
 
-  // Send the data from the pbuf to the interface, one pbuf at a time. The
-  // size of the data in each pbuf is kept in the ->len variable.
-  for(struct pbuf *q = p; q != NULL; q = q->next) {
-    cdi_net_send(q->payload, q->len);
+  // A pbuf chain is a single frame: the driver copies into its transmit
+  // buffer anyway, so flatten chains first.  Output only runs under the
+  // lwIP core lock, hence one static buffer suffices.  It holds any pbuf
+  // (u16_t tot_len), i.e., also TSO segments.
+  static char frame[0x10000];
+  void* data = p->payload;
+  if (p->next) {
+    pbuf_copy_partial(p, frame, p->tot_len, 0);
+    data = frame;
   }
-  // TODO: signal that packet should be sent
+  struct ethernetif* ethernetif = (struct ethernetif*)netif->state;
+  netif_tx_offload off;
+  bool offload = tx_offload(p, (const uint8_t*)data, off);
+  int ret = ethernetif->send(ethernetif->device, (ptr_t)data, p->tot_len, offload ? &off : nullptr);
 
 #if ETH_PAD_SIZE
   pbuf_header(p, ETH_PAD_SIZE); /* reclaim the padding word */
 #endif
 
+  // transmit ring full: report to lwIP instead of dropping silently
+  if (ret < 0) {
+    LINK_STATS_INC(link.memerr);
+    return ERR_MEM;
+  }
+
   LINK_STATS_INC(link.xmit);
 
   return ERR_OK;
 }
 
-struct pbuf* low_level_input(struct netif *netif, bufptr_t buffer, size_t size) {
+// frame may be scattered over several driver buffers
+struct pbuf* low_level_input(struct netif *netif, const struct iovec* iov, size_t cnt) {
+  size_t size = 0;
+  for (size_t i = 0; i < cnt; i += 1) size += iov[i].iov_len;
   u16_t len = size;
 
 #if ETH_PAD_SIZE
@@ -92,7 +145,7 @@ struct pbuf* low_level_input(struct netif *netif, bufptr_t buffer, size_t size)
 #endif
 
     /* We iterate over the pbuf chain until we have read the entire packet. */
-    int counter = 0;
+    size_t i = 0, counter = 0;
     for (struct pbuf* q = p; q != NULL; q = q->next) {
       /* Read enough bytes to fill this pbuf in the chain. The available
        * data in the pbuf is given by the q->len variable.
@@ -101,8 +154,13 @@ struct pbuf* low_level_input(struct netif *netif, bufptr_t buffer, size_t size)
        * truncate it to the actually received size.  In this case, ensure
        * the tot_len member of the pbuf is the sum of the chained pbuf len
        * members.  */
-      memcpy(q->payload, buffer + counter, q->len);
-      counter += q->len;
+      for (size_t done = 0; done < q->len; ) {
+        size_t n = min(size_t(q->len - done), iov[i].iov_len - counter);
+        memcpy((char*)q->payload + done, (char*)iov[i].iov_base + counter, n);
+        done += n;
+        counter += n;
+        if (counter == iov[i].iov_len) { i += 1; counter = 0; }
+      }
     }
     // TODO: acknowledge that packet has been read
     LINK_STATS_INC(link.recv);
@@ -118,11 +176,37 @@ struct pbuf* low_level_input(struct netif *netif, bufptr_t buffer, size_t size)
   return p;
 }
 
-void ethernetif_input(struct netif *netif, bufptr_t buffer, size_t size) {
-  /* move received packet into a new pbuf */
-  struct pbuf* p = low_level_input(netif, buffer, size);
-  /* no packet could be read, silently ignore this */
-  if (p == NULL) return;
+// received frame left in driver buffer: pbuf refers to it directly and the
+// buffer goes back to the driver when the pbuf is freed
+struct RxPbuf {
+  struct pbuf_custom pc;
+  funcvoid2_t release;
+  ptr_t device;
+  ptr_t buffer;
+};
+
+static void rx_pbuf_free(struct pbuf* p) {
+  RxPbuf* rp = (RxPbuf*)p;
+  rp->release(rp->device, rp->buffer);
+}
+
+struct pbuf* low_level_input_zc(bufptr_t buffer, size_t size, ptr_t meta, size_t metaSize, funcvoid2_t release, ptr_t device) {
+  KASSERT1(sizeof(RxPbuf) <= metaSize, metaSize);
+#if ETH_PAD_SIZE
+  return NULL;                  /* no room for padding in front of frame */
+#else
+  RxPbuf* rp = new (meta) RxPbuf;
+  rp->pc.custom_free_function = rx_pbuf_free;
+  rp->release = release;
+  rp->device = device;
+  rp->buffer = buffer;
+  struct pbuf* p = pbuf_alloced_custom(PBUF_RAW, size, PBUF_REF, &rp->pc, buffer, size);
+  if (p) LINK_STATS_INC(link.recv);
+  return p;
+#endif
+}
+
+static void ethernetif_input(struct netif *netif, struct pbuf* p) {
   /* points to packet payload, which starts with an Ethernet header */
   struct eth_hdr* ethhdr = (struct eth_hdr *)p->payload;
 
@@ -135,7 +219,7 @@ void ethernetif_input(struct netif *netif, bufptr_t buffer, size_t size) {
   case ETHTYPE_PPPOEDISC:
   case ETHTYPE_PPPOE:
 #endif /* PPPOE_SUPPORT */
-    /* full packet sent to tcpip_thread for processing */
+    /* full packet processed in this thread, under the core lock */
     if (netif->input(p, netif) != ERR_OK) {
       DBG::outl(DBG::Lwip, "LWIP: IP input error");
       pbuf_free(p);
@@ -148,9 +232,19 @@ void ethernetif_input(struct netif *netif, bufptr_t buffer, size_t size) {
   }
 }
 
+// 'csumValid': the device has verified the TCP/UDP checksum
+void ethernetif_input(struct netif *netif, const struct iovec* iov, size_t cnt, bool csumValid) {
+  /* move received packet into a new pbuf */
+  struct pbuf* p = low_level_input(netif, iov, cnt);
+  /* no packet could be read, silently ignore this */
+  if (p == NULL) return;
+  if (csumValid) p->flags |= PBUF_FLAG_CSUM_VALID;
+  ethernetif_input(netif, p);
+}
+
 err_t ethernetif_init(struct netif *netif) {
   KASSERT0(netif);
-  struct ethernetif* ethernetif = kmalloc<struct ethernetif>();
+  struct ethernetif* ethernetif = (struct ethernetif*)netif->state;
   KASSERT0(ethernetif);
 
 #if LWIP_NETIF_HOSTNAME
@@ -163,7 +257,6 @@ err_t ethernetif_init(struct netif *netif) {
    * of bits per second. */
   NETIF_INIT_SNMP(netif, snmp_ifType_ethernet_csmacd, LINK_SPEED_OF_YOUR_NETIF_IN_BPS);
 
-  netif->state = ethernetif;
   netif->name[0] = IFNAME0;
   netif->name[1] = IFNAME1;
   /* Directly use etharp_output() here to save a function call.  You can
@@ -180,7 +273,25 @@ err_t ethernetif_init(struct netif *netif) {
   return ERR_OK;
 }
 void lwip_net_receive(struct netif *nif, bufptr_t buffer, size_t size) {
-  ethernetif_input(nif,buffer,size);
+  Tracepoint::instant(TraceNetInput, size);
+  struct iovec iov = { buffer, size };
+  ethernetif_input(nif, &iov, 1, false);
+}
+
+// frame received into several buffers, e.g., virtio mergeable buffers
+void lwip_net_receive_iov(struct netif *nif, const struct iovec* iov, size_t cnt, bool csumValid) {
+  Tracepoint::instant(TraceNetInput, iov[0].iov_len);
+  ethernetif_input(nif, iov, cnt, csumValid);
+}
+
+// zero-copy: 'meta' holds pbuf for 'buffer'; 'release' returns the buffer
+bool lwip_net_receive_zc(struct netif *nif, bufptr_t buffer, size_t size, bool csumValid, ptr_t meta, size_t metaSize, funcvoid2_t release, ptr_t device) {
+  Tracepoint::instant(TraceNetInput, size);
+  struct pbuf* p = low_level_input_zc(buffer, size, meta, metaSize, release, device);
+  if (p == NULL) return false;
+  if (csumValid) p->flags |= PBUF_FLAG_CSUM_VALID;
+  ethernetif_input(nif, p);
+  return true;
 }
 
 static const char *ip_to_string(uint32_t ip) {
@@ -197,7 +308,15 @@ void lwip_init_tcpip() {
   tcpip_init(&tcpip_init_done, nullptr);
 }
 
-void* lwip_add_netif(void *ethif) {
+// 'send' transmits a frame on 'device', see netif_send_t; 'offload' lists
+// the NETIF_OFFLOAD_* capabilities of the device
+void* lwip_add_netif(ptr_t device, const uint8_t* mac, netif_send_t send, uint8_t offload) {
+  struct ethernetif* ethif = kmalloc<struct ethernetif>();
+  ethif->device = device;
+  ethif->send = send;
+  if (!(offload & NETIF_OFFLOAD_TX_CSUM)) offload &= ~NETIF_OFFLOAD_TSO;
+  ethif->offload = offload;
+  memcpy(ethif->mac, mac, ETHARP_HWADDR_LEN);
   struct netif *nif = kmalloc<struct netif>();
   struct ip_addr ipaddr, netmask, gateway;
 
@@ -207,14 +326,18 @@ void* lwip_add_netif(void *ethif) {
   IP4_ADDR(&netmask, 255,255,255,0);
 //  ipaddr.addr = netmask.addr = gateway.addr = 0;
 
+  LOCK_TCPIP_CORE();
   if (!netif_add(nif, &ipaddr, &netmask, &gateway, ethif, ethernetif_init, tcpip_input)) {
+    UNLOCK_TCPIP_CORE();
     DBG::outl(DBG::Lwip, "LWIP: error in netif_add");
+    kfree(ethif);
     kdelete(nif);
     return nullptr;
   } else {
     netif_set_default(nif);
     netif_set_up(nif);
     dhcp_start(nif);
+    UNLOCK_TCPIP_CORE();
     return nif;
   }
 }
@@ -2,25 +2,36 @@
 #define _lwipopts_h_
 
 #define NO_SYS                          0
-#define LWIP_COMPAT_MUTEX               1
+#define LWIP_COMPAT_MUTEX               0
 #define SYS_LIGHTWEIGHT_PROT            1
 
 //#define LWIP_NETCONN                  	0
 //#define LWIP_NETIF_API                  1
-//#define LWIP_TCPIP_CORE_LOCKING         1
+// API calls and device input run in the calling thread under the core lock
+#define LWIP_TCPIP_CORE_LOCKING         1
+#define LWIP_TCPIP_CORE_LOCKING_INPUT   1
 
 /* Minimal changes to opt.h required for tcp unit tests: */
-#define MEM_SIZE                        16000
-#define TCP_SND_QUEUELEN                40
 #define MEMP_NUM_TCP_SEG                TCP_SND_QUEUELEN
-#define TCP_SND_BUF                     (12 * TCP_MSS)
 #define TCP_WND                         (10 * TCP_MSS)
 
+/* Checksum and segmentation offload (see NETIF_OFFLOAD_* in netif.h): */
+// heap holds outgoing segments: with TSO, a socket's whole send buffer
+// may be a single segment
+#define MEM_SIZE                        (256 * 1024)
+#define TCP_SND_QUEUELEN                96
+#define TCP_SND_BUF                     (44 * TCP_MSS)
+#define TCP_TSO_MAX                     TCP_SND_BUF
+// software fallback sums 64-bit words, see inet_chksum.c
+#define LWIP_CHKSUM_ALGORITHM           4
+
 #define LWIP_HAVE_LOOPIF              	1
 #define LWIP_DHCP                     	1
 #define LWIP_SOCKET                   	1
 #define LWIP_COMPAT_SOCKETS             0
 #define LWIP_POSIX_SOCKETS_IO_NAMES     0
+#define LWIP_TIMEVAL_PRIVATE            0   // struct timeval from libc
+#define LWIP_SO_RCVTIMEO                1   // int msecs, see main/NetBench.cc
 
 #define LWIP_ICMP                       1
 #define ICMP_STATS                      1
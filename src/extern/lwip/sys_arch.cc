@@ -22,7 +22,7 @@ extern "C" u32_t sys_arch_sem_wait(sys_sem_t *sem, u32_t timeout) {
   if (timeout == 0) {
     reinterpret_cast<Semaphore*>(*sem)->P();
     return Clock::now() - before;
-  } else if (reinterpret_cast<Semaphore*>(*sem)->tryP(timeout)) {
+  } else if (reinterpret_cast<Semaphore*>(*sem)->tryP(before + timeout)) {
     return Clock::now() - before;
   } else {
     return SYS_ARCH_TIMEOUT;
@@ -41,6 +41,45 @@ extern "C" void sys_sem_set_invalid(sys_sem_t *sem) {
   *sem = nullptr;
 }
 
+// lwIP mutexes (core lock, heap): critical sections are short, so a
+// contending thread first spins on the owner field, then blocks
+class LwipMutex : public Mutex {
+public:
+  bool held() const { return __atomic_load_n(&owner, __ATOMIC_RELAXED) != nullptr; }
+};
+
+static const mword MutexSpin = 1024;
+
+extern "C" err_t sys_mutex_new(sys_mutex_t *mutex) {
+  *mutex = knew<LwipMutex>();
+  return ERR_OK;
+}
+
+extern "C" void sys_mutex_lock(sys_mutex_t *mutex) {
+  LwipMutex* m = reinterpret_cast<LwipMutex*>(*mutex);
+  for (mword spin = 0; spin < MutexSpin; spin += 1) {
+    if (!m->held() && m->tryAcquire()) return;
+    CPU::Pause();
+  }
+  m->acquire();
+}
+
+extern "C" void sys_mutex_unlock(sys_mutex_t *mutex) {
+  reinterpret_cast<LwipMutex*>(*mutex)->release();
+}
+
+extern "C" void sys_mutex_free(sys_mutex_t *mutex) {
+  kdelete((LwipMutex*)*mutex);
+}
+
+extern "C" int sys_mutex_valid(sys_mutex_t *mutex) {
+  return *mutex != nullptr;
+}
+
+extern "C" void sys_mutex_set_invalid(sys_mutex_t *mutex) {
+  *mutex = nullptr;
+}
+
 typedef MessageQueue<RuntimeRingBuffer<void*,KernelAllocator<void*>>> MQ;
 
 extern "C" err_t sys_mbox_new(sys_mbox_t *mbox, int size) {
@@ -62,7 +101,7 @@ extern "C" u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout
   if (timeout == 0) {
     reinterpret_cast<MQ*>(*mbox)->recv(*msg);
     return Clock::now() - before;
-  } else if (reinterpret_cast<MQ*>(*mbox)->tryRecv(*msg, timeout)) {
+  } else if (reinterpret_cast<MQ*>(*mbox)->tryRecv(*msg, before + timeout)) {
     return Clock::now() - before;
   } else {
     return SYS_ARCH_TIMEOUT;
@@ -97,12 +136,13 @@ extern "C" sys_thread_t sys_thread_new(const char *name, lwip_thread_fn thread,
   return t;
 }
 
-// A lock that serializes all LWIP code
-static OwnerLock* lwipLock;
+// SYS_ARCH_PROTECT: short, nestable sections (pools, socket events);
+// the core lock serializes everything else
+static SpinLock protLock;
+static Thread* protOwner = nullptr;
+static mword protCount = 0;
 
-extern "C" void sys_init(void) {
-  lwipLock = knew<OwnerLock>();
-}
+extern "C" void sys_init(void) {}
 
 extern "C" u32_t sys_jiffies(void) { KABORT0(); return 0; }
 
@@ -111,11 +151,21 @@ extern "C" u32_t sys_now(void) {
 } 
 
 extern "C" sys_prot_t sys_arch_protect(void) {
-  return lwipLock->acquire();
+  Thread* curr = LocalProcessor::getCurrThread();
+  if (protOwner != curr) {
+    protLock.acquire();
+    protOwner = curr;
+  }
+  protCount += 1;
+  return protCount;
 }
 
 extern "C" void sys_arch_unprotect(sys_prot_t pval) {
-  lwipLock->release();
+  protCount -= 1;
+  if (protCount == 0) {
+    protOwner = nullptr;
+    protLock.release();
+  }
 }
 
 extern "C" void lwip_assert(const char* const loc, int line, const char* const func, const char* const msg) {
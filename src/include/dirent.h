@@ -0,0 +1,30 @@
+#ifndef _dirent_h_
+#define _dirent_h_ 1
+
+#include "kostypes.h"
+
+#include <sys/types.h>
+
+#define DT_UNKNOWN 0
+#define DT_DIR     4
+#define DT_REG     8
+
+struct dirent {
+  ino_t         d_ino;
+  unsigned char d_type;
+  char          d_name[64];
+};
+
+typedef struct {
+  int           fd;
+  struct dirent ent;
+} DIR;
+
+extern "C" DIR* opendir(const char* name);
+extern "C" struct dirent* readdir(DIR* dirp);
+extern "C" int closedir(DIR* dirp);
+
+// next entry of directory: 1 if found, 0 at end
+extern "C" int _readdir(int fildes, struct dirent* ent);
+
+#endif /* _dirent_h_ */
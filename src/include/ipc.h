@@ -0,0 +1,21 @@
+#ifndef _ipc_h_
+#define _ipc_h_ 1
+
+#include "syscalls.h"
+
+static const mword IpcWords    = 4;  // payload words (message registers)
+static const mword IpcMaxPages = 16; // pages transferred per message
+
+struct IpcMessage {
+  mword  words[IpcWords];  // payload
+  void*  pages;            // page-aligned buffer; granted to receiver
+  size_t size;             // buffer size, multiple of page size (0: none)
+};
+
+extern "C" int ipcCreate(mword* reid);
+extern "C" int ipcDestroy(mword eid);
+extern "C" int ipc_call(mword eid, IpcMessage* msg);
+// reply to last caller (if 'reply' set), then wait for next call (if 'msg' set)
+extern "C" int ipc_reply_wait(mword eid, IpcMessage* reply, IpcMessage* msg);
+
+#endif /* _ipc_h_ */
@@ -0,0 +1,62 @@
+#ifndef _ring_h_
+#define _ring_h_ 1
+
+#include "syscalls.h"
+
+// Shared submission/completion ring.  The ring lives in user memory: the
+// user advances 'sqTail' and 'cqHead', the kernel advances 'sqHead' and
+// 'cqTail'.  The completion queue holds twice as many entries as the
+// submission queue.
+
+enum RingOp : mword {
+  RingNop = 0,
+  RingRead,            // fd, addr, len
+  RingWrite,           // fd, addr, len
+  RingLseek,           // fd, off, len (whence)
+  RingSemP,            // fd (semaphore id)
+  RingSemV,            // fd (semaphore id)
+  RingOpMax
+};
+
+// flags for ringCreate
+static const mword RingPoll       = 0x1; // kernel poller consumes submissions
+
+// flags set by kernel in RingHead::flags
+static const mword RingNeedWakeup = 0x1; // poller asleep: call ringEnter
+
+struct RingSqe {
+  mword op;
+  mword fd;
+  mword addr;
+  mword len;
+  mword off;
+  mword data;          // opaque, copied to completion
+};
+
+struct RingCqe {
+  mword data;
+  sword result;        // return value of operation (negative errno)
+};
+
+struct RingHead {
+  volatile mword sqHead;
+  volatile mword sqTail;
+  volatile mword cqHead;
+  volatile mword cqTail;
+  volatile mword flags;
+  mword sqEntries;     // power of 2
+  mword cqEntries;     // 2 * sqEntries
+  mword sqOffset;      // offset of RingSqe array from RingHead
+  mword cqOffset;      // offset of RingCqe array from RingHead
+};
+
+static inline RingSqe* ringSqes(RingHead* r) { return (RingSqe*)((char*)r + r->sqOffset); }
+static inline RingCqe* ringCqes(RingHead* r) { return (RingCqe*)((char*)r + r->cqOffset); }
+
+// create ring with (at least) 'entries' submissions, mapped at '*ring'
+extern "C" int ringCreate(mword* rid, size_t entries, mword flags, RingHead** ring);
+extern "C" int ringDestroy(mword rid);
+// process pending submissions (or wake poller); returns number consumed
+extern "C" int ringEnter(mword rid);
+
+#endif /* _ring_h_ */
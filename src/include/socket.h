@@ -0,0 +1,87 @@
+#ifndef _socket_h_
+#define _socket_h_ 1
+
+#include "kostypes.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#if defined(KERNEL)
+#include "lwip/sockets.h"
+#else
+
+// layout and constants follow lwIP, which implements the system calls
+typedef uint32_t socklen_t;
+typedef uint8_t  sa_family_t;
+typedef uint16_t in_port_t;
+typedef uint32_t in_addr_t;
+
+struct in_addr {
+  in_addr_t s_addr;
+};
+
+struct sockaddr_in {
+  uint8_t        sin_len;
+  sa_family_t    sin_family;
+  in_port_t      sin_port;
+  struct in_addr sin_addr;
+  char           sin_zero[8];
+};
+
+struct sockaddr {
+  uint8_t     sa_len;
+  sa_family_t sa_family;
+  char        sa_data[14];
+};
+
+#define SOCK_STREAM     1
+#define SOCK_DGRAM      2
+#define SOCK_RAW        3
+
+#define AF_UNSPEC       0
+#define AF_INET         2
+#define PF_INET         AF_INET
+#define PF_UNSPEC       AF_UNSPEC
+
+#define IPPROTO_IP      0
+#define IPPROTO_TCP     6
+#define IPPROTO_UDP     17
+
+#define SOL_SOCKET      0xfff
+#define SO_REUSEADDR    0x0004
+#define SO_KEEPALIVE    0x0008
+#define SO_BROADCAST    0x0020
+#define SO_LINGER       0x0080
+#define SO_RCVBUF       0x1002
+#define SO_RCVTIMEO     0x1006
+#define SO_ERROR        0x1007
+#define SO_TYPE         0x1008
+#define TCP_NODELAY     0x01
+
+#define MSG_PEEK        0x01
+#define MSG_DONTWAIT    0x08
+#define MSG_MORE        0x10
+
+#define INADDR_ANY       ((in_addr_t)0x00000000)
+#define INADDR_LOOPBACK  ((in_addr_t)0x7f000001)
+#define INADDR_BROADCAST ((in_addr_t)0xffffffff)
+
+static inline uint16_t htons(uint16_t x) { return __builtin_bswap16(x); }
+static inline uint16_t ntohs(uint16_t x) { return __builtin_bswap16(x); }
+static inline uint32_t htonl(uint32_t x) { return __builtin_bswap32(x); }
+static inline uint32_t ntohl(uint32_t x) { return __builtin_bswap32(x); }
+
+#endif /* KERNEL */
+
+extern "C" int socket(int domain, int type, int protocol);
+extern "C" int bind(int sockfd, const struct sockaddr* addr, socklen_t addrlen);
+extern "C" int listen(int sockfd, int backlog);
+extern "C" int accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen);
+extern "C" int connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen);
+extern "C" ssize_t send(int sockfd, const void* buf, size_t len, int flags);
+extern "C" ssize_t recv(int sockfd, void* buf, size_t len, int flags);
+extern "C" ssize_t sendto(int sockfd, const void* buf, size_t len, int flags, const struct sockaddr* addr, socklen_t addrlen);
+extern "C" ssize_t recvfrom(int sockfd, void* buf, size_t len, int flags, struct sockaddr* addr, socklen_t* addrlen);
+extern "C" int setsockopt(int sockfd, int level, int optname, const void* optval, socklen_t optlen);
+
+#endif /* _socket_h_ */
@@ -11,14 +11,39 @@
 
 #define STDDBG_FILENO 3
 
+#ifndef PROT_READ
+#define PROT_NONE     0x0
+#define PROT_READ     0x1
+#define PROT_WRITE    0x2
+#define PROT_EXEC     0x4
+#define MAP_SHARED    0x1
+#define MAP_PRIVATE   0x2
+#define MAP_ANONYMOUS 0x20
+#endif
+
 #define MAP_FAILED  ((void *) -1)
 extern "C" void* mmap(void* addr, size_t len, int prot, int flags, int filedes, off_t off);
 extern "C" int munmap(void* addr, size_t len);
+extern "C" int shm_open(const char *name, int oflag, mode_t mode);
+extern "C" int shm_unlink(const char *name);
 
 extern "C" pid_t getcid();
 
 extern "C" long get_core_count();
 
+extern "C" mword get_time_usecs(); // microseconds since boot
+
+// sampling profiler: sample every 'usecs' on each core, 0 stops
+extern "C" int profile_ctl(mword usecs);
+// write samples as folded stacks to debug output
+extern "C" int profile_dump();
+
+// lock contention report to debug output, optionally reset counters
+extern "C" int lockstat(mword reset);
+
+// per-device interrupt/poll counters to debug output, optionally reset
+extern "C" int pollstat(mword reset);
+
 extern "C" int privilege(void*, mword, mword, mword, mword);
 
 namespace SyscallNum {
@@ -47,6 +72,43 @@ enum : mword {
   semV,
   privilege,
   _init_sig_handler,
+  ipcCreate,
+  ipcDestroy,
+  ipc_call,
+  ipc_reply_wait,
+  ftruncate,
+  shm_open,
+  shm_unlink,
+  ringCreate,
+  ringDestroy,
+  ringEnter,
+  fstat,
+  stat,
+  _readdir,
+  unlink,
+  pread,
+  pwrite,
+  readv,
+  writev,
+  preadv,
+  pwritev,
+  trace_ctl,
+  trace_read,
+  trace_dump,
+  profile_ctl,
+  profile_dump,
+  lockstat,
+  socket,
+  bind,
+  listen,
+  accept,
+  connect,
+  send,
+  recv,
+  _sendto,
+  _recvfrom,
+  setsockopt,
+  pollstat,
   max
 };
 
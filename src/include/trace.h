@@ -0,0 +1,43 @@
+#ifndef _trace_h_
+#define _trace_h_ 1
+
+#include "kostypes.h"
+
+#include <sys/types.h>
+
+// static kernel tracepoints, see kernel/Tracepoint.h
+enum TraceEventId : mword {
+  TraceSwitch = 0,          // arg1: previous thread, arg2: next thread
+  TraceFault,               // B: address/error code, E: address/handled
+  TraceSyscall,             // B: number, E: result
+  TraceIrq,                 // arg1: irq index
+  TraceBlock,               // arg1: thread, arg2: queue
+  TraceResume,              // arg1: thread, arg2: queue
+  TraceFrameAlloc,          // arg1: frame, arg2: size
+  TraceFrameRelease,        // arg1: frame, arg2: size
+  TraceNetInput,            // arg1: bytes
+  TraceNetOutput,           // arg1: bytes
+  TraceMax
+};
+
+#define TRACE_MASK(e) (1ul << (e))
+
+struct TraceRecord {
+  mword    tsc;
+  uint16_t core;
+  uint8_t  event;
+  uint8_t  phase;           // Chrome trace phase: 'B', 'E' or 'i'
+  uint32_t seq;             // per-core sequence number
+  mword    thread;          // current thread: pairs 'B' and 'E' across migration
+  mword    arg1;
+  mword    arg2;
+};
+
+// set event mask, returns previous mask
+extern "C" mword trace_ctl(mword mask);
+// consume up to 'count' buffered records, returns number of records
+extern "C" ssize_t trace_read(struct TraceRecord* buf, size_t count);
+// write buffered records as Chrome trace JSON array to debug output
+extern "C" int trace_dump();
+
+#endif /* _trace_h_ */
@@ -0,0 +1,22 @@
+#ifndef _uio_h_
+#define _uio_h_ 1
+
+#include "kostypes.h"
+
+#include <sys/types.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+struct iovec {
+  void*  iov_base;
+  size_t iov_len;
+};
+
+extern "C" ssize_t readv(int fildes, const struct iovec* iov, int iovcnt);
+extern "C" ssize_t writev(int fildes, const struct iovec* iov, int iovcnt);
+extern "C" ssize_t preadv(int fildes, const struct iovec* iov, int iovcnt, off_t offset);
+extern "C" ssize_t pwritev(int fildes, const struct iovec* iov, int iovcnt, off_t offset);
+
+#endif /* _uio_h_ */
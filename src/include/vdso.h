@@ -0,0 +1,19 @@
+#ifndef _vdso_h_
+#define _vdso_h_ 1
+
+#include "kostypes.h"
+
+// read-only page mapped by the kernel into the top of every user AS
+static const mword VdsoAddress = 0x00007FFFFFFFF000;
+
+struct VdsoData {
+  mword pid;
+  mword processorCount;
+  mword rdtscp;        // TSC_AUX holds core index -> 'rdtscp' returns it
+  mword tscBase;       // TSC at time 0
+  mword tscPerUsec;    // 0: clock not available
+};
+
+static inline const VdsoData* vdso() { return (const VdsoData*)VdsoAddress; }
+
+#endif /* _vdso_h_ */
@@ -28,6 +28,7 @@ struct PageInvalidation : public EmbeddedList<PageInvalidation>::Link {
   size_t             size;
   mword              count;
   bool               alloc;
+  bool               shared;
 };
 
 // TODO: store shared & swapped virtual memory regions in separate data
@@ -108,10 +109,14 @@ class AddressSpace : public Paging {
     KASSERT1( aligned(size, pagesize<N>()), size );
     for (vaddr end = vma + size; vma < end; vma += pagesize<N>()) {
       if (direct) {
-        paddr pma = unmapPage<N>(vma);
+        PageEntry* pe = unmapPage1<N>(vma);
+    if (!pe) continue;
+        bool sh = Paging::shared(pe);
+        paddr pma = unmapPage2(pe);
         DBG::outl(DBG::VM, "AS(", FmtHex(pagetable), ")/unmap: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", FmtHex(pma));
         CPU::InvTLB(vma);
-        if (alloc && pma != lazyPage && pma != guardPage) LocalProcessor::getFrameManager()->releaseFrame<N>(pma);
+        if (sh) LocalProcessor::getFrameManager()->releaseShared(pma);
+        else if (alloc) LocalProcessor::getFrameManager()->releaseFrame<N>(pma);
       } else {
         PageEntry* pe = unmapPage1<N,true>(vma);
     if (!pe) continue;
@@ -124,13 +129,16 @@ class AddressSpace : public Paging {
           pi->size = pagesize<N>();
           pi->count = activeCores;
           pi->alloc = alloc;
+          pi->shared = Paging::shared(pe);
           invList.push_back(*knew2<PageInvalidation>());
           ulock.release();
         } else {
           ulock.release();
+          bool sh = Paging::shared(pe);
           paddr pma = unmapPage2(pe);
           DBG::outl(DBG::VM, "AS(", FmtHex(pagetable), ")/unmap2: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", FmtHex(pma), " PE:", FmtHex(pe));
           CPU::InvTLB(vma);
+          if (sh) LocalProcessor::getFrameManager()->releaseShared(pma);
         }
       }
     }
@@ -170,7 +178,8 @@ class AddressSpace : public Paging {
       if (pi->count == 0) {
         DBG::outl(DBG::VM, "AS(", FmtHex(pagetable), ")/inv: ", FmtHex(pi->vma), '/', FmtHex(pi->size), ":", pi->count, " PE:", FmtHex(pi->pentry));
         paddr pma = unmapPage2(pi->pentry);
-        if (pi->alloc && pma != lazyPage && pma != guardPage) LocalProcessor::getFrameManager()->releaseFrames(pma, pi->size);
+        if (pi->shared) LocalProcessor::getFrameManager()->releaseShared(pma);
+        else if (pi->alloc && pma != lazyPage && pma != guardPage) LocalProcessor::getFrameManager()->releaseFrames(pma, pi->size);
         putVmRange(pi->vma, pi->size);
         invList.remove(*pi);
         kdelete2(pi);
@@ -211,10 +220,10 @@ public:
     invList.push_back(*knew2<PageInvalidation>());
   }
 
-  void initUser(vaddr bssEnd) {
+  void initUser(vaddr bssEnd, vaddr top = usertop) {
     KASSERT0(!kernel);
     mapBottom = bssEnd;
-    mapStart = mapTop = usertop;
+    mapStart = mapTop = top;
   }
 
   PageInvalidation* initProcessor() {
@@ -257,10 +266,8 @@ public:
     return *prevAS;
   }
 
-  template<size_t N, bool alloc=true>
+  template<size_t N, bool alloc=true> // private anonymous memory, read/write
   vaddr map(vaddr addr, size_t size, mword prot, mword flags, mword filedes, mword off, paddr pma = 0) {
-    KASSERT1(prot == 0, prot);
-    KASSERT1(flags == 0, flags);
     KASSERT1(filedes == mword(-1), filedes);
     KASSERT1(off == 0, off);
     vaddr start = getVmRange<N>(addr, size);
@@ -273,6 +280,16 @@ public:
     return start;
   }
 
+  template<size_t N, typename FrameFunc> // map frames provided by frame(i)
+  vaddr mapShared(vaddr addr, size_t size, bool writable, FrameFunc frame) {
+    vaddr start = getVmRange<N>(addr, size);
+    if (start == topaddr) return topaddr;
+    for (size_t i = 0; i < size / pagesize<N>(); i += 1) {
+      mapPageRegion<N,NoAlloc>(frame(i), start + i * pagesize<N>(), pagesize<N>(), (writable ? Data : RoData) | Shared);
+    }
+    return start;
+  }
+
   template<size_t N, bool alloc=true>
   void unmap(vaddr addr, size_t size) {
     KASSERT1(aligned(addr, pagesize<N>()), addr);
@@ -314,6 +331,12 @@ public:
     mapPageRegion<N,Alloc>(0, vma, size, t);
   }
 
+  template<size_t N,bool check=true> // reserve memory at specific virtual address
+  void lazyDirect( vaddr vma, size_t size, PageType t ) {
+    KASSERT1(!check || vma < mapBottom || vma > mapTop, vma);
+    mapPageRegion<N,Lazy>(0, vma, size, t);
+  }
+
   template<size_t N, bool check=true> // unmap & free allocated memory
   void releaseDirect( vaddr vma, size_t size ) {
     KASSERT1(!check || vma < mapBottom || vma > mapTop, vma);
@@ -332,6 +355,60 @@ public:
     unmapPageRegion<N,false,true>(vma, size);
   }
 
+  template<size_t N> // unmap pages, but keep frames for transfer to other AS
+  bool detach(vaddr vma, size_t size, paddr* frames) {
+    if (!aligned(vma, pagesize<N>()) || !aligned(size, pagesize<N>())) return false;
+    if (vma < mapBottom || vma + size > mapTop) return false;
+    for (size_t i = 0; i < size / pagesize<N>(); i += 1) {
+      vaddr va = vma + i * pagesize<N>();
+      ScopedLock<> sl(plock);
+      if (Paging::fault(va, *LocalProcessor::getFrameManager())) {
+        DBG::outl(DBG::VM, "AS(", FmtHex(pagetable), ")/detach fault: ", FmtHex(va));
+      }
+      if (Paging::test(va, Mapped) != pagesize<N>()) return false;
+      if (Paging::shared<N>(va)) return false;
+      frames[i] = Paging::vtop(va);
+    }
+    // NOTE: other cores running this AS may use stale TLB entries until
+    // page invalidation has completed, cf. unmapPageRegion()
+    unmap<N,false>(vma, size);
+    return true;
+  }
+
+  template<size_t N> // map transferred frames at new virtual address range
+  vaddr attach(const paddr* frames, size_t size) {
+    vaddr start = getVmRange<N>(0, size);
+    if (start == topaddr) return topaddr;
+    for (size_t i = 0; i < size / pagesize<N>(); i += 1) {
+      mapPageRegion<N,NoAlloc>(frames[i], start + i * pagesize<N>(), pagesize<N>(), Data);
+    }
+    return start;
+  }
+
+  // Replace private pages of a buffer by copy-on-write mappings of
+  // (unreferenced) frames, e.g., for zero-copy read from ramdisk.  Only
+  // done while no other core runs this AS, since stale TLB entries would
+  // keep pointing to the old pages.
+  bool mapCopyOnWrite(vaddr vma, size_t size, paddr pma) {
+    KASSERT0(!kernel);
+    if (!aligned(vma, pagesize<1>()) || !aligned(size, pagesize<1>())) return false;
+    if (vma < userbot || vma + size > mapTop) return false;
+    ScopedLock<> su(ulock);                   // keeps activeCores stable
+    if (activeCores > 1) return false;
+    ScopedLock<> sp(plock);
+    for (vaddr va = vma; va < vma + size; va += pagesize<1>()) {
+      if (!Paging::replaceable(Paging::entry1(va))) return false;
+    }
+    for (vaddr va = vma; va < vma + size; va += pagesize<1>(), pma += pagesize<1>()) {
+      paddr prev = Paging::setCopyOnWrite(Paging::entry1(va), pma);
+      CPU::InvTLB(va);
+      if (prev != topaddr) LocalProcessor::getFrameManager()->releaseFrame<1>(prev);
+    }
+    return true;
+  }
+
+  inline bool copyOnWrite(vaddr vma);      // page fault handler
+
   void print(ostream& os) const;
 };
 
@@ -342,6 +419,31 @@ inline ostream& operator<<(ostream& os, const AddressSpace& as) {
 
 extern AddressSpace kernelSpace;
 
+// Write fault: copy page to a private frame.  Another core may still hold
+// a stale read-only TLB entry, so a write fault on a page that is already
+// writable is only flushed locally.
+inline bool AddressSpace::copyOnWrite(vaddr vma) {
+  if (kernel || vma >= usertop) return false;
+  vma = align_down(vma, pagesize<1>());
+  ScopedLock<> sl(plock);
+  PageEntry* pe = Paging::entry1(vma);
+  if (!pe || !Paging::copyOnWrite(pe)) {
+    if (!pe || !Paging::writable(pe)) return false;
+    CPU::InvTLB(vma);
+    return true;
+  }
+  FrameManager& fm = *LocalProcessor::getFrameManager();
+  paddr pma = fm.allocFrame<1>();
+  KASSERT0(pma != topaddr);
+  vaddr kva = kernelSpace.kmap<1,false>(0, pagesize<1>(), pma);
+  memcpy((ptr_t)kva, (ptr_t)vma, pagesize<1>());
+  kernelSpace.unmap<1,false>(kva, pagesize<1>());
+  paddr prev = Paging::breakCopyOnWrite(pe, pma);
+  CPU::InvTLB(vma);
+  fm.releaseShared(prev);
+  return true;
+}
+
 inline AddressSpace::AddressSpace(const bool k) : activeCores(0),
   pagetable(topaddr), mapBottom(0), mapStart(0), mapTop(0), kernel(k) {
   if (!kernel) { // shallow copy; clone from user AS -> make deep copy!
@@ -21,9 +21,24 @@
 
 class Clock : public NoObject {
   static volatile mword tick;
+  static mword tscBase;     // TSC at tick 0
+  static mword tscPerUsec;  // 0: not calibrated
 public:
   static void ticker() { tick += 1; }
   static mword now() { return tick; }
+  static mword getTscBase() { return tscBase; }
+  static mword getTscPerUsec() { return tscPerUsec; }
+  // measure TSC rate against timer ticks; needs timer interrupts
+  static void calibrate(mword ticksPerSecond, mword ticks = 50) {
+    mword start = tick;
+    while (tick == start) CPU::Pause();     // align with tick edge
+    start = tick;
+    mword tsc = CPU::readTSC();
+    while (tick < start + ticks) CPU::Pause();
+    mword tpt = (CPU::readTSC() - tsc) / (tick - start);
+    tscPerUsec = tpt * ticksPerSecond / 1000000;
+    tscBase = tsc - start * tpt;
+  }
   static void wait(mword ticks) {
     mword start = tick;
     while (tick < start + ticks) CPU::Pause();
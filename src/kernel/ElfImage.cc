@@ -0,0 +1,70 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/ElfImage.h"
+#include "kernel/MemoryManager.h"
+#include "kernel/Output.h"
+#include "world/KernelFS.h"
+#include "extern/elfio/elf_types.hpp"
+
+using namespace ELFIO;
+
+bool ElfImage::parse(const RamFile& rf) {
+  if (rf.size < sizeof(Elf64_Ehdr)) return false;
+  const Elf64_Ehdr* eh = (const Elf64_Ehdr*)rf.vma;
+  if (eh->e_ident[EI_MAG0] != ELFMAG0 || eh->e_ident[EI_MAG1] != ELFMAG1
+    || eh->e_ident[EI_MAG2] != ELFMAG2 || eh->e_ident[EI_MAG3] != ELFMAG3) return false;
+  if (eh->e_ident[EI_CLASS] != ELFCLASS64 || eh->e_machine != EM_X86_64) return false;
+  if (eh->e_phentsize != sizeof(Elf64_Phdr)) return false;
+  if (eh->e_phoff + eh->e_phnum * sizeof(Elf64_Phdr) > rf.size) return false;
+
+  entry = eh->e_entry;
+  const Elf64_Phdr* ph = (const Elf64_Phdr*)(rf.vma + eh->e_phoff);
+  for (size_t i = 0; i < eh->e_phnum; i += 1) {
+    if (ph[i].p_type != PT_LOAD) continue;     // not a loadable segment
+    if (ph[i].p_offset + ph[i].p_filesz > rf.size) return false;
+    if (ph[i].p_memsz < ph[i].p_filesz) return false;
+    // file offset and virtual address must be congruent modulo page size
+    if (pageoffset<1>(ph[i].p_offset) != pageoffset<1>(ph[i].p_vaddr)) return false;
+    if (count == maxSegments) return false;
+    ElfSegment& s = segment[count];
+    s.vma = ph[i].p_vaddr;
+    s.offset = ph[i].p_offset;
+    s.fileSize = ph[i].p_filesz;
+    s.memSize = ph[i].p_memsz;
+    s.writable = ph[i].p_flags & PF_W;
+    s.executable = ph[i].p_flags & PF_X;
+    count += 1;
+  }
+  return true;
+}
+
+ElfImage* ElfImage::get(RamFile& rf) {
+  ElfImage* img = __atomic_load_n(&rf.image, __ATOMIC_ACQUIRE);
+  if fastpath(img) return img;
+  img = knew<ElfImage>();
+  if (!img->parse(rf)) {
+    kdelete(img);
+    return nullptr;
+  }
+  ElfImage* expected = nullptr;           // concurrent exec: first one wins
+  if (!__atomic_compare_exchange_n(&rf.image, &expected, img, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    kdelete(img);
+    return expected;
+  }
+  DBG::outl(DBG::Process, "ELF image: ", FmtHex(rf.vma), " entry ", FmtHex(img->entry), ", ", img->count, " segments");
+  return img;
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _ElfImage_h_
+#define _ElfImage_h_ 1
+
+#include "generic/basics.h"
+
+struct RamFile;
+
+// Loadable segments of an ELF executable, parsed once per boot module and
+// cached in its RamFile, so repeated exec of the same program does not
+// parse the file again.
+struct ElfSegment {
+  vaddr  vma;
+  mword  offset;              // file offset
+  size_t fileSize;
+  size_t memSize;
+  bool   writable;
+  bool   executable;
+};
+
+class ElfImage {
+  static const size_t maxSegments = 8;
+  bool parse(const RamFile& rf);
+
+public:
+  ElfImage() : entry(0), count(0) {}
+  vaddr entry;
+  size_t count;
+  ElfSegment segment[maxSegments];
+
+  // cached image of boot module; nullptr, if not a valid executable
+  static ElfImage* get(RamFile& rf);
+};
+
+#endif /* _ElfImage_h_ */
@@ -20,10 +20,10 @@
 #include "generic/Bitmap.h"
 #include "kernel/MemoryManager.h"
 #include "kernel/Output.h"
+#include "kernel/Tracepoint.h"
 
 #include <map>
 
-// TODO: store shared frames in separate data structure, including refcounter
 class FrameManager {
   friend ostream& operator<<(ostream&, const FrameManager&);
 
@@ -50,6 +50,10 @@ class FrameManager {
   SpinLock splock;      // small page lock
   SFBitmap smallFrames; // small page container
 
+  typedef map<paddr,mword,less<paddr>,MapAllocator<paddr>> SFRefCount;
+  SpinLock shlock;      // shared frame lock
+  SFRefCount sharedFrames; // reference counts of shared small frames
+
   size_t bitcount; // for output, see ostream operator
 
   size_t releaseSmall(paddr addr, size_t size = sps) {
@@ -113,6 +117,7 @@ public:
     default: KABORT1(N);
     }
     DBG::outl(DBG::Frame, "FM/alloc<", N, ">: ", FmtHex(addr));
+    Tracepoint::instant(TraceFrameAlloc, addr, pagesize<N>());
     return addr;
   }
 
@@ -131,6 +136,29 @@ public:
     default: KABORT1(N);
     }
     DBG::outl(DBG::Frame, "FM/release<", N, ">: ", FmtHex(addr));
+    Tracepoint::instant(TraceFrameRelease, addr, pagesize<N>());
+  }
+
+  // add reference to small frame that is mapped in multiple places
+  void shareFrame( paddr addr ) {
+    KASSERT1( aligned(addr, sps), addr );
+    ScopedLock<> sl(shlock);
+    sharedFrames[addr] += 1;
+  }
+
+  // drop reference; frames without reference count (e.g., ramdisk) are kept
+  void releaseShared( paddr addr ) {
+    shlock.acquire();
+    auto it = sharedFrames.find(addr);
+    if (it == sharedFrames.end()) {
+      shlock.release();
+      return;
+    }
+    it->second -= 1;
+    bool last = (it->second == 0);
+    if (last) sharedFrames.erase(it);
+    shlock.release();
+    if (last) releaseFrame<spl>(addr);
   }
 
   void releaseFrames( paddr addr, size_t size ) {
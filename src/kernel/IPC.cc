@@ -0,0 +1,222 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "runtime/Scheduler.h"
+#include "runtime/Thread.h"
+#include "kernel/IPC.h"
+
+SpinLock IpcEndpoint::storeLock;
+ManagedArray<IpcEndpoint*,KernelAllocator> IpcEndpoint::store;
+
+// caller blocked: still queued, or delivered and waiting for reply
+class IpcEndpoint::CallInfo : public UnblockInfo {
+  IpcEndpoint& ep;
+  IpcTransfer& t;
+public:
+  CallInfo(IpcEndpoint& ep, IpcTransfer& t) : ep(ep), t(t) {}
+  virtual void cancelBlocking(Thread&) {
+    ScopedLock<> sl(ep.lock);
+    if (t.onList()) {
+      ep.senders.remove(t);
+      IpcEndpoint::release(t);
+    } else if (t.server) {
+      if (userThread(t.server)->ipcCaller == &t) userThread(t.server)->ipcCaller = nullptr;
+      if (!t.accepted) IpcEndpoint::release(t);
+      ep.active -= 1;
+    }
+  }
+};
+
+// receiver blocked: waiting for caller
+class IpcEndpoint::WaitInfo : public UnblockInfo {
+  IpcEndpoint& ep;
+public:
+  WaitInfo(IpcEndpoint& ep) : ep(ep) {}
+  virtual void cancelBlocking(Thread& t) {
+    ScopedLock<> sl(ep.lock);
+    if (t.onList()) ep.receivers.remove(t);
+  }
+};
+
+bool IpcEndpoint::valid(mword eid) {
+  ScopedLock<> sl(storeLock);
+  return store.valid(eid);
+}
+
+// returns endpoint with lock held
+IpcEndpoint* IpcEndpoint::acquire(mword eid) {
+  ScopedLock<> sl(storeLock);
+  if (!store.valid(eid)) return nullptr;
+  IpcEndpoint* ep = store.get(eid);
+  ep->lock.acquire();
+  return ep;
+}
+
+ssize_t IpcEndpoint::stage(IpcTransfer& t, const IpcMessage& msg) {
+  for (mword i = 0; i < IpcWords; i += 1) t.words[i] = msg.words[i];
+  t.size = msg.size;
+  if (t.size == 0) return 0;
+  if (t.size > IpcMaxPages * pagesize<1>()) return -EINVAL;
+  if (!CurrProcess().detach<1>(vaddr(msg.pages), t.size, t.frames)) return -EFAULT;
+  return 0;
+}
+
+ssize_t IpcEndpoint::unstage(const IpcTransfer& t, IpcMessage& msg) {
+  for (mword i = 0; i < IpcWords; i += 1) msg.words[i] = t.words[i];
+  msg.pages = nullptr;
+  msg.size = t.size;
+  if (t.size == 0) return 0;
+  vaddr va = CurrProcess().attach<1>(t.frames, t.size);
+  if (va == topaddr) {
+    IpcTransfer tmp = t;
+    release(tmp);
+    msg.size = 0;
+    return -ENOMEM;
+  }
+  msg.pages = (void*)va;
+  return 0;
+}
+
+void IpcEndpoint::release(IpcTransfer& t) {
+  for (size_t i = 0; i < t.size / pagesize<1>(); i += 1) {
+    LocalProcessor::getFrameManager()->releaseFrame<1>(t.frames[i]);
+  }
+  t.size = 0;
+}
+
+void IpcEndpoint::deliver(IpcTransfer& t, Thread* server) { // lock held
+  t.server = server;
+  userThread(server)->ipcCaller = &t;
+  active += 1;
+}
+
+ssize_t IpcEndpoint::create(mword& eid) {
+  ScopedLock<> sl(storeLock);
+  IpcEndpoint* ep = knew<IpcEndpoint>();
+  eid = ep->id = store.put(ep);
+  return 0;
+}
+
+ssize_t IpcEndpoint::destroy(mword eid) {
+  ScopedLock<> sl(storeLock);
+  if (!store.valid(eid)) return -EINVAL;
+  IpcEndpoint* ep = store.get(eid);
+  ep->lock.acquire();
+  bool busy = !ep->senders.empty() || !ep->receivers.empty() || ep->active;
+  ep->lock.release();
+  if (busy) return -EBUSY;
+  store.remove(eid);
+  kdelete(ep);
+  return 0;
+}
+
+ssize_t IpcEndpoint::call(mword eid, IpcMessage& msg) {
+  if (!valid(eid)) return -EINVAL;
+  IpcTransfer t;
+  ssize_t err = stage(t, msg);
+  if (err) return err;
+  IpcEndpoint* ep = acquire(eid);
+  if (!ep) {                               // destroyed concurrently
+    release(t);
+    return -EINVAL;
+  }
+  Thread* curr = Runtime::getCurrThread();
+  t.caller = curr;
+  CallInfo ci(*ep, t);
+  if (!curr->block(&ci)) {                 // cancelled
+    ep->lock.release();
+    release(t);
+    return -EINTR;
+  }
+  for (;;) {
+    if (ep->receivers.empty()) {
+      ep->senders.push_back(t);
+      Runtime::getScheduler()->suspend(ep->lock);
+      break;
+    }
+    Thread* server = ep->receivers.pop_front();
+    if (server->unblock()) {               // direct switch to receiver
+      ep->deliver(t, server);
+      Runtime::getScheduler()->handoff(*server, ep->lock);
+      break;
+    }
+  }
+  return unstage(t, msg);                  // 't' now holds reply
+}
+
+ssize_t IpcEndpoint::replyWait(mword eid, IpcMessage* reply, IpcMessage* msg) {
+  Thread* curr = Runtime::getCurrThread();
+  Process::UserThread* ut = userThread(curr);
+  Thread* caller = nullptr;
+  IpcEndpoint* ep = nullptr;
+
+  if (reply) {
+    if (!ut->ipcEndpoint) return -EINVAL;  // nothing to reply to
+    IpcTransfer rt;
+    ssize_t err = stage(rt, *reply);
+    if (err) return err;
+    ep = ut->ipcEndpoint;
+    ut->ipcEndpoint = nullptr;
+    ep->lock.acquire();
+    IpcTransfer* t = ut->ipcCaller;
+    ut->ipcCaller = nullptr;
+    if (t && t->caller->unblock()) {
+      for (mword i = 0; i < IpcWords; i += 1) t->words[i] = rt.words[i];
+      t->size = rt.size;
+      for (size_t i = 0; i < rt.size / pagesize<1>(); i += 1) t->frames[i] = rt.frames[i];
+      ep->active -= 1;
+      caller = t->caller;
+    } else {                               // caller cancelled
+      release(rt);
+    }
+    if (!msg || ep->id != eid) {
+      ep->lock.release();
+      if (caller) Scheduler::resume(*caller);
+      caller = nullptr;
+      ep = nullptr;
+    }
+  }
+
+  if (!msg) return 0;                      // reply only
+  if (!ep) {
+    ep = acquire(eid);
+    if (!ep) return -EINVAL;
+  }
+  while (!ut->ipcCaller) {
+    if (!ep->senders.empty()) {
+      ep->deliver(*ep->senders.pop_front(), curr);
+      break;
+    }
+    WaitInfo wi(*ep);
+    if (!curr->block(&wi)) {               // cancelled
+      ep->lock.release();
+      if (caller) Scheduler::resume(*caller);
+      return -EINTR;
+    }
+    ep->receivers.push_back(*curr);
+    if (caller) Runtime::getScheduler()->handoff(*caller, ep->lock);
+    else Runtime::getScheduler()->suspend(ep->lock);
+    caller = nullptr;
+    ep->lock.acquire();                    // caller might be cancelled
+  }
+  IpcTransfer* t = ut->ipcCaller;
+  t->accepted = true;
+  IpcTransfer in = *t;
+  ut->ipcEndpoint = ep;
+  ep->lock.release();
+  if (caller) Scheduler::resume(*caller);
+  return unstage(in, *msg);
+}
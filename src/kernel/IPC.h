@@ -0,0 +1,72 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _IPC_h_
+#define _IPC_h_ 1
+
+#include "generic/EmbeddedContainers.h"
+#include "generic/ManagedArray.h"
+#include "runtime/BlockingSync.h"
+#include "kernel/Process.h"
+
+#include "ipc.h"
+
+// message in transit: lives on caller's kernel stack until reply
+struct IpcTransfer : public EmbeddedList<IpcTransfer>::Link {
+  Thread* caller;
+  Thread* server;             // receiving thread, set upon delivery
+  bool    accepted;           // server has taken words/frames
+  mword   words[IpcWords];
+  size_t  size;
+  paddr   frames[IpcMaxPages];
+  IpcTransfer() : caller(nullptr), server(nullptr), accepted(false), size(0) {}
+};
+
+// synchronous rendezvous endpoint: a caller blocks until a receiver has
+// replied; buffer pages are granted by moving frames between AS's
+class IpcEndpoint {
+  static SpinLock storeLock;
+  static ManagedArray<IpcEndpoint*,KernelAllocator> store;
+
+  class CallInfo;
+  class WaitInfo;
+
+  BasicLock lock;
+  mword id;
+  EmbeddedList<IpcTransfer> senders; // callers waiting for receiver
+  EmbeddedList<Thread> receivers;    // receivers waiting for caller
+  mword active;                      // calls delivered, but not replied
+
+  static Process::UserThread* userThread(Thread* t) {
+    return reinterpret_cast<Process::UserThread*>(t);
+  }
+  static bool valid(mword eid);
+  static IpcEndpoint* acquire(mword eid);
+  static ssize_t stage(IpcTransfer& t, const IpcMessage& msg);
+  static ssize_t unstage(const IpcTransfer& t, IpcMessage& msg);
+  static void release(IpcTransfer& t);
+
+  void deliver(IpcTransfer& t, Thread* server);
+
+public:
+  IpcEndpoint() : id(0), active(0) {}
+  static ssize_t create(mword& eid);
+  static ssize_t destroy(mword eid);
+  static ssize_t call(mword eid, IpcMessage& msg);
+  static ssize_t replyWait(mword eid, IpcMessage* reply, IpcMessage* msg);
+};
+
+#endif /* _IPC_h_ */
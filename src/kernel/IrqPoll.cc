@@ -0,0 +1,89 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "runtime/Thread.h"
+#include "runtime/Scheduler.h"
+#include "kernel/IrqPoll.h"
+#include "kernel/Output.h"
+#include "machine/Machine.h"
+
+IrqPoll* IrqPoll::registry = nullptr;
+
+void IrqPoll::start(mword i) {
+  irq = i;
+  next = __atomic_load_n(&registry, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&registry, &next, this, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  // default priority: a poll thread under load must not starve the
+  // threads consuming its packets (receive livelock)
+  Thread::create()->start((ptr_t)loop, (ptr_t)this);
+  Machine::registerIrqPoll(irq, this);
+}
+
+// an irq targets a single core at a time: no concurrent invocations
+void IrqPoll::interrupt() {
+  if (!mask(ctx)) return;
+  interrupts += 1;
+  schedule();
+}
+
+// e.g., device found with work pending while unmasking
+void IrqPoll::schedule() {
+  if (!__atomic_exchange_n(&scheduled, true, __ATOMIC_ACQUIRE)) {
+    raised = CPU::readTSC();
+    sem.V();
+  }
+}
+
+void IrqPoll::loop(IrqPoll* ip) {
+  for (;;) {
+    ip->sem.P();
+    // run on the core taking the interrupt; follows irq retargeting
+    mword core = Machine::getIrqAffinity(ip->irq);
+    if (core != LocalProcessor::getIndex()) {
+      Machine::setAffinity(*LocalProcessor::getCurrThread(), core);
+      LocalProcessor::getScheduler()->yield();
+    }
+    mword latency = CPU::readTSC() - ip->raised;
+    ip->wakeups += 1;
+    ip->latencySum += latency;
+    if (latency > ip->latencyMax) ip->latencyMax = latency;
+    for (;;) {
+      size_t n = ip->poll(ip->ctx, ip->budget);
+      ip->polls += 1;
+      ip->packets += n;
+      if (n < ip->budget) break;
+      ip->fullPolls += 1;
+      LocalProcessor::getScheduler()->yield();
+    }
+    // clear before unmasking: the next interrupt must wake the thread
+    __atomic_store_n(&ip->scheduled, false, __ATOMIC_RELEASE);
+    ip->unmask(ip->ctx);
+  }
+}
+
+void IrqPoll::report(bool reset) {
+  StdDbg.lock();
+  StdDbg.print("irq_poll: device     irq  interrupts       polls  full-polls     packets  pkts/poll  lat-avg  lat-max (cycles)", kendl);
+  for (IrqPoll* ip = __atomic_load_n(&registry, __ATOMIC_ACQUIRE); ip; ip = ip->next) {
+    mword perPoll = ip->polls ? ip->packets / ip->polls : 0;
+    mword latency = ip->wakeups ? ip->latencySum / ip->wakeups : 0;
+    StdDbg.print("irq_poll: ", ip->name, ' ', ip->irq, ' ', ip->interrupts, ' ', ip->polls,
+      ' ', ip->fullPolls, ' ', ip->packets, ' ', perPoll, ' ', latency, ' ', ip->latencyMax, kendl);
+    if (reset) ip->interrupts = ip->polls = ip->fullPolls = ip->packets = 0;
+    if (reset) ip->wakeups = ip->latencySum = ip->latencyMax = 0;
+  }
+  StdDbg.unlock();
+}
@@ -0,0 +1,78 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _IrqPoll_h_
+#define _IrqPoll_h_ 1
+
+#include "runtime/BlockingSync.h"
+
+// Hybrid interrupt/polling device service (NAPI-style): the interrupt
+// masks the device's interrupts and wakes a per-device thread.  The
+// thread processes up to 'budget' packets per pass and keeps polling,
+// yielding between passes, as long as passes use up their budget.  Once
+// a pass comes up short, the device is drained and interrupts are
+// unmasked again.  Under load, the device is thus serviced without any
+// interrupts; when idle, a packet still gets immediate attention.
+// Devices sharing an interrupt line each check their own status in 'mask'.
+class IrqPoll {
+public:
+  typedef int    (*MaskFunc)(ptr_t ctx);  // nonzero: device has raised irq
+  typedef size_t (*PollFunc)(ptr_t ctx, size_t budget);
+  typedef void   (*UnmaskFunc)(ptr_t ctx);
+
+private:
+  IrqPoll*    next;       // registry, devices are never removed
+  IrqPoll*    shared;     // next device on the same irq
+  const char* name;
+  mword       irq;
+  ptr_t       ctx;
+  MaskFunc    mask;       // interrupt context: acknowledge & mask
+  PollFunc    poll;       // thread context: process at most 'budget'
+  UnmaskFunc  unmask;
+  size_t      budget;
+  bool        scheduled;  // thread woken or polling, device masked
+  Semaphore   sem;
+
+  mword interrupts;
+  mword polls;
+  mword fullPolls;        // passes that used up the budget
+  mword packets;
+  mword raised;           // TSC at wakeup
+  mword wakeups;
+  mword latencySum;       // wakeup -> polling starts (cycles)
+  mword latencyMax;
+
+  static IrqPoll* registry;
+  static void loop(IrqPoll* ip);
+
+public:
+  IrqPoll(const char* n, ptr_t c, MaskFunc m, PollFunc p, UnmaskFunc u, size_t b = 64)
+  : next(nullptr), shared(nullptr), name(n), irq(0), ctx(c), mask(m), poll(p), unmask(u),
+    budget(b), scheduled(false), interrupts(0), polls(0), fullPolls(0), packets(0),
+    raised(0), wakeups(0), latencySum(0), latencyMax(0) {}
+
+  IrqPoll* getShared() const { return shared; }
+  void setShared(IrqPoll* s) { shared = s; }
+
+  void start(mword irq);  // take over 'irq', start thread
+  void interrupt();       // called from interrupt handler
+  void schedule();        // wake thread; caller has masked the device
+
+  // print per-device counters to debug output, optionally reset
+  static void report(bool reset);
+};
+
+#endif /* _IrqPoll_h_ */
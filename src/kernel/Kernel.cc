@@ -18,6 +18,8 @@
 #include "kernel/AddressSpace.h"
 #include "kernel/Clock.h"
 #include "kernel/Output.h"
+#include "kernel/Profiler.h"
+#include "kernel/Tracepoint.h"
 #include "world/Access.h"
 #include "machine/Machine.h"
 #include "devices/Keyboard.h"
@@ -26,6 +28,8 @@
 
 AddressSpace kernelSpace(true); // AddressSpace.h
 volatile mword Clock::tick;     // Clock.h
+mword Clock::tscBase = 0;       // Clock.h
+mword Clock::tscPerUsec = 0;    // Clock.h
 
 extern Keyboard keyboard;
 
@@ -39,12 +43,18 @@ static void keybLoop() {
 #endif
 
 void kosMain() {
+  KernelOutput::startDrain();
+#if TESTING_DEBUG_TRACE
+  DebugTrace::start();
+#endif
+  Tracepoint::init();
+  Profiler::init();
   KOUT::outl("Welcome to KOS!", kendl);
-  auto iter = kernelFS.find("motb");
-  if (iter == kernelFS.end()) {
+  Dentry* motb = kernelFS.lookup("motb");
+  if (!motb || motb->isDir()) {
     KOUT::outl("motb information not found");
   } else {
-    FileAccess f(iter->second);
+    FileAccess f(*motb);
     for (;;) {
       char c;
       if (f.read(&c, 1) == 0) break;
@@ -171,7 +171,12 @@ void Multiboot::readModules(vaddr disp) {
       multiboot_tag_module* tm = (multiboot_tag_module*)tag;
       string cmd = tm->cmdline;
       string name = cmd.substr(0, cmd.find_first_of(' '));
-      kernelFS.insert( {name, {tm->mod_start + disp, tm->mod_start, tm->mod_end - tm->mod_start}} );
+      RamFile* rf = knew<RamFile>(tm->mod_start + disp, tm->mod_start, tm->mod_end - tm->mod_start);
+      if (!kernelFS.insert(name.c_str(), rf)) {
+        DBG::outl(DBG::Boot, "duplicate or invalid module name: ", name);
+        kdelete(rf);
+      }
     }
   }
+  kernelFS.mkdir("tmp");                    // scratch directory for tmpfs
 }
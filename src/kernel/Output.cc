@@ -14,8 +14,12 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
+#include "runtime/BlockingSync.h"
+#include "runtime/Thread.h"
+#include "kernel/Clock.h"
 #include "kernel/MemoryManager.h"
 #include "kernel/Output.h"
+#include "machine/Machine.h"
 #include "devices/Screen.h"
 #include "devices/Serial.h"
 
@@ -41,7 +45,7 @@ static ScreenBuffer bot_screen( 21, 25 );
 class DebugBuffer : public OutputBuffer<char> {
 protected:
   virtual streamsize xsputn(const char* s, streamsize n) {
-    for (streamsize i = 0; i < n; i += 1) DebugDevice::write(s[i]);
+    DebugDevice::write(s, n);
     return n;
   }
 };
@@ -52,6 +56,108 @@ KernelOutput StdOut(top_screen);
 KernelOutput StdErr(bot_screen);
 KernelOutput StdDbg(dbg_buffer);
 
+KernelOutput* const KernelOutput::outputs[outputCount] = { &StdOut, &StdErr, &StdDbg };
+
+LogRing::LogRing(KernelOutput& ko)
+: ko(ko), buf(knewN<char>(ringSize)), head(0), tail(0), next(0) {}
+
+streamsize LogRing::xsputn(const char* s, streamsize n) {
+  for (size_t done = 0; done < size_t(n); ) {
+    size_t space = ringSize - (next - __atomic_load_n(&head, __ATOMIC_ACQUIRE));
+    if slowpath(space == 0) {       // full: publish partial record, drain
+      publish();
+      ko.flush();
+      continue;
+    }
+    size_t idx = next % ringSize;
+    size_t len = min(min(space, ringSize - idx), size_t(n) - done);
+    memcpy(buf + idx, s + done, len);
+    next += len;
+    done += len;
+  }
+  return n;
+}
+
+// output lock held: write published records to sink in contiguous batches
+void LogRing::drain(OutputBuffer<char>& sink) {
+  mword t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+  while (head != t) {
+    size_t idx = head % ringSize;
+    size_t len = min(t - head, ringSize - idx);
+    sink.sputn(buf + idx, len);
+    __atomic_store_n(&head, head + len, __ATOMIC_RELEASE);
+  }
+}
+
+void KernelOutput::startDrain() {
+  mword count = Machine::getProcessorCount();
+  for (mword i = 0; i < outputCount; i += 1) {
+    KernelOutput* o = outputs[i];
+    CoreLog** l = knewN<CoreLog*>(count);
+    for (mword i = 0; i < count; i += 1) l[i] = knew<CoreLog>(*o);
+    ScopedLock<> sl(o->olock);
+    o->logCount = count;
+    __atomic_store_n(&o->logs, l, __ATOMIC_RELEASE);
+  }
+  // default priority: the scheduler does not pick other threads at
+  // idlePriority; the drainer sleeps between rounds
+  Thread::create()->start((ptr_t)drainLoop);
+}
+
+void KernelOutput::drainLoop() {
+  for (;;) {
+    flushAll();
+    Timeout::sleep(Clock::now() + drainInterval);
+  }
+}
+
+DebugTrace::CoreTrace* DebugTrace::traces = nullptr;
+mword DebugTrace::traceCount = 0;
+
+void DebugTrace::start() {
+  mword count = Machine::getProcessorCount();
+  CoreTrace* t = knewN<CoreTrace>(count);
+  for (mword i = 0; i < count; i += 1) {
+    t[i].ring = knewN<Record>(ringRecords);
+    t[i].next = 0;
+  }
+  traceCount = count;
+  __atomic_store_n(&traces, t, __ATOMIC_RELEASE);
+}
+
+void DebugTrace::write(mword level, const mword* vals, size_t n) {
+  LocalProcessor::lock();
+  mword core = LocalProcessor::getIndex();
+  CoreTrace& ct = traces[core];
+  Record& r = ct.ring[ct.next % ringRecords];
+  r.tsc = CPU::readTSC();
+  r.core = core;
+  r.level = level;
+  r.seq = ct.next;
+  r.event = n ? vals[0] : 0;
+  r.argc = n > 1 ? min(n - 1, maxArgs) : 0;
+  for (size_t i = 0; i < r.argc; i += 1) r.args[i] = vals[i+1];
+  ct.next += 1;
+  LocalProcessor::unlock();
+}
+
+// stop tracing and write remaining records to debug output, oldest first
+void DebugTrace::dump() {
+  CoreTrace* t = __atomic_exchange_n(&traces, nullptr, __ATOMIC_ACQ_REL);
+  if (!t) return;
+  StdDbg.lock();
+  for (mword c = 0; c < traceCount; c += 1) {
+    mword first = t[c].next > ringRecords ? t[c].next - ringRecords : 0;
+    for (mword s = first; s < t[c].next; s += 1) {
+      const mword* w = (const mword*)&t[c].ring[s % ringRecords];
+      StdDbg.print("TRACE");
+      for (size_t i = 0; i < sizeof(Record) / sizeof(mword); i += 1) StdDbg.print(' ', FmtHex(w[i]));
+      StdDbg.print(kendl);
+    }
+  }
+  StdDbg.unlock();
+}
+
 static const char* options[] = {
   "acpi",
   "boot",
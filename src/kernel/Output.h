@@ -21,6 +21,12 @@
 #include "machine/SpinLock.h"
 
 #include <cstdarg>
+#include <type_traits>
+
+// debug levels compiled in: bit per DBG::Level, see testoptions.h
+#ifndef TESTING_DEBUG_MASK
+#define TESTING_DEBUG_MASK (~0ul)
+#endif
 
 static const char kendl = '\n';
 
@@ -40,34 +46,122 @@ protected:
   virtual int sync() { return BaseClass::sync(); }
 };
 
+class KernelOutput;
+
+// Per-core log ring: the owning core is the only producer (interrupts
+// disabled), consumers are serialized by the output lock.  Records become
+// visible to the consumer when published.  A full ring is drained
+// synchronously by the producer.
+class LogRing : public OutputBuffer<char> {
+  static const size_t ringSize = 16384;
+  KernelOutput& ko;
+  char* buf;
+  volatile mword head;      // consumer position
+  volatile mword tail;      // published producer position
+  mword next;               // producer position
+protected:
+  virtual streamsize xsputn(const char* s, streamsize n);
+public:
+  LogRing(KernelOutput& ko);
+  void publish() { __atomic_store_n(&tail, next, __ATOMIC_RELEASE); }
+  void drain(OutputBuffer<char>& sink);
+};
+
 class KernelOutput {
-  SpinLock olock;
+  friend class LogRing;
+
+  struct CoreLog {
+    LogRing ring;
+    ostream os;
+    CoreLog(KernelOutput& ko) : ring(ko), os(&ring) {}
+  };
+
+  SpinLock olock;           // serializes access to sink
+  OutputBuffer<char>& ob;
   ostream os;
+  CoreLog** logs;           // per-core rings; nullptr: write through
+  mword logCount;
 
-public:
-  KernelOutput( OutputBuffer<char>& ob ) : os(&ob) {}
+  // fixed set, so that rerunning global constructors cannot relink it
+  static const mword outputCount = 3;
+  static KernelOutput* const outputs[outputCount];
+  static const mword drainInterval = 10;
 
-  void lock() { olock.acquire(); }
-  void unlock() { olock.release(); }
+  void drainLocked() {
+    for (mword i = 0; i < logCount; i += 1) logs[i]->ring.drain(ob);
+  }
 
-  void print() {}
+  static void put(ostream&) {}
 
   template<typename T, typename... Args>
-  void print( const T& msg, const Args&... a ) {
-    os << msg;
-    print(a...);
+  static void put(ostream& o, const T& msg, const Args&... a) {
+    o << msg;
+    put(o, a...);
+  }
+
+  static void drainLoop();
+
+public:
+  KernelOutput( OutputBuffer<char>& ob )
+  : ob(ob), os(&ob), logs(nullptr), logCount(0) {}
+
+  // switch all outputs to per-core rings and start the drain thread
+  static void startDrain();
+  // drain rings synchronously
+  void flush() {
+    ScopedLock<> sl(olock);
+    drainLocked();
+  }
+  static void flushAll() {
+    for (mword i = 0; i < outputCount; i += 1) outputs[i]->flush();
+  }
+  // before reboot: drain rings and write through from now on
+  static void panic() {
+    for (mword i = 0; i < outputCount; i += 1) {
+      KernelOutput* o = outputs[i];
+      ScopedLock<> sl(o->olock);
+      o->drainLocked();
+      o->logs = nullptr;
+      o->logCount = 0;
+    }
+  }
+
+  // direct access to sink, e.g., for KASSERT; rings are drained first
+  void lock() { olock.acquire(); drainLocked(); }
+  void unlock() { olock.release(); }
+
+  template<typename... Args>
+  void print( const Args&... a ) {
+    put(os, a...);
   }
 
   template<typename T, typename... Args>
   void printl( const T& msg, const Args&... a ) {
-    ScopedLock<> sl(olock);
-    os << msg;
-    print(a...);
+    CoreLog** l = __atomic_load_n(&logs, __ATOMIC_ACQUIRE);
+    if fastpath(l) {
+      LocalProcessor::lock();
+      CoreLog* cl = l[LocalProcessor::getIndex()];
+      put(cl->os, msg, a...);
+      cl->ring.publish();
+      LocalProcessor::unlock();
+    } else {
+      ScopedLock<> sl(olock);
+      put(os, msg, a...);
+    }
   }
 
   ssize_t write(const void *buf, size_t len) {
-    ScopedLock<> sl(olock);
-    os.write((cbufptr_t)buf, len);
+    CoreLog** l = __atomic_load_n(&logs, __ATOMIC_ACQUIRE);
+    if fastpath(l) {
+      LocalProcessor::lock();
+      CoreLog* cl = l[LocalProcessor::getIndex()];
+      cl->ring.sputn((cbufptr_t)buf, len);
+      cl->ring.publish();
+      LocalProcessor::unlock();
+    } else {
+      ScopedLock<> sl(olock);
+      os.write((cbufptr_t)buf, len);
+    }
     return len;
   }
 };
@@ -76,6 +170,61 @@ extern KernelOutput StdOut;
 extern KernelOutput StdErr;
 extern KernelOutput StdDbg;
 
+// Binary trace: DBG::outl records (TSC, core, level, event, arguments)
+// into per-core rings instead of formatting text.  The event is the
+// address of the first argument (normally the message literal); other
+// arguments are stored as integers, pointers or FmtHex values, anything
+// else as 0.  See scripts/tracedecode.py for decoding a dump.
+class DebugTrace {
+public:
+  static const size_t maxArgs = 5;
+  struct Record {
+    mword tsc;
+    uint16_t core;
+    uint8_t level;
+    uint8_t argc;
+    uint32_t seq;
+    mword event;
+    mword args[maxArgs];
+  };
+  static_assert(sizeof(Record) == 64, "trace record size");
+
+private:
+  static const size_t ringRecords = 4096;
+  struct CoreTrace {
+    Record* ring;
+    mword next;
+  };
+  static CoreTrace* traces;  // nullptr: not started
+  static mword traceCount;
+
+  template<typename T>
+  static mword arg(const T& x, true_type) { return mword(x); }
+  template<typename T>
+  static mword arg(const T& x, false_type) { return 0; }
+  template<typename T>
+  static mword arg(const T& x) {
+    return arg(x, integral_constant<bool, is_integral<T>::value || is_enum<T>::value || is_pointer<T>::value>());
+  }
+  template<size_t N>
+  static mword arg(const char (&x)[N]) { return mword(x); }
+  static mword arg(const FmtHex& x) { return x.val; }
+
+  static void write(mword level, const mword* vals, size_t n);
+
+public:
+  static void start();
+  static void dump();
+  static bool active() { return __atomic_load_n(&traces, __ATOMIC_ACQUIRE) != nullptr; }
+  template<typename... Args>
+  static bool record(mword level, const Args&... a) {
+    if (!active()) return false;
+    const mword vals[] = { arg(a)..., 0 };
+    write(level, vals, sizeof...(Args));
+    return true;
+  }
+};
+
 class DBG {
 public:
   enum Level : size_t {
@@ -112,23 +261,33 @@ private:
 public:
   static void init( char* dstring, bool msg );
   static bool test( Level c ) { return levels.test(c); }
+  // disabled levels compile to nothing, including argument evaluation
+  // that the compiler can prove free of side effects
+  static constexpr bool compiled( Level c ) { return (TESTING_DEBUG_MASK >> c) & 1; }
+  static __finline bool enabled( Level c ) { return !c || (compiled(c) && test(c)); }
 
-  template<typename... Args> static void out1( Level c, const Args&... a ) {
-    if (c && !test(c)) return;
+  template<typename... Args> static __finline void out1( Level c, const Args&... a ) {
+    if (!enabled(c)) return;
     StdDbg.printl(a...);
 #if TESTING_DEBUG_STDOUT
     if (c) StdOut.printl(a...);
 #endif
   }
-  template<typename... Args> static void outl( Level c, const Args&... a ) {
-    if (c && !test(c)) return;
+  template<typename... Args> static __finline void outl( Level c, const Args&... a ) {
+    if (!enabled(c)) return;
+#if TESTING_DEBUG_TRACE
+    if (c && DebugTrace::record(c, a...)) return;
+#endif
     StdDbg.printl('C', LocalProcessor::getIndex(), '/', FmtHex(CPU::readCR3()), ": ", a..., kendl);
 #if TESTING_DEBUG_STDOUT
     if (c) StdOut.printl('C', LocalProcessor::getIndex(), '/', FmtHex(CPU::readCR3()), ": ", a..., kendl);
 #endif
   }
   static void outl( Level c ) {
-    if (c && !test(c)) return;
+    if (!enabled(c)) return;
+#if TESTING_DEBUG_TRACE
+    if (c && DebugTrace::active()) return;
+#endif
     StdDbg.printl(kendl);
 #if TESTING_DEBUG_STDOUT
     if (c) StdOut.printl(kendl);
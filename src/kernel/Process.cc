@@ -16,8 +16,17 @@
 ******************************************************************************/
 #include "runtime/Scheduler.h"
 #include "runtime/Thread.h"
+#include "kernel/Clock.h"
+#include "kernel/ElfImage.h"
 #include "kernel/Process.h"
-#include "extern/elfio/elfio.hpp"
+#include "kernel/Ring.h"
+#include "machine/Machine.h"
+
+#include "vdso.h"
+
+static_assert(VdsoAddress == usertop - pagesize<1>(), "vDSO address");
+
+mword Process::nextID = 0;
 
 void Process::invokeUser(funcvoid2_t func, ptr_t arg1, ptr_t arg2) {
   UserThread* ut = reinterpret_cast<UserThread*>(LocalProcessor::getCurrThread());
@@ -25,6 +34,13 @@ void Process::invokeUser(funcvoid2_t func, ptr_t arg1, ptr_t arg2) {
   ut->stackSize = defaultUserStack;
   ut->stackAddr = CurrAS().allocStack(ut->stackSize);
   DBG::outl(DBG::Threads, "UThread start: ", FmtHex(ut), '/', FmtHex((ptr_t)func));
+  mword start = __atomic_exchange_n(&CurrProcess().execStart, 0, __ATOMIC_RELAXED);
+  if (start) {
+    mword cycles = CPU::readTSC() - start;
+    mword tpu = Clock::getTscPerUsec();
+    if (tpu) DBG::outl(DBG::Perf, "exec latency: ", cycles, " cycles, ", cycles / tpu, " usecs");
+    else DBG::outl(DBG::Perf, "exec latency: ", cycles, " cycles");
+  }
   startUserCode(arg1, arg2, vaddr(ut), func, ut->stackAddr + ut->stackSize);
   unreachable();
 }
@@ -38,61 +54,96 @@ Process::~Process() {
   for (size_t i = 0; i < semStore.currentIndex(); i += 1) {
     if (semStore.valid(i)) kdelete(semStore.get(i));
   }
+  for (size_t i = 0; i < ringStore.currentIndex(); i += 1) {
+    if (ringStore.valid(i)) kdelete(ringStore.get(i));
+  }
 }
 
+// Read-only segments map the boot module's frames directly and are thus
+// shared by all processes running the program.  Data segments map them
+// copy-on-write, except for a partial last page that is followed by bss,
+// which is copied.  The remaining bss is mapped lazily; lazy pages are
+// zero-filled on first access.  Module frames are not reference-counted,
+// so releasing the 'Shared' mappings leaves them in place.
 void Process::exec(const string& fileName) {
   KASSERT0(threadStore.empty());
+  execStart = CPU::readTSC();
   AddressSpace& as = this->enter<true>();
-  auto iter = kernelFS.find(fileName);
-  KASSERT1(iter != kernelFS.end(), fileName.c_str())
-  RamFile& rf = iter->second;
-  ELFIO::elfio elfReader;
-  bool check = elfReader.load(fileName.c_str());
-  KASSERT0(check);
-  KASSERT1(elfReader.get_class() == ELFCLASS64, elfReader.get_class());
+  Dentry* de = kernelFS.lookup(fileName.c_str());
+  KASSERT1(de && de->file, fileName.c_str())
+  RamFile& rf = *de->file;
+  ElfImage* img = ElfImage::get(rf);
+  KASSERT1(img, fileName.c_str());
+  // frames are mapped directly (shared or copy-on-write)
+  KASSERT1(aligned(rf.pma, pagesize<1>()), FmtHex(rf.pma));
 
   vaddr currBreak = 0;
-  for (int i = 0; i < elfReader.segments.size(); ++i) {
-    const ELFIO::segment* pseg = elfReader.segments[i];
-    if (pseg->get_type() != PT_LOAD) continue;  // not a loadable segment
-
-    KASSERTN(pseg->get_file_offset() + pseg->get_file_size() <= rf.size, FmtHex(pseg->get_file_offset()), ' ', FmtHex(pseg->get_file_size()), ' ', FmtHex(rf.size));
-    KASSERTN(pseg->get_memory_size() >= pseg->get_file_size(), FmtHex(pseg->get_file_size()), ' ', FmtHex(pseg->get_memory_size()));
-    paddr pma = rf.pma + pseg->get_file_offset();
+  for (size_t i = 0; i < img->count; i += 1) {
+    const ElfSegment& seg = img->segment[i];
+    paddr pma = rf.pma + seg.offset;
     paddr apma = align_down(pma, pagesize<1>());
-    vaddr vma = pseg->get_virtual_address();
+    vaddr vma = seg.vma;
     vaddr avma = align_down(vma, pagesize<1>());
-    KASSERTN(vma - avma == pma - apma, FmtHex(vma), ' ', FmtHex(pma));
-    vaddr fend = vma + pseg->get_file_size();
+    vaddr fend = vma + seg.fileSize;
     vaddr afend = align_up(fend, pagesize<1>());
-    vaddr mend = vma + pseg->get_memory_size();
+    vaddr mend = vma + seg.memSize;
     vaddr amend = align_up(mend, pagesize<1>());
+    KASSERTN(vma - avma == pma - apma, FmtHex(vma), ' ', FmtHex(pma));
 
-    // If .rodata and .text are in the same elf segment and small enough to
-    // fit into a single page, then .rodata ends up being marked executable.
-    PageType pageType = (pseg->get_flags() & PF_W) ? Data :
-      (pseg->get_flags() & PF_X) ? Code : RoData;
-
-    DBG::outl(DBG::Process,
-      pageType == Data ? "data" : pageType == Code ? "code" : "ro",
-      " segment: ", FmtHex(vma), '-', FmtHex(fend));
-    mapDirect<1>(apma, avma, afend - avma, pageType);
+    if (!seg.writable) {
+      // If .rodata and .text are in the same elf segment and small enough to
+      // fit into a single page, then .rodata ends up being marked executable.
+      PageType pageType = seg.executable ? Code : RoData;
+      DBG::outl(DBG::Process, seg.executable ? "code" : "ro", " segment: ", FmtHex(vma), '-', FmtHex(fend));
+      mapDirect<1>(apma, avma, afend - avma, PageType(pageType | Shared));
+    } else {
+      DBG::outl(DBG::Process, "data segment: ", FmtHex(vma), '-', FmtHex(fend));
+      vaddr cend = (mend > fend) ? align_down(fend, pagesize<1>()) : afend;
+      if (cend > avma) mapDirect<1>(apma, avma, cend - avma, CopyOnWrite);
+      if (afend > cend) {
+        vaddr cstart = max(cend, vma);
+        allocDirect<1>(cend, pagesize<1>(), Data);
+        memset((ptr_t)cend, 0, pagesize<1>());
+        memcpy((ptr_t)cstart, (ptr_t)(rf.vma + seg.offset + (cstart - vma)), fend - cstart);
+      }
+    }
 
-    if (mend > fend) {
-      DBG::outl(DBG::Process, "bss: ", FmtHex(fend), '-', FmtHex(mend));
-      if (amend > afend) allocDirect<1>(afend, amend - afend, Data);
-      memset((void*)fend, 0, mend - fend);
+    if (amend > afend) {
+      DBG::outl(DBG::Process, "bss: ", FmtHex(afend), '-', FmtHex(mend));
+#if TESTING_NEVER_ALLOC_LAZY
+      allocDirect<1>(afend, amend - afend, Data);
+      memset((ptr_t)afend, 0, amend - afend);
+#else
+      lazyDirect<1>(afend, amend - afend, Data);
+#endif
     }
     if (mend > currBreak) currBreak = mend;
   }
 
-  initUser(currBreak);
-  ptr_t entry = (ptr_t)elfReader.get_entry();
+  initUser(currBreak, VdsoAddress);
+  mapVdso();
+  ptr_t entry = (ptr_t)img->entry;
   DBG::outl(DBG::Process, "entry: ", FmtHex(entry));
   createThread((funcvoid2_t)entry, (funcvoid1_t)nullptr, nullptr);
   as.enter<true>();
 }
 
+// fill a fresh frame, then map it read-only; released with the AS
+void Process::mapVdso() {
+  paddr pma = LocalProcessor::getFrameManager()->allocFrame<1>();
+  KASSERT0(pma != topaddr);
+  vaddr va = kernelSpace.kmap<1,false>(0, pagesize<1>(), pma);
+  memset((ptr_t)va, 0, pagesize<1>());
+  VdsoData* vd = (VdsoData*)va;
+  vd->pid = id;
+  vd->processorCount = Machine::getProcessorCount();
+  vd->rdtscp = Processor::userCoreIndex();
+  vd->tscBase = Clock::getTscBase();
+  vd->tscPerUsec = Clock::getTscPerUsec();
+  kernelSpace.unmap<1,false>(va, pagesize<1>());
+  mapDirect<1,false>(pma, VdsoAddress, pagesize<1>(), RoData);
+}
+
 // detach all -> cancel all
 void Process::exit() {
   UserThread* ut = reinterpret_cast<UserThread*>(LocalProcessor::getCurrThread());
@@ -119,6 +170,21 @@ mword Process::createThread(funcvoid2_t wrapper, funcvoid1_t func, ptr_t data) {
   return ut->idx;
 }
 
+// kernel-mode thread in this AS, e.g., syscall ring poller; counted as
+// process thread, so it is cancelled when the process exits
+mword Process::createKernelThread(funcvoid1_t func, ptr_t data) {
+  UserThread* ut = UserThread::create();
+  KASSERT0(ut);
+  ut->stackAddr = 0;
+  ut->stackSize = 0;
+  threadLock.acquire();
+  ut->idx = threadStore.put(ut);
+  DBG::outl(DBG::Threads, "KThread create: ", FmtHex(ut), '/', ut->idx);
+  ut->start((ptr_t)func, data);
+  threadLock.release();
+  return ut->idx;
+}
+
 void Process::exitThread(ptr_t result) {
   UserThread* ut = reinterpret_cast<UserThread*>(LocalProcessor::getCurrThread());
   KASSERT0(ut);
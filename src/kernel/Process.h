@@ -23,13 +23,21 @@
 #include "kernel/MemoryManager.h"
 #include "world/Access.h"
 
+class IpcEndpoint;
+struct IpcTransfer;
+class SyscallRing;
+
 class Process : public AddressSpace {
+  friend class IpcEndpoint;   // IPC state kept in UserThread
 
   struct UserThread : public JoinableThread {
     mword idx;
     vaddr stackAddr;          // bottom of allocated memory for thread/stack
     size_t stackSize;         // size of allocated memory
-    UserThread(vaddr ksb, size_t kss) : JoinableThread(ksb, kss) {}
+    IpcEndpoint* ipcEndpoint; // endpoint of pending IPC reply
+    IpcTransfer* ipcCaller;   // IPC caller waiting for reply
+    UserThread(vaddr ksb, size_t kss) : JoinableThread(ksb, kss),
+      ipcEndpoint(nullptr), ipcCaller(nullptr) {}
     static inline UserThread* create(size_t kss = defaultStack) {
       vaddr mem = kernelSpace.allocStack(kss);
       vaddr This = mem + kss - sizeof(UserThread);
@@ -43,14 +51,21 @@ class Process : public AddressSpace {
 
   vaddr sigHandler;
 
+  static mword nextID;
+  mword id;
+  mword execStart;            // TSC at exec, until first thread starts
+
   static void invokeUser(funcvoid2_t func, ptr_t arg1, ptr_t arg2) __noreturn;
 
 public:
   SynchronizedArray<Access*,KernelAllocator> ioHandles; // used in syscalls.cc
   ManagedArray<Semaphore*,KernelAllocator> semStore;    // used in syscalls.cc
   SpinLock semStoreLock;                                // used in syscalls.cc
+  ManagedArray<SyscallRing*,KernelAllocator> ringStore; // used in Ring.cc
+  SpinLock ringStoreLock;                               // used in Ring.cc
 
-  Process() : threadStore(1), sigHandler(0), ioHandles(4) {
+  Process() : threadStore(1), sigHandler(0),
+    id(__atomic_add_fetch(&nextID, 1, __ATOMIC_RELAXED)), execStart(0), ioHandles(4) {
     ioHandles.store(knew<InputAccess>());
     ioHandles.store(knew<OutputAccess>(StdOut));
     ioHandles.store(knew<OutputAccess>(StdErr));
@@ -59,17 +74,19 @@ public:
   ~Process();
 
   void exec(const string& fileName);
+  void mapVdso();
   void exit() __noreturn;
 
   void  setSignalHandler(vaddr sh) { sigHandler = sh; }
   vaddr getSignalHandler() { return sigHandler; }
 
   mword createThread(funcvoid2_t wrapper, funcvoid1_t func, ptr_t data);
+  mword createKernelThread(funcvoid1_t func, ptr_t data);
   void  exitThread(ptr_t result) __noreturn;
   int   joinThread(mword idx, ptr_t& result);
   bool  destroyThread(Thread& t);
 
-  mword getID() { return 0; }
+  mword getID() { return id; }
   static mword getCurrentThreadID() {
     return reinterpret_cast<UserThread*>(LocalProcessor::getCurrThread())->idx;
   }
@@ -0,0 +1,138 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/Clock.h"
+#include "kernel/MemoryManager.h"
+#include "kernel/Output.h"
+#include "kernel/Profiler.h"
+#include "machine/APIC.h"
+#include "machine/Machine.h"
+#include "machine/Processor.h"
+#include "runtime/Thread.h"
+
+#include <cerrno>
+
+Profiler::CoreBuffer* Profiler::buffers = nullptr;
+mword Profiler::count = 0;
+mword Profiler::interval = 0;
+mword Profiler::generation = 0;
+mword Profiler::apicPerUsec = 0;
+
+static const mword maxFrame = 0x10000;  // sanity bound for frame size
+static const mword minInterval = 100;   // usecs, keeps cores making progress
+
+void Profiler::init() {
+  mword c = Machine::getProcessorCount();
+  CoreBuffer* b = knewN<CoreBuffer>(c);
+  for (mword i = 0; i < c; i += 1) {
+    b[i].ring = knewN<Sample>(ringSamples);
+    b[i].next = b[i].head = b[i].generation = 0;
+  }
+  count = c;
+  __atomic_store_n(&buffers, b, __ATOMIC_RELEASE);
+}
+
+// measure APIC timer rate against calibrated TSC, using a masked one-shot
+void Profiler::calibrate() {
+  mword tscPerUsec = Clock::getTscPerUsec();
+  if (tscPerUsec == 0) return;
+  LocalProcessor::lock();
+  MappedAPIC()->setTimer(APIC::ProfileIRQ, 0xFFFFFFFF, false, true);
+  mword start = CPU::readTSC();
+  while (CPU::readTSC() - start < 1000 * tscPerUsec) CPU::Pause();
+  mword elapsed = 0xFFFFFFFF - MappedAPIC()->getTimerCount();
+  MappedAPIC()->maskTimer();
+  LocalProcessor::unlock();
+  apicPerUsec = elapsed / 1000;
+}
+
+int Profiler::control(mword usecs) {
+  if (!buffers) return -ENODEV;
+  if (usecs && usecs < minInterval) return -EINVAL;
+  if (usecs && !apicPerUsec) calibrate();
+  if (usecs && !apicPerUsec) return -ENODEV;
+  mword iv = usecs * apicPerUsec;
+  if (iv > 0xFFFFFFFF) return -EINVAL;
+  __atomic_store_n(&interval, iv, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+  LocalProcessor::lock();
+  arm();
+  LocalProcessor::unlock();
+  return 0;
+}
+
+// interrupts disabled
+void Profiler::arm() {
+  if (!buffers) return;
+  CoreBuffer& cb = buffers[LocalProcessor::getIndex()];
+  mword g = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+  if fastpath(cb.generation == g) return;
+  cb.generation = g;
+  mword iv = __atomic_load_n(&interval, __ATOMIC_RELAXED);
+  if (iv) MappedAPIC()->setTimer(APIC::ProfileIRQ, iv);
+  else MappedAPIC()->maskTimer();
+}
+
+// interrupt handler: 'fp' is the handler's frame pointer, whose saved
+// %rbp belongs to the interrupted code; user stacks are not walked and
+// the walk stays on the current thread's stack, since kernel code can be
+// interrupted before it has replaced a user %rbp (e.g., syscall entry)
+void Profiler::sample(const mword* isrFrame, const mword* fp, bool user) {
+  CoreBuffer& cb = buffers[LocalProcessor::getIndex()];
+  Sample& s = cb.ring[cb.next % ringSamples];
+  Thread* t = LocalProcessor::getCurrThread();
+  s.thread = mword(t);
+  s.pc[0] = isrFrame[0];
+  s.depth = 1;
+  if (!user && t) {
+    mword rbp = fp[0];
+    while (s.depth < maxDepth) {
+      if (!t->onStack(rbp, 2 * sizeof(mword))) break;
+      if (!aligned(rbp, sizeof(mword))) break;
+      const mword* f = (const mword*)rbp;
+      if (f[1] == 0) break;
+      s.pc[s.depth] = f[1];
+      s.depth += 1;
+      if (f[0] <= rbp || f[0] - rbp > maxFrame) break;
+      rbp = f[0];
+    }
+  }
+  __atomic_store_n(&cb.next, cb.next + 1, __ATOMIC_RELEASE);
+}
+
+// folded stacks: thread;outermost;...;innermost count
+// consumers are serialized by the output lock; 'sample' does not wait for
+// the consumer, so each sample is copied and discarded if the producer
+// may have overwritten it meanwhile
+void Profiler::dump() {
+  if (!buffers) return;
+  StdDbg.lock();
+  for (mword c = 0; c < count; c += 1) {
+    CoreBuffer& cb = buffers[c];
+    mword next = __atomic_load_n(&cb.next, __ATOMIC_ACQUIRE);
+    if (next - cb.head > ringSamples) cb.head = next - ringSamples;
+    for (; cb.head < next; cb.head += 1) {
+      Sample s = cb.ring[cb.head % ringSamples];
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&cb.next, __ATOMIC_RELAXED) - cb.head >= ringSamples) continue;
+      StdDbg.print("PROF thread-", FmtHex(s.thread));
+      if (s.pc[0] < usertop) StdDbg.print(";user;u", FmtHex(s.pc[0]));
+      else for (mword d = s.depth; d > 0; d -= 1) StdDbg.print(';', FmtHex(s.pc[d-1]));
+      StdDbg.print(" 1", kendl);
+    }
+  }
+  StdDbg.unlock();
+}
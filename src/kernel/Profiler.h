@@ -0,0 +1,60 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _Profiler_h_
+#define _Profiler_h_ 1
+
+#include "generic/basics.h"
+
+// Sampling profiler: the local APIC timer of each core fires
+// APIC::ProfileIRQ periodically; the handler records the interrupted
+// RIP, the current thread and a frame-pointer backtrace of kernel code
+// into per-core rings.  Cores pick up start/stop at their next
+// preemption IPI.  'dump' writes samples as folded stacks, one per line
+// prefixed by "PROF ", see scripts/proffold.py.
+class Profiler {
+  static const size_t maxDepth = 14;
+  static const size_t ringSamples = 2048;
+
+  struct Sample {
+    mword thread;
+    mword depth;            // frames in 'pc', innermost first
+    mword pc[maxDepth];
+  };
+  struct CoreBuffer {
+    Sample* ring;
+    mword next;             // producer position
+    mword head;             // next sample to dump
+    mword generation;       // last configuration applied
+  };
+
+  static CoreBuffer* buffers;
+  static mword count;
+  static mword interval;    // APIC timer count, 0: stopped
+  static mword generation;  // incremented by 'control'
+  static mword apicPerUsec;
+
+  static void calibrate();
+
+public:
+  static void init();
+  static int control(mword usecs);        // 0: stop
+  static void arm();                      // apply configuration on this core
+  static void sample(const mword* isrFrame, const mword* fp, bool user);
+  static void dump();
+};
+
+#endif /* _Profiler_h_ */
@@ -0,0 +1,160 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "runtime/Scheduler.h"
+#include "kernel/Process.h"
+#include "kernel/Ring.h"
+
+// implemented in syscalls.cc
+extern "C" int semP(mword sid);
+extern "C" int semV(mword sid);
+
+SyscallRing::SyscallRing(RingHead* h, size_t s, mword entries, bool p)
+: head(h), size(s), sqMask(entries - 1), cqMask(2 * entries - 1),
+  sqHead(0), cqTail(0), users(0), poll(p), stop(false) {
+  memset(head, 0, size);
+  head->sqEntries = entries;
+  head->cqEntries = 2 * entries;
+  head->sqOffset = align_up(sizeof(RingHead), sizeof(mword));
+  head->cqOffset = head->sqOffset + entries * sizeof(RingSqe);
+  sqes = ringSqes(head);
+  cqes = ringCqes(head);
+}
+
+ssize_t SyscallRing::execute(const RingSqe& sqe) {
+  switch (sqe.op) {
+  case RingNop:
+    return 0;
+  case RingRead:
+    return read(sqe.fd, (ptr_t)sqe.addr, sqe.len);
+  case RingWrite:
+    if (sqe.fd == STDOUT_FILENO) {            // copy stdout to stddbg
+      write(STDDBG_FILENO, (ptr_t)sqe.addr, sqe.len);
+    }
+    return write(sqe.fd, (ptr_t)sqe.addr, sqe.len);
+  case RingLseek:
+    return lseek(sqe.fd, sqe.off, sqe.len);
+  case RingSemP:
+    return semP(sqe.fd);
+  case RingSemV:
+    return semV(sqe.fd);
+  default:
+    return -EINVAL;
+  }
+}
+
+bool SyscallRing::pending() {
+  return __atomic_load_n(&head->sqTail, __ATOMIC_SEQ_CST) != sqHead;
+}
+
+// Consume submissions until the queue is empty or the completion queue is
+// full.  Entries are copied before use, since the user may modify them.
+size_t SyscallRing::consume() {
+  ScopedLock<Mutex> sl(consumeLock);
+  size_t count = 0;
+  mword sqTail = __atomic_load_n(&head->sqTail, __ATOMIC_ACQUIRE);
+  if (sqTail - sqHead > sqMask + 1) sqTail = sqHead + sqMask + 1; // bogus tail
+  while (sqHead != sqTail) {
+    mword cqHead = __atomic_load_n(&head->cqHead, __ATOMIC_ACQUIRE);
+    if (cqTail - cqHead > cqMask) break;      // completion queue full
+    RingSqe sqe = sqes[sqHead & sqMask];
+    RingCqe& cqe = cqes[cqTail & cqMask];
+    cqe.data = sqe.data;
+    cqe.result = execute(sqe);
+    sqHead += 1;
+    cqTail += 1;
+    __atomic_store_n(&head->sqHead, sqHead, __ATOMIC_RELEASE);
+    __atomic_store_n(&head->cqTail, cqTail, __ATOMIC_RELEASE);
+    count += 1;
+  }
+  return count;
+}
+
+void SyscallRing::poller(ptr_t This) {
+  SyscallRing* r = reinterpret_cast<SyscallRing*>(This);
+  DBG::outl(DBG::Threads, "ring poller start: ", FmtHex(r));
+  mword idle = 0;
+  while (!r->stop) {
+    if (r->consume()) {
+      idle = 0;
+    } else if (idle < pollSpin) {
+      idle += 1;
+      LocalProcessor::getScheduler()->yield();
+    } else {
+      // announce sleep, then check again -> no lost wakeup with ringEnter
+      __atomic_or_fetch(&r->head->flags, RingNeedWakeup, __ATOMIC_SEQ_CST);
+      if (!r->pending() && !r->stop) r->wakeup.P();
+      __atomic_and_fetch(&r->head->flags, ~RingNeedWakeup, __ATOMIC_SEQ_CST);
+      idle = 0;
+    }
+  }
+  r->done.V();
+}
+
+ssize_t SyscallRing::create(mword& rid, size_t entries, mword flags, RingHead*& ring) {
+  if (entries == 0 || entries > maxEntries) return -EINVAL;
+  if (flags & ~RingPoll) return -EINVAL;
+  entries = pow2<size_t>(ceilinglog2(entries));
+  size_t size = align_up(sizeof(RingHead), sizeof(mword))
+    + entries * sizeof(RingSqe) + 2 * entries * sizeof(RingCqe);
+  Process& p = CurrProcess();
+  vaddr va = p.map<1>(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (va == topaddr) return -ENOMEM;
+  SyscallRing* r = knew<SyscallRing>((RingHead*)va, size, entries, flags & RingPoll);
+  p.ringStoreLock.acquire();
+  rid = p.ringStore.put(r);
+  p.ringStoreLock.release();
+  if (r->poll) p.createKernelThread((funcvoid1_t)poller, r);
+  ring = r->head;
+  return 0;
+}
+
+ssize_t SyscallRing::destroy(mword rid) {
+  Process& p = CurrProcess();
+  p.ringStoreLock.acquire();
+  if (!p.ringStore.valid(rid)) { p.ringStoreLock.release(); return -EINVAL; }
+  SyscallRing* r = p.ringStore.get(rid);
+  if (r->users) { p.ringStoreLock.release(); return -EBUSY; }
+  p.ringStore.remove(rid);
+  p.ringStoreLock.release();
+  if (r->poll) {
+    r->stop = true;
+    r->wakeup.V();
+    r->done.P();
+  }
+  p.unmap<1>(vaddr(r->head), r->size);
+  kdelete(r);
+  return 0;
+}
+
+ssize_t SyscallRing::enter(mword rid) {
+  Process& p = CurrProcess();
+  p.ringStoreLock.acquire();
+  if (!p.ringStore.valid(rid)) { p.ringStoreLock.release(); return -EINVAL; }
+  SyscallRing* r = p.ringStore.get(rid);
+  r->users += 1;
+  p.ringStoreLock.release();
+  ssize_t ret = 0;
+  if (r->poll) {
+    if (__atomic_load_n(&r->head->flags, __ATOMIC_SEQ_CST) & RingNeedWakeup) r->wakeup.V();
+  } else {
+    ret = r->consume();
+  }
+  p.ringStoreLock.acquire();
+  r->users -= 1;
+  p.ringStoreLock.release();
+  return ret;
+}
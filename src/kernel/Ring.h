@@ -0,0 +1,55 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _Ring_h_
+#define _Ring_h_ 1
+
+#include "runtime/BlockingSync.h"
+
+#include "ring.h"
+
+// batched system calls: submissions are consumed either synchronously in
+// ringEnter or by a kernel poller thread running in the process' AS
+class SyscallRing {
+  static const size_t maxEntries = 4096;
+  static const mword pollSpin = 64;   // idle poll rounds before sleeping
+
+  RingHead* head;                     // user memory
+  RingSqe*  sqes;
+  RingCqe*  cqes;
+  size_t    size;                     // size of mapping
+  mword     sqMask, cqMask;
+  mword     sqHead, cqTail;           // kernel copies, published to head
+  mword     users;                    // threads in 'enter' (ringStoreLock)
+  bool      poll;
+  volatile bool stop;
+  Mutex     consumeLock;              // serializes consumers
+  Semaphore wakeup;                   // poller asleep
+  Semaphore done;                     // poller finished
+
+  static void poller(ptr_t This);
+  static ssize_t execute(const RingSqe& sqe);
+  bool pending();
+  size_t consume();
+
+public:
+  SyscallRing(RingHead* h, size_t s, mword entries, bool p);
+  static ssize_t create(mword& rid, size_t entries, mword flags, RingHead*& ring);
+  static ssize_t destroy(mword rid);
+  static ssize_t enter(mword rid);
+};
+
+#endif /* _Ring_h_ */
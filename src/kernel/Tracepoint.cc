@@ -0,0 +1,122 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "runtime/BlockingSync.h"
+#include "kernel/Clock.h"
+#include "kernel/MemoryManager.h"
+#include "kernel/Output.h"
+#include "kernel/Tracepoint.h"
+#include "machine/Machine.h"
+
+mword Tracepoint::mask = 0;
+Tracepoint::CoreBuffer* Tracepoint::buffers = nullptr;
+mword Tracepoint::count = 0;
+
+static Mutex readLock;      // serializes consumers
+
+static const char* names[] = {
+  "switch",
+  "fault",
+  "syscall",
+  "irq",
+  "block",
+  "resume",
+  "frame alloc",
+  "frame release",
+  "net input",
+  "net output",
+};
+
+static_assert(sizeof(names)/sizeof(char*) == TraceMax, "trace names mismatch");
+
+void Tracepoint::init() {
+  mword c = Machine::getProcessorCount();
+  CoreBuffer* b = knewN<CoreBuffer>(c);
+  for (mword i = 0; i < c; i += 1) {
+    b[i].ring = knewN<TraceRecord>(ringRecords);
+    b[i].next = b[i].head = 0;
+  }
+  count = c;
+  __atomic_store_n(&buffers, b, __ATOMIC_RELEASE);
+}
+
+mword Tracepoint::control(mword m) {
+  if (!buffers) return 0;
+  return __atomic_exchange_n(&mask, m & (TRACE_MASK(TraceMax) - 1), __ATOMIC_SEQ_CST);
+}
+
+void Tracepoint::record(mword event, char phase, mword a1, mword a2) {
+  LocalProcessor::lock();
+  CoreBuffer& cb = buffers[LocalProcessor::getIndex()];
+  TraceRecord& r = cb.ring[cb.next % ringRecords];
+  r.tsc = CPU::readTSC();
+  r.core = LocalProcessor::getIndex();
+  r.event = event;
+  r.phase = phase;
+  r.seq = cb.next;
+  r.thread = mword(LocalProcessor::getCurrThread());
+  r.arg1 = a1;
+  r.arg2 = a2;
+  __atomic_store_n(&cb.next, cb.next + 1, __ATOMIC_RELEASE);
+  LocalProcessor::unlock();
+}
+
+// Records overwritten by the producer while being copied are dropped.
+ssize_t Tracepoint::read(TraceRecord* buf, size_t n) {
+  if (!buffers) return 0;
+  ScopedLock<Mutex> sl(readLock);
+  size_t done = 0;
+  for (mword c = 0; c < count && done < n; c += 1) {
+    CoreBuffer& cb = buffers[c];
+    mword next = __atomic_load_n(&cb.next, __ATOMIC_ACQUIRE);
+    if (next - cb.head > ringRecords) cb.head = next - ringRecords;
+    for (; cb.head < next && done < n; cb.head += 1) {
+      buf[done] = cb.ring[cb.head % ringRecords];
+      if (__atomic_load_n(&cb.next, __ATOMIC_ACQUIRE) - cb.head < ringRecords) done += 1;
+    }
+  }
+  return done;
+}
+
+void Tracepoint::dump() {
+  if (!buffers) return;
+  mword tscBase = Clock::getTscBase();
+  mword tscPerUsec = Clock::getTscPerUsec();
+  if (tscPerUsec == 0) tscPerUsec = 1;
+  ScopedLock<Mutex> sl(readLock);
+  StdDbg.lock();
+  StdDbg.print('[', kendl);
+  bool first = true;
+  for (mword c = 0; c < count; c += 1) {
+    CoreBuffer& cb = buffers[c];
+    mword next = __atomic_load_n(&cb.next, __ATOMIC_ACQUIRE);
+    mword s = next > ringRecords ? next - ringRecords : 0;
+    for (; s < next; s += 1) {
+      const TraceRecord& r = cb.ring[s % ringRecords];
+      if (r.event >= TraceMax) continue;
+      mword ns = (r.tsc - tscBase) * 1000 / tscPerUsec;
+      if (!first) StdDbg.print(',', kendl);
+      first = false;
+      StdDbg.print("{\"name\":\"", names[r.event], "\",\"ph\":\"", char(r.phase),
+        "\",\"ts\":", ns / 1000, '.', ns % 1000 / 100, ns % 100 / 10, ns % 10,
+        ",\"pid\":0,\"tid\":", r.phase == 'i' ? r.core : r.thread);
+      if (r.phase == 'i') StdDbg.print(",\"s\":\"t\"");
+      StdDbg.print(",\"args\":{\"arg1\":\"", FmtHex(r.arg1), "\",\"arg2\":\"", FmtHex(r.arg2), "\"}}");
+    }
+  }
+  StdDbg.print(kendl, ']', kendl);
+  StdDbg.unlock();
+}
@@ -0,0 +1,62 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _Tracepoint_h_
+#define _Tracepoint_h_ 1
+
+#include "machine/Processor.h"
+
+#include "trace.h"
+
+// Static tracepoints: a disabled tracepoint costs one load and a
+// predicted branch on the global event mask.  Enabled events go into
+// per-core rings that overwrite the oldest records; trace_read consumes
+// them, trace_dump writes them in Chrome trace format (load the JSON
+// array between '[' and ']' in the debug log into chrome://tracing or
+// Perfetto).  Instant events are shown per core, begin/end pairs per
+// thread, since a thread can block and migrate in between.
+class Tracepoint {
+  struct CoreBuffer {
+    TraceRecord* ring;
+    mword next;             // producer position
+    mword head;             // consumer position
+  };
+
+  static const size_t ringRecords = 8192;
+  static mword mask;
+  static CoreBuffer* buffers;
+  static mword count;
+
+  static void record(mword event, char phase, mword a1, mword a2);
+
+public:
+  static void init();
+  static mword control(mword m);
+  static ssize_t read(TraceRecord* buf, size_t n);
+  static void dump();
+
+  static __finline bool enabled(mword event) {
+    return slowpath(__atomic_load_n(&mask, __ATOMIC_RELAXED) & (mword(1) << event));
+  }
+  static __finline void event(mword event, char phase, mword a1, mword a2) {
+    if (enabled(event)) record(event, phase, a1, a2);
+  }
+  static __finline void instant(mword e, mword a1 = 0, mword a2 = 0) { event(e, 'i', a1, a2); }
+  static __finline void begin(mword e, mword a1 = 0, mword a2 = 0)   { event(e, 'B', a1, a2); }
+  static __finline void end(mword e, mword a1 = 0, mword a2 = 0)     { event(e, 'E', a1, a2); }
+};
+
+#endif /* _Tracepoint_h_ */
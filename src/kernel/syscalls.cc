@@ -17,15 +17,22 @@
 #include "runtime/Scheduler.h"
 #include "runtime/Thread.h"
 #include "kernel/Clock.h"
+#include "kernel/IPC.h"
+#include "kernel/IrqPoll.h"
 #include "kernel/Output.h"
 #include "kernel/Process.h"
+#include "kernel/Profiler.h"
+#include "kernel/Ring.h"
+#include "kernel/Tracepoint.h"
 #include "world/Access.h"
+#include "world/SocketAccess.h"
 #include "machine/Processor.h"
 #include "machine/Machine.h"
 
 
 #include "syscalls.h"
 #include "pthread.h"
+#include "uio.h"
 
 /******* libc functions *******/
 
@@ -73,10 +80,27 @@ extern "C" void _exit(int) {
 }
 
 extern "C" int open(const char *path, int oflag, ...) {
+  // TODO: validate path
   Process& p = CurrProcess();
-  auto it = kernelFS.find(path);
-  if (it == kernelFS.end()) return -ENOENT;
-  return p.ioHandles.store(knew<FileAccess>(it->second));
+  Dentry* de = kernelFS.lookup(path);
+  if (de && de->isDir()) return p.ioHandles.store(knew<DirAccess>(*de));
+#ifdef O_DIRECTORY
+  if (oflag & O_DIRECTORY) return de ? -ENOTDIR : -ENOENT;
+#endif
+  if (de && de->file) {                       // boot modules are read-only
+    if ((oflag & O_ACCMODE) != O_RDONLY) return -EROFS;
+    return p.ioHandles.store(knew<FileAccess>(*de));
+  }
+  PageFile* pf;                               // tmpfs: reference taken
+  int ret = kernelFS.open(path, oflag, pf);
+  if (ret < 0) return ret;
+  if ((oflag & O_TRUNC) && (oflag & O_ACCMODE) != O_RDONLY) pf->truncate(0);
+  return p.ioHandles.store(knew<PageFileAccess>(*pf, oflag));
+}
+
+extern "C" int unlink(const char *path) {
+  // TODO: validate path
+  return kernelFS.unlink(path);
 }
 
 extern "C" int close(int fildes) {
@@ -108,6 +132,111 @@ extern "C" ssize_t write(int fildes, const void* buf, size_t nbyte) {
   return ret;
 }
 
+// positional: file offset and its lock are not touched
+extern "C" ssize_t pread(int fildes, void* buf, size_t nbyte, off_t offset) {
+  // TODO: validate buf/nbyte
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  ssize_t ret = access->pread(buf, nbyte, offset);
+  p.ioHandles.done(fildes);
+  return ret;
+}
+
+extern "C" ssize_t pwrite(int fildes, const void* buf, size_t nbyte, off_t offset) {
+  // TODO: validate buf/nbyte
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  ssize_t ret = access->pwrite(buf, nbyte, offset);
+  p.ioHandles.done(fildes);
+  return ret;
+}
+
+// total length must fit ssize_t, see POSIX readv
+static bool iovalid(const struct iovec* iov, int iovcnt) {
+  // TODO: validate iov and buffers
+  if (iovcnt < 0 || iovcnt > IOV_MAX) return false;
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i += 1) {
+    if (iov[i].iov_len > limit<mword>() / 2 - total) return false;
+    total += iov[i].iov_len;
+  }
+  return true;
+}
+
+extern "C" ssize_t readv(int fildes, const struct iovec* iov, int iovcnt) {
+  if (!iovalid(iov, iovcnt)) return -EINVAL;
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  ssize_t ret = access->readv(iov, iovcnt);
+  p.ioHandles.done(fildes);
+  return ret;
+}
+
+extern "C" ssize_t writev(int fildes, const struct iovec* iov, int iovcnt) {
+  if (!iovalid(iov, iovcnt)) return -EINVAL;
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  ssize_t ret = access->writev(iov, iovcnt);
+  p.ioHandles.done(fildes);
+  return ret;
+}
+
+extern "C" ssize_t preadv(int fildes, const struct iovec* iov, int iovcnt, off_t offset) {
+  if (!iovalid(iov, iovcnt)) return -EINVAL;
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  ssize_t ret = access->preadv(iov, iovcnt, offset);
+  p.ioHandles.done(fildes);
+  return ret;
+}
+
+extern "C" ssize_t pwritev(int fildes, const struct iovec* iov, int iovcnt, off_t offset) {
+  if (!iovalid(iov, iovcnt)) return -EINVAL;
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  ssize_t ret = access->pwritev(iov, iovcnt, offset);
+  p.ioHandles.done(fildes);
+  return ret;
+}
+
+extern "C" mword trace_ctl(mword mask) {
+  return Tracepoint::control(mask);
+}
+
+extern "C" ssize_t trace_read(TraceRecord* buf, size_t count) {
+  // TODO: validate buf/count
+  return Tracepoint::read(buf, count);
+}
+
+extern "C" int trace_dump() {
+  Tracepoint::dump();
+  return 0;
+}
+
+extern "C" int profile_ctl(mword usecs) {
+  return Profiler::control(usecs);
+}
+
+extern "C" int profile_dump() {
+  Profiler::dump();
+  return 0;
+}
+
+extern "C" int lockstat(mword reset) {
+#if TESTING_LOCK_STATS
+  LockStat::report(reset);
+  return 0;
+#else
+  return -ENOSYS;
+#endif
+}
+
 extern "C" off_t lseek(int fildes, off_t offset, int whence) {
   Process& p = CurrProcess();
   Access* access = p.ioHandles.access(fildes);
@@ -117,6 +246,46 @@ extern "C" off_t lseek(int fildes, off_t offset, int whence) {
   return ret;
 }
 
+extern "C" int ftruncate(int fildes, off_t length) {
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  int ret = access->ftruncate(length);
+  p.ioHandles.done(fildes);
+  return ret;
+}
+
+extern "C" int shm_open(const char *name, int oflag, mode_t mode) {
+  // TODO: validate name
+  Process& p = CurrProcess();
+  shmLock.acquire();
+  auto it = shmFS.find(name);
+  if (it == shmFS.end()) {
+    if (!(oflag & O_CREAT)) { shmLock.release(); return -ENOENT; }
+    it = shmFS.insert( {name, knew<PageFile>()} ).first;
+  } else if ((oflag & O_CREAT) && (oflag & O_EXCL)) {
+    shmLock.release();
+    return -EEXIST;
+  }
+  PageFile* pf = it->second;
+  pf->attach();
+  shmLock.release();
+  if (oflag & O_TRUNC) pf->truncate(0);
+  return p.ioHandles.store(knew<PageFileAccess>(*pf, oflag));
+}
+
+extern "C" int shm_unlink(const char *name) {
+  // TODO: validate name
+  shmLock.acquire();
+  auto it = shmFS.find(name);
+  if (it == shmFS.end()) { shmLock.release(); return -ENOENT; }
+  PageFile* pf = it->second;
+  shmFS.erase(it);
+  shmLock.release();
+  if (pf->detach()) kdelete(pf);
+  return 0;
+}
+
 /* I have added a system call here - Priyaa */
 extern "C" long get_core_count(){
 	return Machine::getProcessorCount();
@@ -139,10 +308,23 @@ extern "C" int _mmap(void** addr, size_t len, int protflags, int fildes, off_t o
   // TODO: validate addr
   int prot = protflags & 0xf;
   int flags = protflags >> 4;
-  vaddr va = CurrProcess().map<1>(vaddr(*addr), len, prot, flags, fildes, off);
-  if (va == topaddr) return -ENOMEM;
-  *addr = (void*)va;
-  return 0;
+  Process& p = CurrProcess();
+  if (fildes == -1) {                       // private anonymous memory
+    vaddr va = p.map<1>(vaddr(*addr), len, prot, flags, fildes, off);
+    if (va == topaddr) return -ENOMEM;
+    *addr = (void*)va;
+    return 0;
+  }
+  if (!(flags & MAP_SHARED)) return -ENOTSUP;
+  if (off < 0 || !aligned(mword(off), pagesize<1>()) || len == 0) return -EINVAL;
+  len = align_up(len, pagesize<1>());       // map partial trailing page
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  vaddr va = align_down(vaddr(*addr), pagesize<1>());
+  int ret = access->mmap(p, va, len, prot & PROT_WRITE, off);
+  p.ioHandles.done(fildes);
+  if (ret == 0) *addr = (void*)va;
+  return ret;
 }
 
 extern "C" int _munmap(void* addr, size_t len) {
@@ -208,6 +390,38 @@ extern "C" int semV(mword sid) {
   return 0;
 }
 
+extern "C" int ipcCreate(mword* reid) {
+  // TODO: validate reid
+  return IpcEndpoint::create(*reid);
+}
+
+extern "C" int ipcDestroy(mword eid) {
+  return IpcEndpoint::destroy(eid);
+}
+
+extern "C" int ipc_call(mword eid, IpcMessage* msg) {
+  // TODO: validate msg
+  return IpcEndpoint::call(eid, *msg);
+}
+
+extern "C" int ipc_reply_wait(mword eid, IpcMessage* reply, IpcMessage* msg) {
+  // TODO: validate reply/msg
+  return IpcEndpoint::replyWait(eid, reply, msg);
+}
+
+extern "C" int ringCreate(mword* rid, size_t entries, mword flags, RingHead** ring) {
+  // TODO: validate rid, ring
+  return SyscallRing::create(*rid, entries, flags, *ring);
+}
+
+extern "C" int ringDestroy(mword rid) {
+  return SyscallRing::destroy(rid);
+}
+
+extern "C" int ringEnter(mword rid) {
+  return SyscallRing::enter(rid);
+}
+
 typedef int (*funcint4_t)(mword, mword, mword, mword);
 extern "C" int privilege(ptr_t func, mword a1, mword a2, mword a3, mword a4) {
   return ((funcint4_t)func)(a1, a2, a3, a4);
@@ -218,10 +432,125 @@ extern "C" void _init_sig_handler(vaddr sighandler) {
   CurrProcess().setSignalHandler(sighandler);
 }
 
+/******* sockets *******/
+
+// run 'op' on socket behind descriptor
+template<typename Op>
+static ssize_t withSocket(int sockfd, Op op) {
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(sockfd);
+  if (!access) return -EBADF;
+  SocketAccess* sa = access->socket();
+  ssize_t ret = sa ? op(*sa) : -ENOTSOCK;
+  p.ioHandles.done(sockfd);
+  return ret;
+}
+
+// store new socket; if no descriptor is left, deleting it closes the
+// lwIP socket
+static int storeSocket(SocketAccess* sa) {
+  Process& p = CurrProcess();
+  size_t fd = p.ioHandles.store(sa);
+  if (fd > size_t(limit<int>())) {
+    p.ioHandles.remove(fd);
+    delete sa;
+    p.ioHandles.release(fd);
+    return -EMFILE;
+  }
+  return fd;
+}
+
+extern "C" int socket(int domain, int type, int protocol) {
+  SocketAccess* sa;
+  int ret = SocketAccess::create(domain, type, protocol, sa);
+  if (ret < 0) return ret;
+  return storeSocket(sa);
+}
+
+extern "C" int bind(int sockfd, const struct sockaddr* addr, socklen_t addrlen) {
+  // TODO: validate addr/addrlen
+  return withSocket(sockfd, [&](SocketAccess& sa) { return sa.bind(addr, addrlen); });
+}
+
+extern "C" int listen(int sockfd, int backlog) {
+  return withSocket(sockfd, [&](SocketAccess& sa) { return sa.listen(backlog); });
+}
+
+extern "C" int accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen) {
+  // TODO: validate addr/addrlen
+  SocketAccess* nsa;
+  int ret = withSocket(sockfd, [&](SocketAccess& sa) { return sa.accept(addr, addrlen, nsa); });
+  if (ret < 0) return ret;
+  return storeSocket(nsa);
+}
+
+extern "C" int connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen) {
+  // TODO: validate addr/addrlen
+  return withSocket(sockfd, [&](SocketAccess& sa) { return sa.connect(addr, addrlen); });
+}
+
+extern "C" ssize_t send(int sockfd, const void* buf, size_t len, int flags) {
+  // TODO: validate buf/len
+  return withSocket(sockfd, [&](SocketAccess& sa) { return sa.send(buf, len, flags); });
+}
+
+extern "C" ssize_t recv(int sockfd, void* buf, size_t len, int flags) {
+  // TODO: validate buf/len
+  return withSocket(sockfd, [&](SocketAccess& sa) { return sa.recv(buf, len, flags); });
+}
+
+// flags passed in upper half of first argument: only 5 syscall arguments
+extern "C" ssize_t _sendto(mword fdflags, const void* buf, size_t len, const struct sockaddr* addr, socklen_t addrlen) {
+  // TODO: validate buf/len, addr/addrlen
+  int flags = fdflags >> 32;
+  return withSocket(int(fdflags), [&](SocketAccess& sa) { return sa.sendto(buf, len, flags, addr, addrlen); });
+}
+
+extern "C" ssize_t _recvfrom(mword fdflags, void* buf, size_t len, struct sockaddr* addr, socklen_t* addrlen) {
+  // TODO: validate buf/len, addr/addrlen
+  int flags = fdflags >> 32;
+  return withSocket(int(fdflags), [&](SocketAccess& sa) { return sa.recvfrom(buf, len, flags, addr, addrlen); });
+}
+
+extern "C" int setsockopt(int sockfd, int level, int optname, const void* optval, socklen_t optlen) {
+  // TODO: validate optval/optlen
+  return withSocket(sockfd, [&](SocketAccess& sa) { return sa.setsockopt(level, optname, optval, optlen); });
+}
+
+extern "C" int pollstat(mword reset) {
+  IrqPoll::report(reset);
+  Machine::reportIrqs(reset);
+  return 0;
+}
+
 /******* dummy functions *******/
 
 extern "C" int fstat(int fildes, struct stat *buf) {
-  KABORT1("fstat"); return -ENOSYS;
+  // TODO: validate buf
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  int ret = access->fstat(*buf);
+  p.ioHandles.done(fildes);
+  return ret;
+}
+
+extern "C" int stat(const char *path, struct stat *buf) {
+  // TODO: validate path, buf
+  struct stat st;
+  if (!kernelFS.stat(path, st)) return -ENOENT;
+  *buf = st;
+  return 0;
+}
+
+extern "C" int _readdir(int fildes, struct dirent* ent) {
+  // TODO: validate ent
+  Process& p = CurrProcess();
+  Access* access = p.ioHandles.access(fildes);
+  if (!access) return -EBADF;
+  int ret = access->readdir(*ent);
+  p.ioHandles.done(fildes);
+  return ret;
 }
 
 //extern "C" char *getenv(const char *name) {
@@ -267,15 +596,54 @@ static const syscall_t syscalls[] = {
   syscall_t(semP),
   syscall_t(semV),
   syscall_t(privilege),
-  syscall_t(_init_sig_handler)
+  syscall_t(_init_sig_handler),
+  syscall_t(ipcCreate),
+  syscall_t(ipcDestroy),
+  syscall_t(ipc_call),
+  syscall_t(ipc_reply_wait),
+  syscall_t(ftruncate),
+  syscall_t(shm_open),
+  syscall_t(shm_unlink),
+  syscall_t(ringCreate),
+  syscall_t(ringDestroy),
+  syscall_t(ringEnter),
+  syscall_t(fstat),
+  syscall_t(stat),
+  syscall_t(_readdir),
+  syscall_t(unlink),
+  syscall_t(pread),
+  syscall_t(pwrite),
+  syscall_t(readv),
+  syscall_t(writev),
+  syscall_t(preadv),
+  syscall_t(pwritev),
+  syscall_t(trace_ctl),
+  syscall_t(trace_read),
+  syscall_t(trace_dump),
+  syscall_t(profile_ctl),
+  syscall_t(profile_dump),
+  syscall_t(lockstat),
+  syscall_t(socket),
+  syscall_t(bind),
+  syscall_t(listen),
+  syscall_t(accept),
+  syscall_t(connect),
+  syscall_t(send),
+  syscall_t(recv),
+  syscall_t(_sendto),
+  syscall_t(_recvfrom),
+  syscall_t(setsockopt),
+  syscall_t(pollstat)
 };
 
 static_assert(sizeof(syscalls)/sizeof(syscall_t) == SyscallNum::max, "syscall list error");
 
 extern "C" ssize_t syscall_handler(mword x, mword a1, mword a2, mword a3, mword a4, mword a5) {
   ssize_t retcode = -ENOSYS;
+  Tracepoint::begin(TraceSyscall, x);
   if (x < SyscallNum::max) retcode = syscalls[x](a1, a2, a3, a4, a5);
   else DBG::outl(DBG::Tests, "syscall: ", x);
+  Tracepoint::end(TraceSyscall, retcode);
   // TODO: check for signals
   return retcode;
 }
@@ -58,3 +58,13 @@ void IOAPIC::mapIRQ(uint8_t irq, uint8_t intr, bool low, bool level) {
   write( IOREDTBL + irq * 2, val & 0xFFFFFFFF );
   write( IOREDTBL + irq * 2 + 1, val >> 32 );
 }
+
+void IOAPIC::mapIRQTo(uint8_t irq, uint8_t intr, uint8_t apicID, bool low, bool level) {
+  uint64_t val = Vector.put(intr)
+               | DeliveryMode.put(APIC::Fixed)
+               | Polarity.put(low)
+               | TriggerModeLevel.put(level)
+               | DestinationSet.put(apicID);
+  write( IOREDTBL + irq * 2, val & 0xFFFFFFFF );
+  write( IOREDTBL + irq * 2 + 1, val >> 32 );
+}
@@ -124,6 +124,7 @@ class APIC : public NoObject {
     const BitString<uint32_t,24,8> DestField;
 
   __aligned(0x10) volatile uint32_t LVT_Timer;         // 0x320
+    const BitString<uint32_t, 0,8> TimerVector;
     const BitString<uint32_t,16,1> MaskTimer;
     const BitString<uint32_t,17,2> TimerMode;
 
@@ -200,6 +201,16 @@ public:
   void maskTimer() {
     LVT_Timer |= MaskTimer();
   }
+  // count in units of 16 bus clocks
+  void setTimer(uint8_t vec, uint32_t count, bool periodic = true, bool masked = false) {
+    DivideConfiguration = 0b0011;                       // divide by 16
+    LVT_Timer = TimerVector.put(vec) | TimerMode.put(periodic ? Periodic : OneShot)
+      | (masked ? MaskTimer() : 0);
+    InitialCount = count;
+  }
+  uint32_t getTimerCount() {
+    return CurrentCount;
+  }
   void sendInitIPI(uint8_t dest, bool broadcast = false) {
     ipi(DestField.put(dest), DeliveryMode.put(Init), broadcast);
   }
@@ -213,9 +224,19 @@ public:
     ipi(DestField.put(dest), DeliveryMode.put(Fixed) | Vector.put(vec), broadcast);
   }
   static const uint8_t WakeIPI    = 0xe0; // remote wakeup
+  static const uint8_t ProfileIRQ = 0xec; // sampling profiler: local timer
   static const uint8_t PreemptIPI = 0xed; // preemption
   static const uint8_t TestIPI    = 0xee; // test IPI: bootstrap & experiment
   static const uint8_t StopIPI    = 0xef; // stop, used for GDB or reboot
+
+  // message-signalled interrupts: Intel Vol. 3, Section 10.11 "Message
+  // Signalled Interrupts" - fixed delivery, edge-triggered, physical mode
+  static uint32_t msiAddress(uint8_t apicID) {
+    return 0xFEE00000 | (uint32_t(apicID) << 12);
+  }
+  static uint32_t msiData(uint8_t vec) {
+    return uint32_t(vec) | (uint32_t(Fixed) << 8);  // edge, assert
+  }
 } __packed;
 
 
@@ -263,6 +284,8 @@ class IOAPIC : public NoObject {
   void maskIRQ(uint8_t irq);
   // TODO: all IRQs are send to APIC logical group 0x01 for now...
   void mapIRQ(uint8_t irq, uint8_t intr, bool low = false, bool level = false);
+  // fixed delivery to a single processor, physical destination mode
+  void mapIRQTo(uint8_t irq, uint8_t intr, uint8_t apicID, bool low = false, bool level = false);
 } __packed;
 
 static   APIC*   MappedAPIC() { return   (APIC*)apicAddr; }
@@ -42,7 +42,8 @@ namespace MSR {
 
     FS_BASE        = 0xC0000100,
     GS_BASE        = 0xC0000101,
-    KERNEL_GS_BASE = 0xC0000102
+    KERNEL_GS_BASE = 0xC0000102,
+    TSC_AUX        = 0xC0000103
   };
 
   static inline void read( Register msr, uint32_t& lo, uint32_t& hi ) {
@@ -98,6 +99,10 @@ namespace CPU {
     asm volatile("outb %0, %1" :: "a"(val), "Nd"(port));
   }
 
+  static inline void outs8( uint16_t port, const char* buf, size_t n ) {
+    asm volatile("rep outsb" : "+S"(buf), "+c"(n) : "d"(port) : "memory");
+  }
+
   static inline uint8_t in8( uint16_t port ) {
     uint8_t ret;
     asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
@@ -302,6 +307,7 @@ class CPUID : public NoObject {
   static inline bool NX()        { return cpuid(0x80000001).d & bitmask<uint32_t>(20,1); }
   static inline bool SYSCALL()   { return cpuid(0x80000001).d & bitmask<uint32_t>(11,1); }
   static inline bool Page1G()    { return cpuid(0x80000001).d & bitmask<uint32_t>(26,1); }
+  static inline bool RDTSCP()    { return cpuid(0x80000001).d & bitmask<uint32_t>(27,1); }
   void getCacheInfo()                                 __section(".boot.text");
 };
 
@@ -0,0 +1,97 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/Output.h"
+#include "machine/LockStat.h"
+
+#if TESTING_LOCK_STATS
+
+volatile bool LockStat::registryLock = false;
+bool LockStat::registryOpen = false;
+LockStat* LockStat::registry = nullptr;
+
+void LockStat::lockRegistry() {
+  LocalProcessor::lock();
+  while (__atomic_test_and_set(&registryLock, __ATOMIC_ACQUIRE)) CPU::Pause();
+}
+
+void LockStat::unlockRegistry() {
+  __atomic_clear(&registryLock, __ATOMIC_RELEASE);
+  LocalProcessor::unlock();
+}
+
+void LockStat::enroll() {
+  lockRegistry();
+  if (!enrolled) {
+    prev = nullptr;
+    next = registry;
+    if (registry) registry->prev = this;
+    registry = this;
+    enrolled = true;
+  }
+  unlockRegistry();
+}
+
+LockStat::~LockStat() {
+  if (!enrolled) return;
+  lockRegistry();
+  if (prev) prev->next = next;
+  else registry = next;
+  if (next) next->prev = prev;
+  unlockRegistry();
+}
+
+struct LockReport {
+  vaddr lock;
+  const char* kind;
+  mword acquisitions, contended, waitTotal, waitMax;
+  LockSite maxSite;
+};
+
+static const size_t reportTop = 32;
+
+// snapshot buffer kept off the stack, serialized by the debug output lock
+static LockReport top[reportTop];
+
+// snapshot under registry lock, print after releasing it (printing takes locks)
+void LockStat::report(bool reset) {
+  size_t n = 0;
+  mword total = 0;
+  StdDbg.lock();
+  lockRegistry();
+  for (LockStat* ls = registry; ls; ls = ls->next) {
+    total += 1;
+    if (ls->contended == 0) continue;
+    size_t i = (n < reportTop) ? n++ : reportTop;
+    for (; i > 0 && top[i-1].waitTotal < ls->waitTotal; i -= 1) {
+      if (i < reportTop) top[i] = top[i-1];
+    }
+    if (i < reportTop) {
+      top[i] = { vaddr(ls), ls->kind, ls->acquisitions, ls->contended, ls->waitTotal, ls->waitMax, ls->maxSite };
+    }
+    if (reset) ls->acquisitions = ls->contended = ls->waitTotal = ls->waitMax = 0;
+  }
+  unlockRegistry();
+  StdDbg.print("lock_stat: ", total, " locks, top ", n, " by wait cycles", kendl);
+  StdDbg.print("lock                 kind        acquisitions   contended      wait-total   wait-max  max-site", kendl);
+  for (size_t i = 0; i < n; i += 1) {
+    StdDbg.print(FmtHex(top[i].lock), ' ', top[i].kind, ' ', top[i].acquisitions, ' ', top[i].contended,
+      ' ', top[i].waitTotal, ' ', top[i].waitMax, ' ', top[i].maxSite.file, ':', top[i].maxSite.line, kendl);
+  }
+  StdDbg.unlock();
+}
+
+#endif /* TESTING_LOCK_STATS */
@@ -0,0 +1,100 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _LockStat_h_
+#define _LockStat_h_ 1
+
+#include "machine/CPU.h"
+#include "machine/Processor.h"
+
+#if TESTING_LOCK_STATS
+
+// Call site of an acquisition, filled in by default arguments at the
+// call, i.e., at the caller of 'acquire' or of a ScopedLock constructor.
+struct LockSite {
+  const char* file;
+  int line;
+  LockSite(const char* f = __builtin_FILE(), int l = __builtin_LINE()) : file(f), line(l) {}
+};
+
+#define LOCK_SITE          LockSite site = LockSite()
+#define LOCK_SITE_NEXT     , LockSite site = LockSite()
+#define LOCK_SITE_ARG      site
+#define LOCK_SITE_ARG_NEXT , site
+
+// Per-instance lock statistics, see TESTING_LOCK_STATS: acquisitions,
+// contended acquisitions, total and maximum wait cycles, and the call
+// site of the longest wait.  Instances enter a global registry at their
+// first acquisition and leave it on destruction.  Enrollment is only
+// enabled after the last pass of global constructors, which would
+// otherwise reset the links of already enrolled instances.
+class LockStat {
+  LockStat* prev;
+  LockStat* next;
+  const char* kind;
+  volatile bool enrolled;
+  mword acquisitions;
+  mword contended;
+  mword waitTotal;
+  mword waitMax;
+  LockSite maxSite;
+
+  static volatile bool registryLock;  // raw, to avoid recursion
+  static bool registryOpen;
+  static LockStat* registry;
+  static void lockRegistry();
+  static void unlockRegistry();
+  void enroll();
+
+public:
+  LockStat(const char* kind) : prev(nullptr), next(nullptr), kind(kind),
+    enrolled(false), acquisitions(0), contended(0), waitTotal(0), waitMax(0),
+    maxSite(nullptr, 0) {}
+  LockStat(const LockStat& ls) : LockStat(ls.kind) {}
+  LockStat& operator=(const LockStat&) { return *this; }
+  ~LockStat();
+
+  static mword now() { return CPU::readTSC(); }
+  void record(mword wait, bool cont, const LockSite& site) {
+    if slowpath(!enrolled && registryOpen) enroll();
+    __atomic_add_fetch(&acquisitions, 1, __ATOMIC_RELAXED);
+    if (cont) {
+      __atomic_add_fetch(&contended, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&waitTotal, wait, __ATOMIC_RELAXED);
+      if (wait > waitMax) {       // racy for shared holders, good enough
+        waitMax = wait;
+        maxSite = site;
+      }
+    }
+  }
+
+  // enable enrollment: global constructors have run for the last time
+  static void openRegistry() { registryOpen = true; }
+
+  // print most contended locks to debug output, optionally reset
+  static void report(bool reset);
+};
+
+#else
+
+#define LOCK_SITE
+#define LOCK_SITE_NEXT
+#define LOCK_SITE_ARG
+#define LOCK_SITE_ARG_NEXT
+
+#endif /* TESTING_LOCK_STATS */
+
+#endif /* _LockStat_h_ */
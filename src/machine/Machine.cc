@@ -19,9 +19,12 @@
 #include "kernel/AddressSpace.h"
 #include "kernel/Clock.h"
 #include "kernel/FrameManager.h"
+#include "kernel/IrqPoll.h"
 #include "kernel/MemoryManager.h"
 #include "kernel/Multiboot.h"
 #include "kernel/Process.h"
+#include "kernel/Profiler.h"
+#include "kernel/Tracepoint.h"
 #include "machine/asmdecl.h"
 #include "machine/APIC.h"
 #include "machine/Machine.h"
@@ -33,6 +36,7 @@
 #include "devices/RTC.h"
 #include "devices/Screen.h"
 #include "devices/Serial.h"
+#include "devices/VirtioNet.h"
 #include "gdb/Gdb.h"
 #include "syscalls.h"
 
@@ -103,7 +107,8 @@ static void tipiReceiver() {
 }
 
 // IRQ handling
-static const int MaxIrqCount = 192;
+static const int MaxIrqCount = 192;      // vectors 0x20-0xdf
+static const mword IrqGroup = ~mword(0); // IOAPIC default: logical irq group
 struct IrqInfo {
   paddr    ioApicAddr;
   uint8_t  ioApicIrq;
@@ -111,9 +116,26 @@ struct IrqInfo {
   uint16_t overrideFlags;
   typedef pair<funcvoid1_t,ptr_t> Handler;
   list<Handler,KernelAllocator<Handler>> handlers;
+  IrqPoll* poll;           // serviced directly from interrupt, see IrqPoll
+  MsiSource* msi;          // message-signalled, instead of IOAPIC
+  mword    core;           // target processor index or IrqGroup
+  mword    raised;         // TSC at interrupt, while pending
+  mword    count;          // handler invocations
+  mword    latencySum;     // interrupt -> handler start (cycles)
+  mword    latencyMax;
+  mword    runSum;         // handler duration (cycles)
 } irqTable[MaxIrqCount];
-static Bitmap<MaxIrqCount> irqMask;     // IRQ bitmap
-static Semaphore asyncIrqSem;
+static mword msiNext = 0;  // MSI irqs follow IOAPIC irqs, never freed
+
+// per-core deferred irq work (softirq): the interrupt marks the irq
+// pending on the core that took it and wakes that core's irq thread
+struct SoftIrq {
+  Bitmap<MaxIrqCount> pending;
+  bool      woken;
+  Semaphore sem;
+  SoftIrq() : woken(false) {}
+};
+static SoftIrq* softIrqTable = nullptr;
 
 // init routine for APs: on boot stack and using identity paging
 void Machine::initAP(mword idx) {
@@ -234,6 +256,9 @@ void Machine::initBSP(mword magic, vaddr mbiAddr, mword idx) {
     asm volatile( "call *(%0)" : : "b"(x) : "memory", "cc", "rax", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10", "r11" );
   }
   DBG::outl(DBG::Boot);
+#if TESTING_LOCK_STATS
+  LockStat::openRegistry();
+#endif
 
   // initialize frame manager <- need dynamic memory for internal container
   frameManager.init( (bufptr_t)fmStart, endphysmem );
@@ -277,6 +302,7 @@ void Machine::initBSP(mword magic, vaddr mbiAddr, mword idx) {
       } else {
         irqTable[irqnum].globalIrq     = irqnum;
       }
+      msiNext = max(msiNext, irqnum + 1);
     }
     kernelSpace.unmapDirect<1>(ioApicAddr, pagesize<1>());
   }
@@ -287,6 +313,7 @@ void Machine::initBSP(mword magic, vaddr mbiAddr, mword idx) {
   processorCount = apicMap.size();
   processorTable = knewN<Processor>(processorCount);
   schedulerTable = knewN<Scheduler>(processorCount);
+  softIrqTable   = knewN<SoftIrq>(processorCount);
   mword coreIdx = 0;
   for (const pair<uint32_t,uint32_t>& ap : apicMap) {
     DBG::outl( DBG::Scheduler, "Scheduler ", coreIdx, " at ", FmtHex(schedulerTable + coreIdx));
@@ -340,6 +367,10 @@ void Machine::initBSP2() {
   sendIPI(bspIndex, APIC::TestIPI);
   while (!tipiTest) CPU::Pause();
 
+  // calibrate TSC against PIT; exported to user via vDSO page
+  Clock::calibrate(PIT::frequency);
+  DBG::outl(DBG::Boot, "TSC: ", Clock::getTscPerUsec(), " cycles/usec");
+
   // NOTE: could use broadcast and ticket lock sequencing
   // start up APs one by one (on boot stack): APs go into long mode and halt
   StdOut.print("AP init (", FmtHex(BOOTAP16 / 0x1000), "):");
@@ -392,11 +423,16 @@ apDone:
 
   DBG::outl(DBG::Boot, "Starting CDI devices...");
   // find and install CDI drivers for PCI devices - need interrupts for sleep
-  for (const PCIDevice& pd : pciDevList) findCdiDriver(pd);
+  // native drivers take precedence
+  for (const PCIDevice& pd : pciDevList) {
+    if (!VirtioNet::probe(pd)) findCdiDriver(pd);
+  }
 
-  // start irq thread after cdi init -> avoid interference from device irqs
-  DBG::outl(DBG::Boot, "Creating IRQ thread...");
-  Thread::create()->setPriority(topPriority)->setAffinity(processorTable[0].scheduler)->start((ptr_t)asyncIrqLoop);
+  // start irq threads after cdi init -> avoid interference from device irqs
+  DBG::outl(DBG::Boot, "Creating IRQ threads...");
+  for (mword i = 0; i < processorCount; i += 1) {
+    Thread::create()->setPriority(topPriority)->setAffinity(processorTable[i].scheduler)->start((ptr_t)softIrqLoop, (ptr_t)i);
+  }
 }
 
 void Machine::bootCleanup() {
@@ -458,30 +494,61 @@ void Machine::rrPreemptIPI(mword tick) {
 
 /*********************** IRQ / Exception Handling Code ***********************/
 
-void Machine::asyncIrqLoop() {
+// clear 'woken' before scanning: an irq raised during the scan wakes again
+void Machine::softIrqLoop(mword core) {
+  SoftIrq& sq = softIrqTable[core];
   for (;;) {
-    asyncIrqSem.P();
+    sq.sem.P();
+    __atomic_store_n(&sq.woken, false, __ATOMIC_SEQ_CST);
     for (;;) {
-      mword idx = irqMask.findset();
+      mword idx = sq.pending.findset();
       if slowpath(idx >= MaxIrqCount) break;
 #if TESTING_REPORT_INTERRUPTS
       StdErr.out1(" AH:", FmtHex(idx));
 #endif
-      irqMask.clear<true>(idx);
-      for (IrqInfo::Handler f : irqTable[idx].handlers) f.first(f.second);
+      IrqInfo& ii = irqTable[idx];
+      mword start = CPU::readTSC();
+      mword latency = start - ii.raised;
+      sq.pending.clear<true>(idx);
+      for (IrqInfo::Handler f : ii.handlers) f.first(f.second);
+      ii.count += 1;
+      ii.latencySum += latency;
+      if (latency > ii.latencyMax) ii.latencyMax = latency;
+      ii.runSum += CPU::readTSC() - start;
     }
   }
-};
+}
+
+void Machine::reportIrqs(bool reset) {
+  StdDbg.lock();
+  StdDbg.print("irq_stat: irq core      count  lat-avg  lat-max  run-avg (cycles)", kendl);
+  for (mword i = 0; i < MaxIrqCount; i += 1) {
+    IrqInfo& ii = irqTable[i];
+    if (ii.count == 0) continue;
+    StdDbg.print("irq_stat: ", i, ' ', getIrqAffinity(i), ' ', ii.count, ' ', ii.latencySum / ii.count,
+      ' ', ii.latencyMax, ' ', ii.runSum / ii.count, kendl);
+    if (reset) ii.count = ii.latencySum = ii.latencyMax = ii.runSum = 0;
+  }
+  StdDbg.unlock();
+}
 
 void Machine::mapIrq(mword irq, mword vector) {
   static SpinLock ioapicLock;
+  mword core = irqTable[irq].core;
+  if (irqTable[irq].msi) {
+    DBG::outl(DBG::Basic, "MSI mapping: ", FmtHex(irq), " -> ", FmtHex(vector), '/', core);
+    if (vector) irqTable[irq].msi->program(vector, processorTable[core].apicID);
+    else irqTable[irq].msi->mask();
+    return;
+  }
   mword irqmod = irqTable[irq].globalIrq;
   DBG::outl(DBG::Basic, "IRQ mapping: ", FmtHex(irq), '/', FmtHex(irqTable[irqmod].ioApicIrq), " -> ", FmtHex(vector));
   kernelSpace.mapDirect<1>(irqTable[irqmod].ioApicAddr, ioApicAddr, pagesize<1>(), AddressSpace::MMapIO);
   if (vector) {
     ScopedLock<> sl(ioapicLock);
     // TODO: program IOAPIC with polarity/trigger (ACPI flags), if necessary
-    MappedIOAPIC()->mapIRQ( irqTable[irqmod].ioApicIrq, vector, bspApicID );
+    if (core == IrqGroup) MappedIOAPIC()->mapIRQ( irqTable[irqmod].ioApicIrq, vector, bspApicID );
+    else MappedIOAPIC()->mapIRQTo( irqTable[irqmod].ioApicIrq, vector, processorTable[core].apicID );
   } else {
     ScopedLock<> sl(ioapicLock);
     MappedIOAPIC()->maskIRQ( irqTable[irqmod].ioApicIrq );
@@ -499,10 +566,21 @@ void Machine::registerIrqAsync(mword irq, funcvoid1_t handler, ptr_t ctx) {
   mword vector = irq + 0x20;
   DBG::outl(DBG::Basic, "register async IRQ handler: ", FmtHex(ptr_t(handler)), " for irq/vector ", FmtHex(irq), '/', FmtHex(vector));
   ScopedLock<LocalProcessor> sl;
+  KASSERT1(!irqTable[irq].poll, irq);       // dispatch goes to poll chain only
   if (irqTable[irq].handlers.empty()) mapIrq(irq, vector);
   irqTable[irq].handlers.push_back( {handler, ctx} );
 }
 
+void Machine::registerIrqPoll(mword irq, IrqPoll* poll) {
+  mword vector = irq + 0x20;
+  DBG::outl(DBG::Basic, "register poll IRQ handler: ", FmtHex(ptr_t(poll)), " for irq/vector ", FmtHex(irq), '/', FmtHex(vector));
+  ScopedLock<LocalProcessor> sl;
+  KASSERT1(irqTable[irq].handlers.empty(), irq);
+  if (!irqTable[irq].poll) mapIrq(irq, vector);
+  poll->setShared(irqTable[irq].poll);
+  irqTable[irq].poll = poll;
+}
+
 void Machine::deregisterIrqAsync(mword irq, funcvoid1_t handler) {
   DBG::outl(DBG::Basic, "deregister async IRQ handler: ", FmtHex(ptr_t(handler)), " for irq ", FmtHex(irq));
   ScopedLock<LocalProcessor> sl;
@@ -516,6 +594,48 @@ void Machine::deregisterIrqAsync(mword irq, funcvoid1_t handler) {
   if (irqTable[irq].handlers.empty()) mapIrq(irq, 0);
 }
 
+// MSI-X preferred; MSI irqs are masked until a handler is registered
+mword Machine::allocMsi(const PCIDevice& pd, mword count, mword& irq) {
+  static SpinLock msiLock;
+  uint8_t cap = PCI::findCapability(pd, PCI::CapMSIX);
+  mword n = cap ? min(mword(PCI::msixCount(pd)), count) : 0;
+  if (!cap) {
+    cap = PCI::findCapability(pd, PCI::CapMSI);
+    if (cap) n = min(mword(1), count);
+  }
+  if (n == 0) return 0;
+  {
+    ScopedLock<> sl(msiLock);
+    n = min(n, MaxIrqCount - msiNext);
+    irq = msiNext;
+    msiNext += n;
+  }
+  if (n == 0) return 0;
+  vaddr table = (PCI::readConfig<8>(pd, cap) == PCI::CapMSIX) ? PCI::msixEnable(pd) : 0;
+  if (!table) PCI::msiEnable(pd);
+  for (mword i = 0; i < n; i += 1) {
+    irqTable[irq + i].msi = knew<MsiSource>(pd, cap, i, table);
+    irqTable[irq + i].core = i % processorCount;
+  }
+  DBG::outl(DBG::Basic, "MSI irqs: ", FmtHex(irq), '-', FmtHex(irq + n - 1), (table ? " (MSI-X)" : " (MSI)"));
+  return n;
+}
+
+// retarget at runtime: mapped irqs are reprogrammed immediately
+void Machine::setIrqAffinity(mword irq, mword core) {
+  KASSERT1(irq < MaxIrqCount, irq);
+  KASSERT1(core < processorCount, core);
+  ScopedLock<LocalProcessor> sl;
+  irqTable[irq].core = core;
+  if (irqTable[irq].poll || !irqTable[irq].handlers.empty()) mapIrq(irq, irq + 0x20);
+}
+
+mword Machine::getIrqAffinity(mword irq) {
+  KASSERT1(irq < MaxIrqCount, irq);
+  mword core = __atomic_load_n(&irqTable[irq].core, __ATOMIC_RELAXED);
+  return core == IrqGroup ? bspIndex : core;
+}
+
 void Machine::setupIDT(uint32_t number, paddr address, uint32_t ist) {
   KASSERT1(number < maxIDT, number);
   idt[number].Offset00 = (address & 0x000000000000FFFF);
@@ -535,6 +655,8 @@ void Machine::setupIDTable() {
     irqTable[i].ioApicIrq     = 0;
     irqTable[i].globalIrq     = i; 
     irqTable[i].overrideFlags = 0;
+    irqTable[i].msi           = nullptr;
+    irqTable[i].core          = IrqGroup;
   }
 
   memset(idt, 0, sizeof(idt));
@@ -923,7 +1045,11 @@ extern "C" void exception_handler_errcode_0x0d(mword* isrFrame, mword ec) {
 extern "C" void exception_handler_errcode_0x0e(mword* isrFrame, mword ec) {
   IsrEntry<false> ie(isrFrame);
   vaddr da = CPU::readCR2();
-  if (Paging::fault(da, *LocalProcessor::getFrameManager())) return;
+  Tracepoint::begin(TraceFault, da, ec);
+  bool handled = Paging::fault(da, *LocalProcessor::getFrameManager())
+    || (Paging::PageFaultFlags::WR.get(ec) && CurrAS().copyOnWrite(da));
+  Tracepoint::end(TraceFault, da, handled);
+  if (handled) return;
   KERR::outl("PAGE FAULT @ ", FmtHex(*isrFrame), " / data: ", FmtHex(da), " / flags:", Paging::PageFaultFlags(ec));
   Reboot(*isrFrame);
 }
@@ -966,7 +1092,15 @@ extern "C" void exception_handler_undefined(mword* isrFrame, mword vec) {
 
 extern "C" void irq_handler_async(mword* isrFrame, mword idx) {
   IsrEntry<true> ie(isrFrame);
-  irqMask.set<true>(idx);
+  Tracepoint::instant(TraceIrq, idx);
+  if (irqTable[idx].poll) {
+    for (IrqPoll* ip = irqTable[idx].poll; ip; ip = ip->getShared()) ip->interrupt();
+  } else {
+    SoftIrq& sq = softIrqTable[LocalProcessor::getIndex()];
+    if (!sq.pending.test(idx)) irqTable[idx].raised = CPU::readTSC();
+    sq.pending.set<true>(idx);
+    if (!__atomic_exchange_n(&sq.woken, true, __ATOMIC_SEQ_CST)) sq.sem.V();
+  }
 #if TESTING_REPORT_INTERRUPTS
   KERR::out1(" AI:", FmtHex(idx));
 #endif
@@ -977,8 +1111,14 @@ extern "C" void irq_handler_0xe0(mword* isrFrame) { // APIC::WakeIPI
   LocalProcessor::getScheduler()->preempt();
 }
 
+extern "C" void irq_handler_0xec(mword* isrFrame) { // APIC::ProfileIRQ
+  IsrEntry<true> ie(isrFrame);
+  Profiler::sample(isrFrame, (mword*)__builtin_frame_address(0), Processor::userSegment(isrFrame[1]));
+}
+
 extern "C" void irq_handler_0xed(mword* isrFrame) { // APIC::PreemptIPI
   IsrEntry<true> ie(isrFrame);
+  Profiler::arm();
   LocalProcessor::getScheduler()->preempt();
 }
 
@@ -1015,7 +1155,6 @@ extern "C" void irq_handler_0xf8(mword* isrFrame) { // RTC interrupt
 #if TESTING_REPORT_INTERRUPTS
   KERR::out1(" RTC");
 #endif
-  if (!irqMask.empty()) asyncIrqSem.V(); // check interrupts
   Timeout::checkExpiry(Clock::now());    // check timeout queue
   Machine::rrPreemptIPI(rtc.tick());     // simulate APIC timer interrupts
 }
@@ -1051,6 +1190,10 @@ void Reboot(vaddr ia) {
   for (mword i = 0; i < Machine::getProcessorCount(); i++) {
     if (i != LocalProcessor::getIndex()) Machine::sendIPI(i, APIC::StopIPI);
   }
+  KernelOutput::panic();
+#if TESTING_DEBUG_TRACE
+  DebugTrace::dump();
+#endif
   mword rbp;
   asm volatile("mov %%rbp, %0" : "=r"(rbp));
   KOUT::outl();
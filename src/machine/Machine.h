@@ -19,6 +19,8 @@
 
 #include "generic/basics.h"
 
+class IrqPoll;
+class PCIDevice;
 class Scheduler;
 class Thread;
 
@@ -31,7 +33,7 @@ class Machine : public NoObject {
   static void setupIDTable()                           __section(".boot.text");
 
   static void mapIrq(mword irq, mword vector);
-  static void asyncIrqLoop();
+  static void softIrqLoop(mword core);
 
   static void initAP2()                                __section(".boot.text");
   static void initBSP2()                               __section(".boot.text");
@@ -51,6 +53,17 @@ public:
   static void registerIrqSync(mword irq, mword vec);
   static void registerIrqAsync(mword irq, funcvoid1_t handler, ptr_t ctx);
   static void deregisterIrqAsync(mword irq, funcvoid1_t handler);
+  static void registerIrqPoll(mword irq, IrqPoll* poll);
+
+  // message-signalled interrupts: set up to 'count' irqs for 'pd', one per
+  // MSI-X entry (or a single MSI irq), irq i initially targets core i;
+  // returns number of irqs (0: legacy only) and first irq in 'irq'
+  static mword allocMsi(const PCIDevice& pd, mword count, mword& irq);
+  static void setIrqAffinity(mword irq, mword core);
+  static mword getIrqAffinity(mword irq);
+
+  // print per-irq handler latency to debug output, optionally reset
+  static void reportIrqs(bool reset);
 };
 
 void Breakpoint2(vaddr ia = 0) __ninline;
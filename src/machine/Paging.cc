@@ -40,6 +40,8 @@ const BitString<uint64_t, 5, 1> Paging::A;
 const BitString<uint64_t, 6, 1> Paging::D;
 const BitString<uint64_t, 7, 1> Paging::PS;
 const BitString<uint64_t, 8, 1> Paging::G;
+const BitString<uint64_t, 9, 1> Paging::SH;
+const BitString<uint64_t,10, 1> Paging::CW;
 const BitString<uint64_t,12,40> Paging::ADDR;
 const BitString<uint64_t,63, 1> Paging::XD;
 
@@ -53,6 +55,8 @@ ostream& operator<<(ostream& os, const Paging::FmtPE& f) {
   if (f.t & Paging::D())    os << " D";
   if (f.t & Paging::PS())   os << " PS";
   if (f.t & Paging::G())    os << " G";
+  if (f.t & Paging::SH())   os << " SH";
+  if (f.t & Paging::CW())   os << " CW";
   if (f.t & Paging::ADDR()) os << " ADDR:" << FmtHex(f.t & Paging::ADDR());
   if (f.t & Paging::XD())   os << " XD";
   return os;
@@ -60,6 +60,8 @@ private:
   static const BitString<uint64_t, 6, 1> D;
   static const BitString<uint64_t, 7, 1> PS;
   static const BitString<uint64_t, 8, 1> G;
+  static const BitString<uint64_t, 9, 1> SH;   // software: shared frame
+  static const BitString<uint64_t,10, 1> CW;   // software: copy-on-write
   static const BitString<uint64_t,12,40> ADDR;
   static const BitString<uint64_t,63, 1> XD;
 
@@ -73,6 +75,8 @@ protected:
     MMapIO     = XD() | RW() | PWT() | PCD(),
     KernelPT   = RW() | P(),           // NOTE: setting G() upsets VirtualBox
     PageTable  = RW() | P() | US(),
+    Shared     = SH(),                 // modifier: refcounted/foreign frame
+    CopyOnWrite = XD() | CW() | SH(),  // private data backed by foreign frame
   };
 
   enum PageStatus {
@@ -170,6 +174,45 @@ protected:
     }
   }
 
+  static bool shared(const PageEntry* pe) { return SH.get(*pe); }
+  template <unsigned int N>
+  static bool shared(vaddr vma) { return SH.get(*getEntry<N>(vma)); }
+
+  // level-1 entry for vma, if page tables down to level 1 exist
+  template <unsigned int N = pagelevels>
+  static PageEntry* entry1( vaddr vma ) {
+    PageEntry* pe = getEntry<N>(vma);
+    if (!P.get(*pe) || isPage<N>(*pe)) return nullptr;
+    return entry1<N-1>(vma);
+  }
+
+  // page can be replaced by a copy-on-write page: private writable page
+  // (present or lazy), or copy-on-write page itself
+  static bool replaceable(const PageEntry* pe) {
+    if (!pe) return false;
+    if (CW.get(*pe)) return true;
+    if (SH.get(*pe) || !RW.get(*pe)) return false;
+    return P.get(*pe) || (*pe & ADDR()) == lazyPage;
+  }
+
+  // install read-only mapping of foreign frame; returns previous private
+  // frame to release, if any
+  static paddr setCopyOnWrite(PageEntry* pe, paddr pma) {
+    paddr prev = (P.get(*pe) && !SH.get(*pe)) ? (*pe & ADDR()) : topaddr;
+    setPE( *pe, (*pe & ~(ADDR() | RW())) | pma | CW() | SH() | P() );
+    return prev;
+  }
+
+  // write access to copy-on-write page: install private frame 'pma'
+  static paddr breakCopyOnWrite(PageEntry* pe, paddr pma) {
+    paddr prev = *pe & ADDR();
+    setPE( *pe, (*pe & ~(ADDR() | CW() | SH())) | pma | RW() );
+    return prev;
+  }
+
+  static bool copyOnWrite(const PageEntry* pe) { return CW.get(*pe); }
+  static bool writable(const PageEntry* pe) { return RW.get(*pe); }
+
   static paddr unmap2(PageEntry* pe) {
     paddr pma = *pe & ADDR();
     setPE( *pe, 0 );
@@ -212,7 +255,8 @@ protected:
         if (isPage<N>(*pe)) {
           DBG::outl(DBG::Paging, "Paging::clearAllP<", N, ">: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", FmtPE(*pe));
           KASSERT1(N < pagelevels, N);
-          fm.releaseFrame<N>(pma);
+          if (SH.get(*pe)) fm.releaseShared(pma);
+          else fm.releaseFrame<N>(pma);
         } else {
           clearAll<N-1>(vma, vma + pagesize<N>(), fm);
           DBG::outl(DBG::Paging, "Paging::clearAllT<", N-1, ">: ", FmtHex(vma), '/', FmtHex(pagesize<N>()), " -> ", FmtPE(*pe));
@@ -251,6 +295,7 @@ public:
 template<> inline size_t Paging::test<0>(vaddr, uint64_t ) { KABORT0(); return 0; }
 template<> inline void Paging::clearAll<0>(vaddr, vaddr, FrameManager&) { KABORT0(); }
 template<> inline bool Paging::fault<0>(vaddr, FrameManager&) { KABORT0(); return false; }
+template<> inline Paging::PageEntry* Paging::entry1<1>(vaddr vma) { return getEntry<1>(vma); }
 template<> inline paddr Paging::vtop<0>(vaddr) { KABORT0(); return 0; }
 
 // corner cases for which actual template instantiations are needed
@@ -309,6 +354,7 @@ inline bool Paging::fault( vaddr vma, FrameManager& fm ) {
     paddr pma = fm.allocFrame<N>();
     KASSERT0(pma != topaddr);
     setPE( *pe, pma | (*pe & ~ADDR()) | P() );
+    if (RW.get(*pe)) memset((ptr_t)align_down(vma, pagesize<N>()), 0, pagesize<N>());
 //    DBG::outl(DBG::Paging, "Paging::fault<", N, ">: ", FmtHex(align_down(vma, pagesize<N>())), '/', FmtHex(pagesize<N>()), " -> ", FmtPE(*pe));
     return true;
   }
@@ -44,9 +44,11 @@ void Processor::check(bool output) {
   if (CPUID::ARAT())           DBG::out1(dl, " ARAT");
   if (CPUID::FSGSBASE())       DBG::out1(dl, " FSGSBASE");
   if (CPUID::Page1G())         DBG::out1(dl, " Page1G");
+  if (CPUID::RDTSCP())         DBG::out1(dl, " RDTSCP");
   DBG::outl(dl);
   MSR::enableNX();                            // enable NX paging bit
   CPU::writeCR4(CPU::readCR4() | CPU::PGE()); // enable  G paging bit
+  CPU::writeCR0(CPU::readCR0() | CPU::WP());  // kernel honours read-only pages
 //  CPU::writeCR4(CPU::readCR4() | CPU::FSGSBASE()); // enable fs/gs base instructions
 }
 
@@ -65,6 +67,9 @@ void Processor::init(paddr pml4,
   MSR::write(MSR::SYSCALL_CSTAR, 0x0);
   MSR::write(MSR::SYSCALL_SFMASK, CPU::RFlags::IF()); // disable interrupts during syscall
 
+  // core index for user-level 'rdtscp' -> see vDSO
+  if (CPUID::RDTSCP()) MSR::write(MSR::TSC_AUX, index);
+
   DBG::outl(DBG::Basic, "Fault Stack for ", index, " at ", FmtHex(faultStack));
 
   // set up TSS: rsp[0] is set to per-thread kernel stack before sysretq
@@ -97,6 +97,8 @@ public:
     // check for not kernCS, because userCS (always?) has bits 0,1 set
     return cs != (kernCS * sizeof(SegmentDescriptor));
   }
+  // TSC_AUX holds processor index -> user-level 'rdtscp'
+  static bool userCoreIndex() { return CPUID::RDTSCP(); }
 } __packed __caligned;
 
 class LocalProcessor {
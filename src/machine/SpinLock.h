@@ -18,6 +18,7 @@
 #define _SpinLock_h_ 1
 
 #include "machine/CPU.h"
+#include "machine/LockStat.h"
 #include "machine/Processor.h"
 
 class BinaryLock {
@@ -67,6 +68,12 @@ public:
 };
 
 class SpinLock : protected BinaryLock {
+#if TESTING_LOCK_STATS
+  LockStat stat;
+public:
+  SpinLock() : stat("spin") {}
+  void acquire(LockSite site) { acquire(nullptr, site); }
+#endif
 public:
   bool tryAcquire() {
     LocalProcessor::lock();
@@ -74,9 +81,19 @@ public:
     LocalProcessor::unlock();
     return false;
   }
-  void acquire(SpinLock* l = nullptr) {
+  void acquire(SpinLock* l = nullptr LOCK_SITE_NEXT) {
     LocalProcessor::lock();
+#if TESTING_LOCK_STATS
+    if fastpath(BinaryLock::tryAcquire()) {
+      stat.record(0, false, site);
+    } else {
+      mword start = LockStat::now();
+      BinaryLock::acquire();
+      stat.record(LockStat::now() - start, true, site);
+    }
+#else
     BinaryLock::acquire();
+#endif
     if (l) l->release();
   }
   void release() {
@@ -86,9 +103,37 @@ public:
   bool check() const { return BinaryLock::check(); }
 };
 
+// writers serialize and make sequence odd while updating; readers retry
+// if sequence was odd at start or has changed since
+class SeqLock : protected SpinLock {
+  volatile mword sequence;
+public:
+  SeqLock() : sequence(0) {}
+  mword readBegin() const {
+    for (;;) {
+      mword s = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+      if fastpath(!(s & 1)) return s;
+      CPU::Pause();
+    }
+  }
+  bool readRetry(mword s) const {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sequence, __ATOMIC_RELAXED) != s;
+  }
+  void acquire(LOCK_SITE) {
+    SpinLock::acquire(nullptr LOCK_SITE_ARG_NEXT);
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  }
+  void release() {
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+    SpinLock::release();
+  }
+};
+
 class NoLock {
 public:
-  void acquire() {}
+  void acquire(LOCK_SITE) {}
   void release() {}
 };
 
@@ -96,7 +141,7 @@ template <typename Lock = SpinLock>
 class ScopedLock {
   Lock& lk;
 public:
-  ScopedLock(Lock& lk) : lk(lk) { lk.acquire(); }
+  ScopedLock(Lock& lk LOCK_SITE_NEXT) : lk(lk) { lk.acquire(LOCK_SITE_ARG); }
   ~ScopedLock() { lk.release(); }
 };
 
@@ -27,5 +27,27 @@ int InitProcess() {
   p2->exec("threadtest");
   Process* p3 = knew<Process>();
   p3->exec("manythread");
+#if TESTING_BENCHMARKS // these compete for cores and the network stack: trim to those of interest
+  Process* p4 = knew<Process>();
+  p4->exec("ipcserver");
+  Process* p5 = knew<Process>();
+  p5->exec("ipcclient");
+  Process* p6 = knew<Process>();
+  p6->exec("ringbench");
+  Process* p7 = knew<Process>();
+  p7->exec("fsbench");
+  Process* p8 = knew<Process>();
+  p8->exec("readbench");
+  Process* p9 = knew<Process>();
+  p9->exec("echoserver");
+  Process* p10 = knew<Process>();
+  p10->exec("echoload");
+  Process* p11 = knew<Process>();
+  p11->exec("rxbench");
+  Process* p12 = knew<Process>();
+  p12->exec("pktbench");
+  Process* p13 = knew<Process>();
+  p13->exec("apibench");
+#endif
   return 0;
 }
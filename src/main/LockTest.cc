@@ -135,8 +135,83 @@ void SyncQueueTest() {
   tsem.P();
 }
 
+// Priority Inheritance Test: high waits for m0 held by mid, which waits
+// for m1 held by low -> low must inherit high's priority transitively
+static Mutex piMutex0;
+static Mutex piMutex1;
+
+static bool waitForPriority(mword prio) {
+  mword deadline = Clock::now() + 1000;
+  while (Runtime::getCurrThread()->getPriority() != prio) {
+    if (Clock::now() > deadline) return false;
+    Timeout::sleep(Clock::now() + 1);
+  }
+  return true;
+}
+
+static void piLowMain(ptr_t) {
+  piMutex1.acquire();
+  tsem.V();
+  KASSERT1(waitForPriority(topPriority), "transitive priority inheritance failed");
+  piMutex1.release();
+  KASSERT1(Runtime::getCurrThread()->getPriority() == defPriority, "inherited priority not restored");
+  tsem.V();
+}
+
+static void piMidMain(ptr_t) {
+  piMutex0.acquire();
+  tsem.V();
+  piMutex1.acquire();
+  KASSERT1(waitForPriority(topPriority), "priority inheritance failed");
+  piMutex1.release();
+  KASSERT1(Runtime::getCurrThread()->getPriority() == topPriority, "inherited priority lost");
+  piMutex0.release();
+  KASSERT1(Runtime::getCurrThread()->getPriority() == defPriority, "inherited priority not restored");
+  tsem.V();
+}
+
+static void piHighMain(ptr_t) {
+  piMutex0.acquire();
+  piMutex0.release();
+  KASSERT1(Runtime::getCurrThread()->getPriority() == topPriority, "priority changed");
+  tsem.V();
+}
+
+// a timed-out waiter withdraws its boost; setPriority on a boosted owner
+// only changes the base priority
+static void piOwnerMain(ptr_t) {
+  piMutex0.acquire();
+  tsem.V();
+  KASSERT1(waitForPriority(topPriority), "priority inheritance failed");
+  Runtime::getCurrThread()->setPriority(defPriority);
+  KASSERT1(Runtime::getCurrThread()->getPriority() == topPriority, "inherited priority overwritten");
+  KASSERT1(waitForPriority(defPriority), "boost not withdrawn after timeout");
+  piMutex0.release();
+  tsem.V();
+}
+
+static void piTimeoutMain(ptr_t) {
+  KASSERT1(!piMutex0.tryAcquire(Clock::now() + 50), "mutex not held");
+  tsem.V();
+}
+
+void PriorityInheritanceTest() {
+  KOUT::outl("running PriorityInheritanceTest...");
+  Thread::create()->start((ptr_t)piLowMain);
+  tsem.P();
+  Thread::create()->start((ptr_t)piMidMain);
+  tsem.P();
+  Thread::create()->setPriority(topPriority)->start((ptr_t)piHighMain);
+  for (mword i = 0; i < 3; i += 1) tsem.P();
+  Thread::create()->start((ptr_t)piOwnerMain);
+  tsem.P();
+  Thread::create()->setPriority(topPriority)->start((ptr_t)piTimeoutMain);
+  for (mword i = 0; i < 2; i += 1) tsem.P();
+}
+
 int LockTest() {
   MutexTest();
+  PriorityInheritanceTest();
   SemaphoreTest();
   SyncQueueTest();
   KOUT::outl("LockTest done");
@@ -0,0 +1,307 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "runtime/BlockingSync.h"
+#include "runtime/Thread.h"
+#include "kernel/Clock.h"
+#include "kernel/MemoryManager.h"
+#include "kernel/Output.h"
+
+#include "extern/lwip/lwip/src/include/lwip/sockets.h"
+#include "lwip/dhcp.h"
+#include "lwip/netif.h"
+#include "lwip/tcpip.h"
+
+#include <algorithm>
+#include <cstring>
+
+// netperf-style TCP_STREAM, TCP_RR and UDP_RR tests, first over the
+// loopback interface against in-kernel servers, then over the default
+// netif against a host-side stand-in (scripts/netbench_host.py) that is
+// reached at the DHCP gateway, i.e., the host when running QEMU user-net.
+// Enable with MODULES+=NetBench in Makefile.config.
+namespace NetPerf {
+
+static const mword     Duration   = 1000;    // msecs per test
+static const u16_t     StreamPort = 7780;    // discard
+static const u16_t     TcpRRPort  = 7781;    // echo
+static const u16_t     UdpRRPort  = 7782;    // echo
+static const size_t    StreamSize = 16384;   // bytes per write
+static const size_t    RRSize     = 1;       // request and response size
+static const int       UdpTimeout = 100;     // msecs until request is lost
+static const mword     DhcpWait   = 5000;    // msecs
+static const size_t    MaxSamples = 1 << 16;
+
+static char buffer[StreamSize];
+static mword* samples;                       // transaction latency in cycles
+static size_t sampleCount;
+
+static Semaphore serverDone;
+static volatile bool stopServer;
+
+static sockaddr_in makeAddr(uint32_t ip, u16_t port) {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = ip;
+  return addr;
+}
+
+// no receive blocks longer than a test: a stalled peer ends the test
+static void setTimeout(int fd) {
+  int timeout = Duration;
+  lwip_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+static int listenOn(u16_t port) {
+  int fd = lwip_socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) return -1;
+  sockaddr_in addr = makeAddr(htonl(INADDR_LOOPBACK), port);
+  if (lwip_bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || lwip_listen(fd, 1) < 0) {
+    lwip_close(fd);
+    return -1;
+  }
+  setTimeout(fd);                            // server gives up if client fails
+  return fd;
+}
+
+static int connectTo(uint32_t ip, u16_t port) {
+  int fd = lwip_socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) return -1;
+  sockaddr_in addr = makeAddr(ip, port);
+  if (lwip_connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    lwip_close(fd);
+    return -1;
+  }
+  int on = 1;
+  lwip_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  setTimeout(fd);
+  return fd;
+}
+
+static bool readFull(int fd, char* buf, size_t size) {
+  for (size_t done = 0; done < size; ) {
+    int len = lwip_read(fd, buf + done, size - done);
+    if (len <= 0) return false;
+    done += len;
+  }
+  return true;
+}
+
+// loopback servers: 'arg' is the listening (TCP) or bound (UDP) socket
+
+static void streamServer(ptr_t arg) {
+  static char sink[StreamSize];
+  int fd = lwip_accept((mword)arg, nullptr, nullptr);
+  if (fd >= 0) {
+    setTimeout(fd);
+    while (lwip_read(fd, sink, sizeof(sink)) > 0);
+    lwip_close(fd);
+  }
+  serverDone.V();
+}
+
+static void tcpRRServer(ptr_t arg) {
+  char msg[RRSize];
+  int fd = lwip_accept((mword)arg, nullptr, nullptr);
+  if (fd >= 0) {
+    setTimeout(fd);
+    while (readFull(fd, msg, RRSize) && lwip_write(fd, msg, RRSize) == int(RRSize));
+    lwip_close(fd);
+  }
+  serverDone.V();
+}
+
+static void udpRRServer(ptr_t arg) {
+  char msg[RRSize];
+  int fd = (mword)arg;
+  while (!stopServer) {
+    sockaddr_in from;
+    socklen_t fromlen = sizeof(from);
+    int len = lwip_recvfrom(fd, msg, RRSize, 0, (sockaddr*)&from, &fromlen);
+    if (len > 0) lwip_sendto(fd, msg, len, 0, (sockaddr*)&from, fromlen);
+  }
+  serverDone.V();
+}
+
+static mword usecs(mword cycles) {
+  mword tpu = Clock::getTscPerUsec();
+  return tpu ? cycles / tpu : cycles;
+}
+
+static void report(const char* test, const char* path, mword count, mword msecs, mword lost) {
+  if (msecs == 0) msecs = 1;
+  mword n = min(sampleCount, MaxSamples);
+  if (n == 0) {
+    KOUT::outl("netbench: ", test, ' ', path, " no transactions");
+    return;
+  }
+  std::sort(samples, samples + n);
+  KOUT::outl("netbench: ", test, ' ', path, ' ', count, " trans in ", msecs, " ms, ",
+    count * 1000 / msecs, " trans/s, lost ", lost, ", latency",
+    Clock::getTscPerUsec() ? " (us)" : " (cycles)", " p50 ", usecs(samples[n / 2]),
+    " p90 ", usecs(samples[n * 9 / 10]), " p99 ", usecs(samples[n * 99 / 100]),
+    " max ", usecs(samples[n - 1]));
+}
+
+static void record(mword cycles) {
+  if (sampleCount < MaxSamples) samples[sampleCount] = cycles;
+  sampleCount += 1;
+}
+
+static bool tcpStream(const char* path, uint32_t ip) {
+  int fd = connectTo(ip, StreamPort);
+  if (fd < 0) return false;
+  mword bytes = 0;
+  mword start = Clock::now();
+  // non-blocking, so that a stalled connection cannot outlast the test
+  while (Clock::now() < start + Duration) {
+    int len = lwip_send(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (len > 0) bytes += len;
+    else Timeout::sleep(Clock::now() + 1);   // send buffer full (or error)
+  }
+  mword msecs = Clock::now() - start;
+  lwip_close(fd);
+  if (msecs == 0) msecs = 1;
+  KOUT::outl("netbench: TCP_STREAM ", path, ' ', bytes, " bytes in ", msecs, " ms, ",
+    bytes * 8 / msecs / 1000, " Mbit/s");
+  return true;
+}
+
+static bool tcpRR(const char* path, uint32_t ip) {
+  int fd = connectTo(ip, TcpRRPort);
+  if (fd < 0) return false;
+  char msg[RRSize];
+  memset(msg, 'r', RRSize);
+  mword count = 0;
+  sampleCount = 0;
+  mword start = Clock::now();
+  while (Clock::now() < start + Duration) {
+    mword tsc = CPU::readTSC();
+    if (lwip_write(fd, msg, RRSize) != int(RRSize) || !readFull(fd, msg, RRSize)) break;
+    record(CPU::readTSC() - tsc);
+    count += 1;
+  }
+  mword msecs = Clock::now() - start;
+  lwip_close(fd);
+  report("TCP_RR", path, count, msecs, 0);
+  return true;
+}
+
+static bool udpRR(const char* path, uint32_t ip) {
+  int fd = lwip_socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd < 0) return false;
+  sockaddr_in addr = makeAddr(ip, UdpRRPort);
+  int timeout = UdpTimeout;
+  if (lwip_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0
+    || lwip_connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    lwip_close(fd);
+    return false;
+  }
+  char msg[RRSize];
+  memset(msg, 'u', RRSize);
+  mword count = 0, lost = 0;
+  sampleCount = 0;
+  mword start = Clock::now();
+  while (Clock::now() < start + Duration) {
+    mword tsc = CPU::readTSC();
+    if (lwip_send(fd, msg, RRSize, 0) != int(RRSize)) break;
+    if (lwip_recv(fd, msg, RRSize, 0) != int(RRSize)) {
+      lost += 1;
+      if (lost > 10 && count == 0) break;      // nobody there
+      continue;
+    }
+    record(CPU::readTSC() - tsc);
+    count += 1;
+  }
+  mword msecs = Clock::now() - start;
+  lwip_close(fd);
+  if (count == 0) return false;
+  report("UDP_RR", path, count, msecs, lost);
+  return true;
+}
+
+static void loopback() {
+  uint32_t ip = htonl(INADDR_LOOPBACK);
+  int lfd = listenOn(StreamPort);
+  if (lfd >= 0) {
+    Thread::create()->start((ptr_t)streamServer, (ptr_t)mword(lfd));
+    if (!tcpStream("loopback", ip)) KOUT::outl("netbench: TCP_STREAM loopback failed");
+    serverDone.P();
+    lwip_close(lfd);
+  }
+  lfd = listenOn(TcpRRPort);
+  if (lfd >= 0) {
+    Thread::create()->start((ptr_t)tcpRRServer, (ptr_t)mword(lfd));
+    if (!tcpRR("loopback", ip)) KOUT::outl("netbench: TCP_RR loopback failed");
+    serverDone.P();
+    lwip_close(lfd);
+  }
+  int ufd = lwip_socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (ufd >= 0) {
+    sockaddr_in addr = makeAddr(ip, UdpRRPort);
+    int timeout = UdpTimeout;
+    lwip_setsockopt(ufd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (lwip_bind(ufd, (sockaddr*)&addr, sizeof(addr)) == 0) {
+      stopServer = false;
+      Thread::create()->start((ptr_t)udpRRServer, (ptr_t)mword(ufd));
+      if (!udpRR("loopback", ip)) KOUT::outl("netbench: UDP_RR loopback failed");
+      stopServer = true;
+      serverDone.P();
+    }
+    lwip_close(ufd);
+  }
+}
+
+// wait for a DHCP lease on the default netif; returns its gateway
+static uint32_t remoteHost() {
+  mword end = Clock::now() + DhcpWait;
+  for (;;) {
+    uint32_t gw = 0;
+    LOCK_TCPIP_CORE();
+    netif* nif = netif_default;
+    if (nif && nif->dhcp && nif->dhcp->state == DHCP_BOUND) gw = nif->gw.addr;
+    UNLOCK_TCPIP_CORE();
+    if (gw || !nif || Clock::now() >= end) return gw;
+    Timeout::sleep(Clock::now() + 100);
+  }
+}
+
+static void remote() {
+  uint32_t ip = remoteHost();
+  if (!ip) {
+    KOUT::outl("netbench: no DHCP lease, skipping remote tests");
+    return;
+  }
+  if (!tcpStream("remote", ip)) {
+    KOUT::outl("netbench: no stand-in at gateway, skipping remote tests");
+    return;
+  }
+  if (!tcpRR("remote", ip)) KOUT::outl("netbench: TCP_RR remote failed");
+  if (!udpRR("remote", ip)) KOUT::outl("netbench: UDP_RR remote failed");
+}
+
+} // namespace NetPerf
+
+int NetBench() {
+  NetPerf::samples = kmalloc<mword>(NetPerf::MaxSamples);
+  NetPerf::loopback();
+  NetPerf::remote();
+  kfree<mword>(NetPerf::samples, NetPerf::MaxSamples);
+  KOUT::outl("NetBench done");
+  return 0;
+}
@@ -18,3 +18,4 @@
 
 BasicLock Timeout::lock;
 multimap<mword,Thread*> Timeout::queue;
+BasicLock Mutex::piLock;
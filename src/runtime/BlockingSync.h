@@ -65,9 +65,10 @@ public:
 class BlockingInfo : public virtual UnblockInfo {
 protected:
   BasicLock& bLock;
+  ptr_t owner;              // blocking queue, for tracing
   bool timedOut;
 public:
-  BlockingInfo(BasicLock& bl) : bLock(bl),  timedOut(false) {
+  BlockingInfo(BasicLock& bl, ptr_t o) : bLock(bl), owner(o), timedOut(false) {
     GENASSERT0(bl.check());
   }
   bool suspend(EmbeddedList<Thread>& queue) {
@@ -82,6 +83,7 @@ public:
   }
   virtual void cancelBlocking(Thread& t) {
     timedOut = true;
+    Runtime::traceResume(&t, owner);
     AutoLock al(bLock);
     EmbeddedList<Thread>::remove(t);
   }
@@ -89,7 +91,7 @@ public:
 
 class TimeoutBlockingInfo : public TimeoutInfo, public BlockingInfo {
 public:
-  TimeoutBlockingInfo(BasicLock& bl) : BlockingInfo(bl) {}
+  TimeoutBlockingInfo(BasicLock& bl, ptr_t o) : BlockingInfo(bl, o) {}
   bool suspend(EmbeddedList<Thread>& queue, mword timeout) {
     Thread* thr = Runtime::getCurrThread();
     Timeout::lock.acquire();
@@ -142,63 +144,190 @@ public:
 
   // suspend releases bLock; returns 'false' if interrupted
   bool block(BasicLock& bLock, mword timeout = limit<mword>()) {
+    Runtime::traceBlock(Runtime::getCurrThread(), this);
     if (timeout == limit<mword>()) {
-      BlockingInfo bi(bLock);
+      BlockingInfo bi(bLock, this);
       return bi.suspend(queue);
     } else if (timeout > 0) {
-      TimeoutBlockingInfo tbi(bLock);
+      TimeoutBlockingInfo tbi(bLock, this);
       return tbi.suspend(queue, timeout);
     } // else non-blocking
     bLock.release();
     return false;
   }
 
-  bool resume(BasicLock& bLock, Thread*& t) {
-    for (t = queue.front(); t != queue.fence(); t = EmbeddedList<Thread>::next(*t)) {
-      if (t->unblock()) {
-        EmbeddedList<Thread>::remove(*t);
-        bLock.release();
-        t->getUnblockInfo().cancelTimeout();
-        Scheduler::resume(*t);
-        return true;
-      }
+  // remove first thread that can be unblocked; caller must call wakeup()
+  Thread* unblock() {
+    for (Thread* t = queue.front(); t != queue.fence(); t = EmbeddedList<Thread>::next(*t)) {
+      if (t->unblock()) return EmbeddedList<Thread>::remove(*t);
     }
-    return false;
+    return nullptr;
+  }
+
+  void wakeup(Thread& t) {
+    Runtime::traceResume(&t, this);
+    t.getUnblockInfo().cancelTimeout();
+    Scheduler::resume(t);
+  }
+
+  bool resume(BasicLock& bLock, Thread*& t) {
+    t = unblock();
+    if (!t) return false;
+    bLock.release();
+    wakeup(*t);
+    return true;
   }
 
   bool resume(BasicLock& bl) { Thread* dummy; return resume(bl, dummy); }
 };
 
-class Mutex {
+// Mutex implements transitive priority inheritance: a blocking thread
+// boosts the owner and, following 'blockedOn', the owners of any mutex
+// the owner is itself waiting for.  Inheritance state ('blockedOn',
+// 'heldMutexes', 'waiting') is protected by 'piLock', which is only
+// taken when a mutex is contended.
+class Mutex : public EmbeddedList<Mutex>::Link {
+  static BasicLock piLock;
+  mword waiting[maxPriority];   // number of waiters per effective priority
+
+  mword topWaiter() const {
+    for (mword p = 0; p < maxPriority; p += 1) if (waiting[p]) return p;
+    return maxPriority;
+  }
+
+  static mword inheritedPriority(Thread& t) {
+    mword prio = t.basePriority;
+    for (Mutex* m = t.heldMutexes.front(); m != t.heldMutexes.fence(); m = EmbeddedList<Mutex>::next(*m)) {
+      prio = min(prio, m->topWaiter());
+    }
+    return prio;
+  }
+
+  static void boost(Thread* t, mword prio) {
+    while (t && prio < t->priority) {
+      Mutex* m = t->blockedOn;
+      if (m) {
+        m->waiting[t->priority] -= 1;
+        m->waiting[prio] += 1;
+      }
+      Scheduler::reprioritize(*t, prio);
+      t = (m && m->onList()) ? m->owner : nullptr;
+    }
+  }
+
+  // recompute effective priorities along the blockedOn chain, starting
+  // with 't', after a waiter has left or a base priority has changed
+  static void recompute(Thread* t) {
+    while (t) {
+      mword prio = inheritedPriority(*t);
+      if (prio == t->priority) return;
+      Mutex* m = t->blockedOn;
+      if (m) {
+        m->waiting[t->priority] -= 1;
+        m->waiting[prio] += 1;
+      }
+      Scheduler::reprioritize(*t, prio);
+      t = (m && m->onList()) ? m->owner : nullptr;
+    }
+  }
+
+  void inherit(Thread* curr) {                // lock held
+    ScopedLock<> sl(piLock);
+    curr->blockedOn = this;
+    waiting[curr->priority] += 1;
+    if (!onList()) owner->heldMutexes.push_back(*this);
+    boost(owner, curr->priority);
+  }
+
+  void timedOut(Thread* curr) {
+    ScopedLock<> sl(piLock);
+    if (curr->blockedOn == this) {            // baton not passed
+      waiting[curr->priority] -= 1;
+      curr->blockedOn = nullptr;
+      // still listed: release goes through disinherit, so owner is stable
+      if (onList()) recompute(owner);
+    }
+  }
+
+  void disinherit(Thread* next) {             // lock held
+    ScopedLock<> sl(piLock);
+    Thread* curr = owner;
+    owner = next;
+    EmbeddedList<Mutex>::remove(*this);
+    if (next) {
+      GENASSERT1(next->blockedOn == this, FmtHex(next->blockedOn));
+      next->blockedOn = nullptr;
+      waiting[next->priority] -= 1;
+      if (topWaiter() < maxPriority) {
+        next->heldMutexes.push_back(*this);
+        boost(next, topWaiter());
+      }
+    }
+    mword prio = inheritedPriority(*curr);
+    if (prio != curr->priority) Scheduler::reprioritize(*curr, prio);
+  }
+
 protected:
   BasicLock lock;
   Thread* owner;
   BlockingQueue bq;
 
-  bool internalAcquire(bool ownerLock, mword timeout = limit<mword>()) {
+#if TESTING_LOCK_STATS
+  LockStat stat;
+#endif
+
+  bool internalAcquire(bool ownerLock, mword timeout = limit<mword>() LOCK_SITE_NEXT) {
     if slowpath(owner == Runtime::getCurrThread()) {
       GENASSERT1(ownerLock, FmtHex(owner));
     } else {
       lock.acquire();
-      if slowpath(owner != nullptr) return bq.block(lock, timeout);
+      if slowpath(owner != nullptr) {
+        Thread* curr = Runtime::getCurrThread();
+        if (timeout > 0) inherit(curr);
+#if TESTING_LOCK_STATS
+        mword start = LockStat::now();
+        if (bq.block(lock, timeout)) {
+          stat.record(LockStat::now() - start, true, site);
+          return true;
+        }
+#else
+        if (bq.block(lock, timeout)) return true;
+#endif
+        if (timeout > 0) timedOut(curr);
+        return false;
+      }
       owner = Runtime::getCurrThread();
       lock.release();
+#if TESTING_LOCK_STATS
+      stat.record(0, false, site);
+#endif
     }
     return true;
   }
 
   void internalRelease() {
-    if slowpath(!bq.resume(lock, owner)) {      // try baton passing
-      owner = nullptr;                          // baton not passed
-      lock.release();
-    }
+    Thread* next = bq.unblock();                // try baton passing
+    if slowpath(onList()) disinherit(next);
+    else owner = next;
+    lock.release();
+    if (next) bq.wakeup(*next);
   }
 
 public:
-  Mutex() : owner(nullptr) {}
+  static void setBasePriority(Thread& t, mword prio) {
+    ScopedLock<> sl(piLock);
+    t.basePriority = prio;
+    recompute(&t);
+  }
+
+#if TESTING_LOCK_STATS
+  Mutex() : waiting(), owner(nullptr), stat("mutex") {}
+#else
+  Mutex() : waiting(), owner(nullptr) {}
+#endif
 
-  bool acquire() {
-    return internalAcquire(false);
+  bool acquire(LOCK_SITE) {
+    return internalAcquire(false, limit<mword>() LOCK_SITE_ARG_NEXT);
   }
 
   bool tryAcquire(mword t = 0) {
@@ -218,8 +347,8 @@ class OwnerLock : private Mutex {
 public:
   OwnerLock() : counter(0) {}
 
-  mword acquire() {
-    if slowpath(internalAcquire(true)) return ++counter; else return 0;
+  mword acquire(LOCK_SITE) {
+    if slowpath(internalAcquire(true, limit<mword>() LOCK_SITE_ARG_NEXT)) return ++counter; else return 0;
   }
 
   mword tryAcquire(mword t = 0) {
@@ -241,21 +370,40 @@ class Semaphore {
   BasicLock lock;
   mword counter;
   BlockingQueue bq;
+#if TESTING_LOCK_STATS
+  LockStat stat;
+#endif
 
-  bool internalP(BasicLock* l, mword timeout = limit<mword>()) {
+  bool internalP(BasicLock* l, mword timeout = limit<mword>() LOCK_SITE_NEXT) {
     lock.acquire(l);
+#if TESTING_LOCK_STATS
+    if fastpath(counter < 1) {
+      mword start = LockStat::now();
+      bool acquired = bq.block(lock, timeout);
+      if (acquired) stat.record(LockStat::now() - start, true, site);
+      return acquired;
+    }
+    counter -= 1;
+    lock.release();
+    stat.record(0, false, site);
+#else
     if fastpath(counter < 1) return bq.block(lock, timeout);
     counter -= 1;
     lock.release();
+#endif
     return true;
   }
 
 public:
+#if TESTING_LOCK_STATS
+  explicit Semaphore(mword c = 0) : counter(c), stat("sem") {}
+#else
   explicit Semaphore(mword c = 0) : counter(c) {}
+#endif
   bool empty() { return bq.empty(); }
 
-  bool P(BasicLock* l = nullptr) {
-    return internalP(l);
+  bool P(BasicLock* l = nullptr LOCK_SITE_NEXT) {
+    return internalP(l, limit<mword>() LOCK_SITE_ARG_NEXT);
   }
 
   bool tryP(mword t = 0, BasicLock* l = nullptr) {
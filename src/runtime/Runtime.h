@@ -21,6 +21,7 @@
 
 #include "kernel/AddressSpace.h"
 #include "kernel/Output.h"
+#include "kernel/Tracepoint.h"
 #include "machine/Machine.h"
 #include "machine/Processor.h"
 #include "machine/SpinLock.h"
@@ -106,6 +107,18 @@ namespace Runtime {
 
   template<typename... Args>
   static void debugS(const Args&... a) { DBG::outl(DBG::Scheduler, a...); }
+
+  /**** tracepoints ****/
+
+  static void traceSwitch(Thread* prev, Thread* next) {
+    Tracepoint::instant(TraceSwitch, mword(prev), mword(next));
+  }
+  static void traceBlock(Thread* t, ptr_t queue) {
+    Tracepoint::instant(TraceBlock, mword(t), mword(queue));
+  }
+  static void traceResume(Thread* t, ptr_t queue) {
+    Tracepoint::instant(TraceResume, mword(t), mword(queue));
+  }
 }
 
 #else
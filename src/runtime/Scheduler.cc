@@ -22,10 +22,12 @@
 
 Scheduler::Scheduler() : readyCount(0), preemption(0), resumption(0), partner(this) {
   Thread* idleThread = Thread::create((vaddr)idleStack, minimumStack);
-  idleThread->setAffinity(this)->setPriority(idlePriority);
   // use low-level routines, since runtime context might not exist
+  idleThread->setAffinity(this);
+  idleThread->priority = idleThread->basePriority = idlePriority;
   idleThread->stackPointer = stackInit(idleThread->stackPointer, &Runtime::getDefaultMemoryContext(), (ptr_t)Runtime::idleLoop, this, nullptr, nullptr);
   readyQueue[idlePriority].push_back(*idleThread);
+  idleThread->readyScheduler = this;
   readyCount += 1;
 }
 
@@ -49,6 +51,7 @@ inline void Scheduler::switchThread(Scheduler* target, Args&... a) {
 i += 1) {
     if (!readyQueue[i].empty()) {
       nextThread = readyQueue[i].pop_front();
+      __atomic_store_n(&nextThread->readyScheduler, nullptr, __ATOMIC_SEQ_CST);
       readyCount -= 1;
       goto threadFound;
     }
@@ -60,6 +63,11 @@ i += 1) {
 
 threadFound:
   readyLock.release();
+  switchTo(nextThread, target, a...);
+}
+
+template<typename... Args>
+inline void Scheduler::switchTo(Thread* nextThread, Scheduler* target, Args&... a) {
   resumption += 1;
   Thread* currThread = Runtime::getCurrThread();
   GENASSERTN(currThread && nextThread && nextThread != currThread, currThread, ' ', nextThread);
@@ -69,6 +77,7 @@ threadFound:
   unlock(a...);                                   // ...thus can unlock now
   CHECK_LOCK_COUNT(1);
   Runtime::debugS("Thread switch <", (target ? 'Y' : 'S'), ">: ", FmtHex(currThread), '(', FmtHex(currThread->stackPointer), ") to ", FmtHex(nextThread), '(', FmtHex(nextThread->stackPointer), ')');
+  Runtime::traceSwitch(currThread, nextThread);
 
   Runtime::MemoryContext& ctx = Runtime::getMemoryContext();
   Runtime::setCurrThread(nextThread);
@@ -97,9 +106,12 @@ extern "C" void invokeThread(Thread* prevThread, Runtime::MemoryContext* ctx, fu
 }
 
 void Scheduler::enqueue(Thread& t) {
-  GENASSERT1(t.priority < maxPriority, t.priority);
   readyLock.acquire();
-  readyQueue[t.priority].push_back(t);
+  // publish queue before reading priority -> see reprioritize()
+  __atomic_store_n(&t.readyScheduler, this, __ATOMIC_SEQ_CST);
+  mword prio = __atomic_load_n(&t.priority, __ATOMIC_SEQ_CST);
+  GENASSERT1(prio < maxPriority, prio);
+  readyQueue[prio].push_back(t);
   bool wake = (readyCount == 0);
   readyCount += 1;
   readyLock.release();
@@ -113,6 +125,24 @@ void Scheduler::resume(Thread& t) {
   else Runtime::getScheduler()->enqueue(t);
 }
 
+// change effective priority; move thread, if currently in a ready queue
+void Scheduler::reprioritize(Thread& t, mword prio) {
+  GENASSERT1(prio < maxPriority, prio);
+  __atomic_store_n(&t.priority, prio, __ATOMIC_SEQ_CST);
+  for (;;) {
+    Scheduler* s = __atomic_load_n(&t.readyScheduler, __ATOMIC_SEQ_CST);
+    if (!s) return;           // running or blocked: next enqueue uses 'prio'
+    s->readyLock.acquire();
+    if (t.readyScheduler == s) {
+      EmbeddedList<Thread>::remove(t);
+      s->readyQueue[t.priority].push_back(t);
+      s->readyLock.release();
+      return;
+    }
+    s->readyLock.release();   // dequeued or migrated concurrently -> retry
+  }
+}
+
 
 
 void Scheduler::preempt() {               // IRQs disabled, lock count inflated
@@ -155,6 +185,18 @@ void Scheduler::suspend(BasicLock& lk1, BasicLock& lk2) {
   switchThread(nullptr, lk1, lk2);
 }
 
+// switch directly to unblocked thread 't', bypassing the ready queue
+void Scheduler::handoff(Thread& t, BasicLock& lk) {
+  Runtime::FakeLock fl;
+  if (t.getAffinity() && t.getAffinity() != this) {
+    resume(t);
+    switchThread(nullptr, lk);
+  } else {
+    preemption += 1;
+    switchTo(&t, nullptr, lk);
+  }
+}
+
 void Scheduler::terminate() {
   Runtime::RealLock rl;
   Thread* thr = Runtime::getCurrThread();
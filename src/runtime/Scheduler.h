@@ -38,6 +38,9 @@ class Scheduler {
   template<typename... Args>
   inline void switchThread(Scheduler* target, Args&... a);
 
+  template<typename... Args>
+  inline void switchTo(Thread* nextThread, Scheduler* target, Args&... a);
+
   inline void enqueue(Thread& t);
 
   Scheduler(const Scheduler&) = delete;                  // no copy
@@ -47,9 +50,11 @@ public:
   Scheduler();
   void setPartner(Scheduler& s) { partner = &s; }
   static void resume(Thread& t);
+  static void reprioritize(Thread& t, mword prio);
   void preempt();
   void suspend(BasicLock& lk);
   void suspend(BasicLock& lk1, BasicLock& lk2);
+  void handoff(Thread& t, BasicLock& lk);
   void terminate() __noreturn;
   void yield();
 };
@@ -32,6 +32,11 @@ Thread* Thread::create(size_t ss) {
   return create(mem, ss);
 }
 
+Thread* Thread::setPriority(mword p) {
+  Mutex::setBasePriority(*this, p);
+  return this;
+}
+
 Thread* Thread::create() {
   return create(defaultStack);
 }
@@ -20,10 +20,12 @@
 #include "generic/EmbeddedContainers.h" 
 #include "runtime/Runtime.h"
 
+class Mutex;
 class Scheduler;
 class UnblockInfo;
 
 class Thread : public EmbeddedList<Thread>::Link {
+  friend class Mutex;       // Mutex implements priority inheritance
   friend class Scheduler;   // Scheduler accesses many internals
   friend void Runtime::postResume(bool, Thread&, AddressSpace&);
 
@@ -31,7 +33,11 @@ class Thread : public EmbeddedList<Thread>::Link {
   vaddr stackBottom;        // bottom of allocated memory for thread/stack
   size_t stackSize;         // size of allocated memory
 
-  mword priority;           // scheduling priority
+  mword priority;           // effective scheduling priority
+  mword basePriority;       // assigned priority, without inheritance
+  Mutex* blockedOn;         // mutex waited for (priority inheritance)
+  EmbeddedList<Mutex> heldMutexes; // held mutexes with waiters
+  Scheduler* readyScheduler; // ready queue holding thread, if any
   bool affinity;            // stick with scheduler
   cpu_set_t affinityMask;	 	 // stick with multiple schedulers
   // affinity mask of 0 means that the thread can be scheduled on any processor
@@ -50,7 +56,8 @@ protected:
 
   Thread(vaddr sb, size_t ss) :
     stackPointer(vaddr(this)), stackBottom(sb), stackSize(ss),
-    priority(defPriority), affinity(false), affinityMask(0), nextScheduler(nullptr),
+    priority(defPriority), basePriority(defPriority), blockedOn(nullptr),
+    readyScheduler(nullptr), affinity(false), affinityMask(0), nextScheduler(nullptr),
     state(Running), unblockInfo(nullptr) {}
 
   // called directly when creating idle thread(s)
@@ -83,7 +90,13 @@ public:
     return *unblockInfo;
   }
 
-  Thread* setPriority(mword p)      { priority = p; return this; }
+  Thread* setPriority(mword p);     // base priority, keeps inheritance
+  mword getPriority() const         { return priority; }
+
+  // object sits at the top of its stack
+  bool onStack(vaddr a, size_t n) const {
+    return a >= stackBottom && a + n <= vaddr(this);
+  }
 
   void   setAffinityMask( cpu_set_t mask ) { affinityMask = mask; }
   cpu_set_t  getAffinityMask() { return affinityMask; }
@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+# Host-side stand-in for the remote NetBench tests (main/NetBench.cc):
+# TCP discard (TCP_STREAM), TCP echo (TCP_RR) and UDP echo (UDP_RR).  With
+# QEMU user-net, the guest reaches host localhost via the gateway 10.0.2.2.
+# usage: netbench_host.py [address]
+import socket, sys, threading
+
+STREAM_PORT, TCP_RR_PORT, UDP_RR_PORT = 7780, 7781, 7782
+
+def serve_tcp(addr, port, echo):
+  ls = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+  ls.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+  ls.bind((addr, port))
+  ls.listen(4)
+  while True:
+    s, _ = ls.accept()
+    s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    threading.Thread(target=handle_tcp, args=(s, echo), daemon=True).start()
+
+def handle_tcp(s, echo):
+  with s:
+    while True:
+      data = s.recv(65536)
+      if not data: return
+      if echo: s.sendall(data)
+
+def serve_udp(addr, port):
+  s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+  s.bind((addr, port))
+  while True:
+    data, peer = s.recvfrom(65536)
+    s.sendto(data, peer)
+
+def main():
+  addr = sys.argv[1] if len(sys.argv) > 1 else "127.0.0.1"
+  threading.Thread(target=serve_tcp, args=(addr, STREAM_PORT, False), daemon=True).start()
+  threading.Thread(target=serve_tcp, args=(addr, TCP_RR_PORT, True), daemon=True).start()
+  print("netbench stand-in on %s ports %d %d %d" % (addr, STREAM_PORT, TCP_RR_PORT, UDP_RR_PORT))
+  serve_udp(addr, UDP_RR_PORT)
+
+if __name__ == "__main__":
+  main()
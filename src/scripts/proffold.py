@@ -0,0 +1,28 @@
+#!/usr/bin/env python3
+# Collect profiler samples (profile_dump) from the debug log, resolve
+# kernel addresses and print merged folded stacks for flamegraph.pl.
+# usage: proffold.py [kernel.sys.debug] [/tmp/$USER/KOS.dbg] > out.folded
+import collections, os, subprocess, sys
+
+def main():
+  kernel = sys.argv[1] if len(sys.argv) > 1 else "kernel.sys.debug"
+  log = sys.argv[2] if len(sys.argv) > 2 else "/tmp/%s/KOS.dbg" % os.environ.get("USER", "")
+  stacks = collections.Counter()
+  with open(log, "r", errors="replace") as f:
+    for line in f:
+      if not line.startswith("PROF "): continue
+      stack, _, n = line[5:].strip().rpartition(" ")
+      stacks[stack] += int(n)
+  addrs = sorted({a for s in stacks for a in s.split(";") if a.startswith("0x")})
+  names = {}
+  if addrs:
+    out = subprocess.run(["addr2line", "-f", "-C", "-e", kernel] + addrs,
+      stdout=subprocess.PIPE, universal_newlines=True).stdout.splitlines()
+    for i, a in enumerate(addrs):
+      func = out[2*i] if 2*i < len(out) else "??"
+      names[a] = a if func == "??" else func
+  for stack, n in sorted(stacks.items()):
+    print(";".join(names.get(a, a) for a in stack.split(";")), n)
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,13 @@
+#!/bin/bash
+# Drive user/rxbench from the host: send 'runs' transfers of 'mb' MB each
+# to the forwarded port; results appear in the KOS output, labelled with
+# the receive path (copy: TESTING_NET_COPY_RX, or zero-copy).
+# usage: rxbench_host.sh [runs] [mb] [port]
+runs=${1:-5}
+mb=${2:-64}
+port=${3:-7778}
+for i in $(seq $runs); do
+	dd if=/dev/zero bs=64k count=$((mb * 16)) 2>/dev/null | nc -q0 localhost $port || exit 1
+	sleep 1
+done
+exit 0
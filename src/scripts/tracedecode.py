@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# Decode a binary DBG trace (TESTING_DEBUG_TRACE) from the debug log.
+# usage: tracedecode.py [kernel.sys.debug] [/tmp/$USER/KOS.dbg]
+# Record layout: see DebugTrace::Record in kernel/Output.h
+import os, struct, sys
+
+# must match DBG::Level in kernel/Output.h
+levels = ["acpi", "boot", "basic", "cdi", "devices", "error", "frame",
+  "file", "gdbdebug", "gdbenable", "kmem", "libc", "lwip", "memacpi",
+  "paging", "pci", "perf", "process", "scheduler", "tests", "threads",
+  "vm", "warning"]
+
+def sections(path):
+  with open(path, "rb") as f:
+    data = f.read()
+  if data[:4] != b"\x7fELF" or data[4] != 2:
+    sys.exit(path + ": not an ELF64 file")
+  shoff, = struct.unpack_from("<Q", data, 0x28)
+  shentsize, shnum = struct.unpack_from("<HH", data, 0x3A)
+  result = []
+  for i in range(shnum):
+    _, stype, flags, addr, off, size = struct.unpack_from("<IIQQQQ", data, shoff + i * shentsize)
+    if stype == 1 and flags & 0x2 and addr:  # PROGBITS, ALLOC
+      result.append((addr, data[off:off+size]))
+  return result
+
+def string(secs, addr):
+  for base, content in secs:
+    if base <= addr < base + len(content):
+      end = content.find(b"\0", addr - base)
+      if end < 0: return None
+      s = content[addr - base:end]
+      if s and all(32 <= c < 127 for c in s): return s.decode()
+      return None
+  return None
+
+def main():
+  kernel = sys.argv[1] if len(sys.argv) > 1 else "kernel.sys.debug"
+  log = sys.argv[2] if len(sys.argv) > 2 else "/tmp/%s/KOS.dbg" % os.environ.get("USER", "")
+  secs = sections(kernel)
+  records = []
+  with open(log, "r", errors="replace") as f:
+    for line in f:
+      fields = line.split()
+      if len(fields) != 9 or fields[0] != "TRACE": continue
+      w = [int(x, 16) for x in fields[1:]]
+      core, level, argc, seq = w[1] & 0xFFFF, (w[1] >> 16) & 0xFF, (w[1] >> 24) & 0xFF, w[1] >> 32
+      records.append((w[0], core, seq, level, w[2], w[3:3+argc]))
+  if not records: sys.exit("no trace records found in " + log)
+  records.sort()
+  start = records[0][0]
+  for tsc, core, seq, level, event, args in records:
+    name = levels[level] if level < len(levels) else str(level)
+    text = [string(secs, event) or hex(event)]
+    for a in args:
+      s = string(secs, a)
+      text.append(repr(s) if s is not None else hex(a))
+    print("%14d C%-2d %-9s %s" % (tsc - start, core, name, " ".join(text)))
+
+if __name__ == "__main__":
+  main()
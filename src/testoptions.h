@@ -1,6 +1,11 @@
 //#define TESTING_ALWAYS_MIGRATE    1
+//#define TESTING_BENCHMARKS        1   // start benchmark programs at boot
+//#define TESTING_DEBUG_MASK        0x0 // debug levels compiled in, bit per DBG::Level
 //#define TESTING_DEBUG_STDOUT      1
+//#define TESTING_DEBUG_TRACE       1   // DBG::outl records binary trace
 //#define TESTING_KEYCODE_LOOP      1
+//#define TESTING_LOCK_STATS        1   // per-lock contention statistics
+//#define TESTING_NET_COPY_RX       1   // copy received frames into pool pbufs
 //#define TESTING_NEVER_MIGRATE     1
 //#define TESTING_NEVER_ALLOC_LAZY  1
 #define TESTING_PING_LOOP         1
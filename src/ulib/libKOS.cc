@@ -16,6 +16,13 @@
 ******************************************************************************/
 #include "syscalls.h"
 #include "kostypes.h"
+#include "ipc.h"
+#include "ring.h"
+#include "vdso.h"
+#include "dirent.h"
+#include "uio.h"
+#include "socket.h"
+#include "trace.h"
 
 #include <string.h>
 
@@ -66,26 +73,177 @@ extern "C" ssize_t write(int fildes, const void* buf, size_t nbyte) {
   if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
 }
 
+extern "C" ssize_t pread(int fildes, void* buf, size_t nbyte, off_t offset) {
+  ssize_t ret = syscallStub(SyscallNum::pread, fildes, mword(buf), nbyte, offset);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t pwrite(int fildes, const void* buf, size_t nbyte, off_t offset) {
+  ssize_t ret = syscallStub(SyscallNum::pwrite, fildes, mword(buf), nbyte, offset);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t readv(int fildes, const struct iovec* iov, int iovcnt) {
+  ssize_t ret = syscallStub(SyscallNum::readv, fildes, mword(iov), iovcnt);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t writev(int fildes, const struct iovec* iov, int iovcnt) {
+  if (fildes == STDOUT_FILENO) {                      // copy stdout to stddbg
+    syscallStub(SyscallNum::writev, STDDBG_FILENO, mword(iov), iovcnt);
+  }
+  ssize_t ret = syscallStub(SyscallNum::writev, fildes, mword(iov), iovcnt);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t preadv(int fildes, const struct iovec* iov, int iovcnt, off_t offset) {
+  ssize_t ret = syscallStub(SyscallNum::preadv, fildes, mword(iov), iovcnt, offset);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t pwritev(int fildes, const struct iovec* iov, int iovcnt, off_t offset) {
+  ssize_t ret = syscallStub(SyscallNum::pwritev, fildes, mword(iov), iovcnt, offset);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int profile_ctl(mword usecs) {
+  ssize_t ret = syscallStub(SyscallNum::profile_ctl, usecs);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int profile_dump() {
+  ssize_t ret = syscallStub(SyscallNum::profile_dump);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int lockstat(mword reset) {
+  ssize_t ret = syscallStub(SyscallNum::lockstat, reset);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int socket(int domain, int type, int protocol) {
+  ssize_t ret = syscallStub(SyscallNum::socket, domain, type, protocol);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int bind(int sockfd, const struct sockaddr* addr, socklen_t addrlen) {
+  ssize_t ret = syscallStub(SyscallNum::bind, sockfd, mword(addr), addrlen);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int listen(int sockfd, int backlog) {
+  ssize_t ret = syscallStub(SyscallNum::listen, sockfd, backlog);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen) {
+  ssize_t ret = syscallStub(SyscallNum::accept, sockfd, mword(addr), mword(addrlen));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen) {
+  ssize_t ret = syscallStub(SyscallNum::connect, sockfd, mword(addr), addrlen);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t send(int sockfd, const void* buf, size_t len, int flags) {
+  ssize_t ret = syscallStub(SyscallNum::send, sockfd, mword(buf), len, flags);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t recv(int sockfd, void* buf, size_t len, int flags) {
+  ssize_t ret = syscallStub(SyscallNum::recv, sockfd, mword(buf), len, flags);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t sendto(int sockfd, const void* buf, size_t len, int flags, const struct sockaddr* addr, socklen_t addrlen) {
+  mword fdflags = mword(unsigned(sockfd)) | (mword(unsigned(flags)) << 32);
+  ssize_t ret = syscallStub(SyscallNum::_sendto, fdflags, mword(buf), len, mword(addr), addrlen);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" ssize_t recvfrom(int sockfd, void* buf, size_t len, int flags, struct sockaddr* addr, socklen_t* addrlen) {
+  mword fdflags = mword(unsigned(sockfd)) | (mword(unsigned(flags)) << 32);
+  ssize_t ret = syscallStub(SyscallNum::_recvfrom, fdflags, mword(buf), len, mword(addr), mword(addrlen));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int setsockopt(int sockfd, int level, int optname, const void* optval, socklen_t optlen) {
+  ssize_t ret = syscallStub(SyscallNum::setsockopt, sockfd, level, optname, mword(optval), optlen);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int pollstat(mword reset) {
+  ssize_t ret = syscallStub(SyscallNum::pollstat, reset);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" mword trace_ctl(mword mask) {
+  return syscallStub(SyscallNum::trace_ctl, mask);
+}
+
+extern "C" ssize_t trace_read(struct TraceRecord* buf, size_t count) {
+  ssize_t ret = syscallStub(SyscallNum::trace_read, mword(buf), count);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int trace_dump() {
+  ssize_t ret = syscallStub(SyscallNum::trace_dump);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
 extern "C" off_t lseek(int fildes, off_t offset, int whence) {
   ssize_t ret = syscallStub(SyscallNum::lseek, fildes, offset, whence);
   if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
 }
 
+extern "C" int unlink(const char *path) {
+  ssize_t ret = syscallStub(SyscallNum::unlink, mword(path));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int ftruncate(int fildes, off_t length) {
+  ssize_t ret = syscallStub(SyscallNum::ftruncate, fildes, length);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int shm_open(const char *name, int oflag, mode_t mode) {
+  ssize_t ret = syscallStub(SyscallNum::shm_open, mword(name), oflag, mode);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int shm_unlink(const char *name) {
+  ssize_t ret = syscallStub(SyscallNum::shm_unlink, mword(name));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
 /*added by Priyaa*/
+// read from vDSO page without trapping
 extern "C" long get_core_count() {
-  return syscallStub(SyscallNum::get_core_count);
+  return vdso()->processorCount;
 }
 
 extern "C" pid_t getpid() {
-  return syscallStub(SyscallNum::getpid);
+  return vdso()->pid;
 }
 
 extern "C" pid_t getcid() {
-  return syscallStub(SyscallNum::getcid);
+  if (!vdso()->rdtscp) return syscallStub(SyscallNum::getcid);
+  mword a, c, d;
+  asm volatile("rdtscp" : "=a"(a), "=c"(c), "=d"(d));
+  return c;
+}
+
+extern "C" mword get_time_usecs() {
+  const VdsoData* vd = vdso();
+  if (!vd->tscPerUsec) return 0;
+  mword a, d;
+  asm volatile("rdtsc" : "=a"(a), "=d"(d));
+  return (((d << 32) | a) - vd->tscBase) / vd->tscPerUsec;
 }
 
 extern "C" int usleep(useconds_t usecs) {
-  return syscallStub(SyscallNum::getcid, usecs);
+  return syscallStub(SyscallNum::usleep, usecs);
 }
 
 extern "C" void* mmap(void* addr, size_t len, int prot, int flags, int filedes, off_t off) {
@@ -99,23 +257,90 @@ extern "C" int munmap(void* addr, size_t len) {
   if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
 }
 
+extern "C" int ringCreate(mword* rid, size_t entries, mword flags, RingHead** ring) {
+  ssize_t ret = syscallStub(SyscallNum::ringCreate, mword(rid), entries, flags, mword(ring));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int ringDestroy(mword rid) {
+  ssize_t ret = syscallStub(SyscallNum::ringDestroy, rid);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int ringEnter(mword rid) {
+  ssize_t ret = syscallStub(SyscallNum::ringEnter, rid);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
 extern "C" int privilege(void* func, mword a1, mword a2, mword a3, mword a4) {
   return syscallStub(SyscallNum::privilege, (mword)func, a1, a2, a3, a4);
 }
 
-/******* dummy functions *******/
+extern "C" int ipcCreate(mword* reid) {
+  ssize_t ret = syscallStub(SyscallNum::ipcCreate, mword(reid));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int ipcDestroy(mword eid) {
+  ssize_t ret = syscallStub(SyscallNum::ipcDestroy, eid);
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int ipc_call(mword eid, IpcMessage* msg) {
+  ssize_t ret = syscallStub(SyscallNum::ipc_call, eid, mword(msg));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int ipc_reply_wait(mword eid, IpcMessage* reply, IpcMessage* msg) {
+  ssize_t ret = syscallStub(SyscallNum::ipc_reply_wait, eid, mword(reply), mword(msg));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
 
 extern "C" int fstat(int fildes, struct stat *buf) {
-  memset(buf, 0, sizeof(struct stat));
-  switch (fildes) {
-    case STDIN_FILENO:  buf->st_mode = S_IFCHR;
-    case STDOUT_FILENO: buf->st_mode = S_IFCHR;
-    case STDERR_FILENO: buf->st_mode = S_IFCHR;
-    default: buf->st_mode = S_IFREG;
+  ssize_t ret = syscallStub(SyscallNum::fstat, fildes, mword(buf));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int stat(const char *path, struct stat *buf) {
+  ssize_t ret = syscallStub(SyscallNum::stat, mword(path), mword(buf));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" int _readdir(int fildes, struct dirent* ent) {
+  ssize_t ret = syscallStub(SyscallNum::_readdir, fildes, mword(ent));
+  if (ret < 0) { *__errno() = -ret; return -1; } else return ret;
+}
+
+extern "C" DIR* opendir(const char* name) {
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISDIR(st.st_mode)) {
+    close(fd);
+    *__errno() = ENOTDIR;
+    return nullptr;
   }
-  return 0;
+  DIR* dirp = (DIR*)malloc(sizeof(DIR));
+  if (!dirp) {
+    close(fd);
+    return nullptr;
+  }
+  dirp->fd = fd;
+  return dirp;
+}
+
+extern "C" struct dirent* readdir(DIR* dirp) {
+  return _readdir(dirp->fd, &dirp->ent) > 0 ? &dirp->ent : nullptr;
 }
 
+extern "C" int closedir(DIR* dirp) {
+  int ret = close(dirp->fd);
+  free(dirp);
+  return ret;
+}
+
+/******* dummy functions *******/
+
 extern "C" char *getenv(const char *name) {
   return nullptr;
 }
@@ -0,0 +1,92 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "socket.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Cost of calls into lwIP: a setsockopt is a single API call without data
+// (with core locking, executed directly by the calling thread); a loopback
+// UDP round trip is a sendto/recvfrom pair on one socket.
+static const int rounds = 100000;
+static const in_port_t port = 7777;
+static const size_t msgSize = 32;
+
+static mword lat[rounds];
+
+static inline mword rdtsc() {
+  mword a, d;
+  asm volatile("rdtsc" : "=a"(a), "=d"(d));
+  return (d << 32) | a;
+}
+
+static int cmp(const void* a, const void* b) {
+  mword x = *(const mword*)a, y = *(const mword*)b;
+  return (x > y) - (x < y);
+}
+
+static void report(const char* name, int n, mword usecs) {
+  if (n == 0) return;
+  if (usecs == 0) usecs = 1;
+  mword sum = 0;
+  for (int i = 0; i < n; i += 1) sum += lat[i];
+  qsort(lat, n, sizeof(mword), cmp);
+  printf("apibench: %s %d calls in %lu usecs, %lu calls/s, cycles avg %lu p50 %lu p99 %lu max %lu\n",
+    name, n, usecs, mword(n) * 1000000 / usecs, sum / n, lat[n / 2], lat[n * 99 / 100], lat[n - 1]);
+}
+
+// API call rate and latency: reports calls/sec and cycles per call
+int main() {
+  int sd = -1;
+  for (int retry = 0; retry < 100 && sd < 0; retry += 1) { // network may still start
+    sd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sd < 0) usleep(100000);
+  }
+  if (sd < 0) { perror("apibench: socket"); return 1; }
+
+  int n;
+  int on = 1;
+  mword start = get_time_usecs();
+  for (n = 0; n < rounds; n += 1) {
+    mword t = rdtsc();
+    if (setsockopt(sd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) < 0) { perror("apibench: setsockopt"); break; }
+    lat[n] = rdtsc() - t;
+  }
+  report("setsockopt", n, get_time_usecs() - start);
+
+  struct sockaddr_in addr = {};
+  addr.sin_len = sizeof(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) { perror("apibench: bind"); return 1; }
+  char msg[msgSize];
+  memset(msg, 'a', msgSize);
+  start = get_time_usecs();
+  for (n = 0; n < rounds; n += 1) {
+    mword t = rdtsc();
+    if (sendto(sd, msg, msgSize, 0, (struct sockaddr*)&addr, sizeof(addr)) != ssize_t(msgSize)) { perror("apibench: sendto"); break; }
+    if (recvfrom(sd, msg, msgSize, 0, nullptr, nullptr) != ssize_t(msgSize)) { perror("apibench: recvfrom"); break; }
+    lat[n] = rdtsc() - t;
+  }
+  report("udp-loopback-rtt", n, get_time_usecs() - start);
+  close(sd);
+  return 0;
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "pthread.h"
+#include "socket.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+// With QEMU user networking, the gateway 10.0.2.2 forwards the connection
+// to the host, whose 'hostfwd' rule (see Makefile.config) hands it back to
+// the echo server in the guest, so requests traverse the emulated NIC.
+// Use INADDR_LOOPBACK to measure the stack without the device.
+static const in_addr_t server = (10 << 24) | (0 << 16) | (2 << 8) | 2;
+static const in_port_t port = 7777;
+static const int clients = 4;
+static const int requests = 5000;
+static const size_t msgSize = 64;
+
+static mword done[clients];
+
+static int connectServer() {
+  for (int retry = 0; retry < 100; retry += 1) {   // DHCP may be pending
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) return -1;
+    struct sockaddr_in addr = {};
+    addr.sin_len = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(server);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+    close(fd);
+    usleep(100000);
+  }
+  return -1;
+}
+
+// closed loop: send request, wait for complete echo
+static void* client(void* arg) {
+  long idx = (long)arg;
+  int fd = connectServer();
+  if (fd < 0) { perror("echoload: connect"); return nullptr; }
+  char msg[msgSize], buf[msgSize];
+  memset(msg, 'a' + idx, msgSize);
+  for (int i = 0; i < requests; i += 1) {
+    if (send(fd, msg, msgSize, 0) != ssize_t(msgSize)) break;
+    size_t got = 0;
+    while (got < msgSize) {
+      ssize_t n = recv(fd, buf + got, msgSize - got, 0);
+      if (n <= 0) goto fail;
+      got += n;
+    }
+    done[idx] += 1;
+  }
+fail:
+  close(fd);
+  return nullptr;
+}
+
+// load generator for echoserver: reports requests/sec over all clients
+int main() {
+  pthread_t tid[clients];
+  mword start = get_time_usecs();
+  for (long i = 0; i < clients; i += 1) pthread_create(&tid[i], nullptr, client, (void*)i);
+  for (int i = 0; i < clients; i += 1) pthread_join(tid[i], nullptr);
+  mword usecs = get_time_usecs() - start;
+  if (usecs == 0) usecs = 1;
+  mword total = 0;
+  for (int i = 0; i < clients; i += 1) total += done[i];
+  printf("echoload: %lu requests of %lu bytes, %d clients: %lu usecs, %lu req/s\n",
+    total, msgSize, clients, usecs, total * 1000000 / usecs);
+  return 0;
+}
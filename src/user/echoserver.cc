@@ -0,0 +1,63 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "pthread.h"
+#include "socket.h"
+
+#include <unistd.h>
+#include <stdio.h>
+
+static const in_port_t port = 7777;
+
+static void* echo(void* arg) {
+  int fd = (long)arg;
+  char buf[2048];
+  for (;;) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) break;
+    for (ssize_t off = 0; off < n; ) {
+      ssize_t s = send(fd, buf + off, n - off, 0);
+      if (s < 0) goto done;
+      off += s;
+    }
+  }
+done:
+  close(fd);
+  return nullptr;
+}
+
+// TCP echo server, one thread per connection; see echoload
+int main() {
+  int sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sd < 0) { perror("echoserver: socket"); return 1; }
+  int one = 1;
+  setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = {};
+  addr.sin_len = sizeof(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) { perror("echoserver: bind"); return 1; }
+  if (listen(sd, 8) < 0) { perror("echoserver: listen"); return 1; }
+  printf("echoserver: listening on port %u\n", port);
+  for (;;) {
+    int fd = accept(sd, nullptr, nullptr);
+    if (fd < 0) { perror("echoserver: accept"); continue; }
+    pthread_t t;
+    pthread_create(&t, nullptr, echo, (void*)(long)fd);
+  }
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const size_t fileSize = 4 * 1024 * 1024;
+static const size_t blockSizes[] = { 512, 4096, 65536 };
+static char buffer[65536];
+
+static unsigned long seed = 1;
+static size_t rnd(size_t max) {
+  seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+  return (seed >> 33) % max;
+}
+
+static void report(const char* what, size_t bs, mword usecs) {
+  if (usecs == 0) usecs = 1;
+  printf("%-10s %6lu bytes: %6lu usecs, %5lu MB/s\n", what, bs, usecs, fileSize / usecs);
+}
+
+// tmpfs throughput: sequential and random access with various block sizes
+int main() {
+  memset(buffer, 'x', sizeof(buffer));
+  for (size_t bs : blockSizes) {
+    int fd = open("/tmp/fsbench", O_CREAT|O_RDWR|O_TRUNC);
+    if (fd < 0) { printf("fsbench: open failed\n"); return 1; }
+    size_t blocks = fileSize / bs;
+
+    mword start = get_time_usecs();
+    for (size_t i = 0; i < blocks; i += 1) write(fd, buffer, bs);
+    report("seq write", bs, get_time_usecs() - start);
+
+    lseek(fd, 0, SEEK_SET);
+    start = get_time_usecs();
+    for (size_t i = 0; i < blocks; i += 1) read(fd, buffer, bs);
+    report("seq read", bs, get_time_usecs() - start);
+
+    start = get_time_usecs();
+    for (size_t i = 0; i < blocks; i += 1) {
+      lseek(fd, rnd(blocks) * bs, SEEK_SET);
+      write(fd, buffer, bs);
+    }
+    report("rand write", bs, get_time_usecs() - start);
+
+    start = get_time_usecs();
+    for (size_t i = 0; i < blocks; i += 1) {
+      lseek(fd, rnd(blocks) * bs, SEEK_SET);
+      read(fd, buffer, bs);
+    }
+    report("rand read", bs, get_time_usecs() - start);
+
+    close(fd);
+    unlink("/tmp/fsbench");
+  }
+  return 0;
+}
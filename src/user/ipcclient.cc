@@ -0,0 +1,59 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "ipc.h"
+
+#include <stdio.h>
+
+static const int rounds = 10000;
+static const size_t pagecount = 4;
+
+static inline mword rdtsc() {
+  mword a, d;
+  asm volatile("rdtsc" : "=a"(a), "=d"(d));
+  return (d << 32) | a;
+}
+
+// round-trip latency of synchronous IPC with ipcserver (endpoint 0)
+int main() {
+  IpcMessage msg = {};
+  while (ipc_call(0, &msg) < 0) usleep(10);         // wait for server
+
+  mword start = rdtsc();
+  for (int i = 0; i < rounds; i += 1) {
+    msg.words[0] = i;
+    ipc_call(0, &msg);
+  }
+  mword words = (rdtsc() - start) / rounds;
+
+  msg.size = pagecount * 4096;
+  msg.pages = mmap(nullptr, msg.size, 0, 0, -1, 0);
+  start = rdtsc();
+  for (int i = 0; i < rounds; i += 1) {
+    msg.words[0] = i;
+    ((mword*)msg.pages)[0] = i;                     // touch granted page
+    ipc_call(0, &msg);
+  }
+  mword pages = (rdtsc() - start) / rounds;
+  munmap(msg.pages, msg.size);
+
+  msg.words[0] = ~mword(0);
+  msg.size = 0;
+  ipc_call(0, &msg);
+  printf("IPC round trip: %lu cycles, with %lu pages: %lu cycles\n", words, pagecount, pages);
+  return 0;
+}
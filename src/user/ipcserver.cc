@@ -0,0 +1,39 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "ipc.h"
+
+#include <stdio.h>
+
+// echo server for ipcclient: the first endpoint created gets id 0
+int main() {
+  mword eid;
+  if (ipcCreate(&eid) < 0 || eid != 0) {
+    printf("ipcserver: cannot create endpoint 0\n");
+    return 1;
+  }
+  IpcMessage msg;
+  ipc_reply_wait(eid, nullptr, &msg);
+  while (msg.words[0] != ~mword(0)) {
+    IpcMessage reply = msg;        // echo payload, grant pages back
+    reply.words[1] = msg.words[0] + 1;
+    ipc_reply_wait(eid, &reply, &msg);
+  }
+  ipc_reply_wait(eid, &msg, nullptr);
+  ipcDestroy(eid);
+  return 0;
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "socket.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+// Small UDP datagrams to the discard port of the QEMU user network gateway:
+// slirp consumes them, so this measures the transmit path through the
+// emulated e1000.  'full' counts sends refused while the TX ring is full.
+static const in_addr_t target = (10 << 24) | (0 << 16) | (2 << 8) | 2;
+static const in_port_t port = 9;
+static const int packets = 100000;
+static const size_t msgSize = 18;   // minimum Ethernet frame
+
+// transmit packet rate: reports packets/sec
+int main() {
+  int sd = -1;
+  for (int retry = 0; retry < 100 && sd < 0; retry += 1) { // DHCP may be pending
+    sd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sd < 0) usleep(100000);
+  }
+  if (sd < 0) { perror("pktbench: socket"); return 1; }
+  struct sockaddr_in addr = {};
+  addr.sin_len = sizeof(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(target);
+  char msg[msgSize];
+  memset(msg, 'p', msgSize);
+  mword sent = 0, full = 0;
+  mword start = get_time_usecs();
+  while (sent < packets) {
+    if (sendto(sd, msg, msgSize, 0, (struct sockaddr*)&addr, sizeof(addr)) == ssize_t(msgSize)) {
+      sent += 1;
+    } else if (errno == ENOMEM) {
+      full += 1;
+    } else {
+      perror("pktbench: sendto");
+      break;
+    }
+  }
+  mword usecs = get_time_usecs() - start;
+  if (usecs == 0) usecs = 1;
+  close(sd);
+  printf("pktbench: %lu packets of %lu bytes in %lu usecs, %lu pkts/s, %lu ring full\n",
+    sent, msgSize, usecs, sent * 1000000 / usecs, full);
+  return 0;
+}
@@ -0,0 +1,53 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+static const int rounds = 64;
+
+static void report(const char* what, size_t bytes, mword usecs) {
+  if (usecs == 0) usecs = 1;
+  printf("%-10s %8lu bytes: %6lu usecs, %5lu MB/s\n", what, bytes, usecs, bytes / usecs);
+}
+
+static void bench(const char* what, char* buf, size_t size) {
+  int fd = open("readbench", O_RDONLY);
+  if (fd < 0) { printf("readbench: open failed\n"); return; }
+  mword start = get_time_usecs();
+  for (int i = 0; i < rounds; i += 1) {
+    lseek(fd, 0, SEEK_SET);
+    read(fd, buf, size);
+  }
+  report(what, size * rounds, get_time_usecs() - start);
+  close(fd);
+}
+
+// ramdisk read throughput: page-aligned (remapped) vs. unaligned (copied)
+int main() {
+  struct stat st;
+  if (stat("readbench", &st) < 0) { printf("readbench: stat failed\n"); return 1; }
+  size_t size = st.st_size & ~size_t(4095);
+  if (size == 0) { printf("readbench: file too small\n"); return 1; }
+  char* buf = (char*)mmap(nullptr, size + 4096, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (buf == MAP_FAILED) { printf("readbench: mmap failed\n"); return 1; }
+  bench("aligned", buf, size);
+  bench("unaligned", buf + 1, size);
+  munmap(buf, size + 4096);
+  return 0;
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "pthread.h"
+#include "ring.h"
+
+#include <stdio.h>
+
+static const int rounds = 100000;
+static const size_t entries = 64;
+
+static inline mword rdtsc() {
+  mword a, d;
+  asm volatile("rdtsc" : "=a"(a), "=d"(d));
+  return (d << 32) | a;
+}
+
+// submit 'rounds' semaphore V/P pairs in batches, reap all completions
+static mword batched(mword rid, RingHead* r, bool poll, mword sid) {
+  RingSqe* sqes = ringSqes(r);
+  RingCqe* cqes = ringCqes(r);
+  mword mask = r->sqEntries - 1;
+  mword start = rdtsc();
+  for (int i = 0; i < rounds; i += entries) {
+    mword tail = r->sqTail;
+    for (size_t e = 0; e < entries; e += 1) {
+      RingSqe& sqe = sqes[(tail + e) & mask];
+      sqe.op = (e % 2) ? RingSemP : RingSemV;
+      sqe.fd = sid;
+      sqe.data = i + e;
+    }
+    __atomic_store_n(&r->sqTail, tail + entries, __ATOMIC_SEQ_CST);
+    if (!poll || (__atomic_load_n(&r->flags, __ATOMIC_SEQ_CST) & RingNeedWakeup)) {
+      ringEnter(rid);
+    }
+    while (__atomic_load_n(&r->cqTail, __ATOMIC_ACQUIRE) != r->cqHead + entries) {
+      if (r->flags & RingNeedWakeup) ringEnter(rid);  // poller went to sleep
+    }
+    for (mword h = r->cqHead; h != r->cqTail; h += 1) {
+      if (cqes[h & (r->cqEntries - 1)].result < 0) printf("ring op failed\n");
+    }
+    __atomic_store_n(&r->cqHead, r->cqTail, __ATOMIC_RELEASE);
+  }
+  return rdtsc() - start;
+}
+
+// throughput of semaphore operations: plain system calls vs. syscall ring
+int main() {
+  mword sid;
+  semCreate(&sid, 0);
+
+  mword start = rdtsc();
+  for (int i = 0; i < rounds; i += 2) {
+    semV(sid);
+    semP(sid);
+  }
+  mword plain = rdtsc() - start;
+
+  mword rid;
+  RingHead* r;
+  ringCreate(&rid, entries, 0, &r);
+  mword sync = batched(rid, r, false, sid);
+  ringDestroy(rid);
+
+  ringCreate(&rid, entries, RingPoll, &r);
+  mword poll = batched(rid, r, true, sid);
+  ringDestroy(rid);
+
+  semDestroy(sid);
+  printf("ops: %d, cycles/op: syscall %lu, ring %lu, ring+poller %lu\n",
+    rounds, plain / rounds, sync / rounds, poll / rounds);
+  return 0;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "syscalls.h"
+#include "socket.h"
+
+#include <unistd.h>
+#include <stdio.h>
+
+static const in_port_t port = 7778;
+static char buffer[65536];
+
+#if TESTING_NET_COPY_RX
+static const char* path = "copy";
+#else
+static const char* path = "zero-copy";
+#endif
+
+// TCP receive throughput: drain each connection and report MB/s, e.g.,
+//   dd if=/dev/zero bs=64k count=1024 | nc -q0 localhost 7778
+// on the host with QEMU user networking (see hostfwd in Makefile.config),
+// or scripts/rxbench_host.sh for repeated runs.
+// Compare with TESTING_NET_COPY_RX to measure the zero-copy receive path.
+// Device interrupt and poll counters for each run go to debug output.
+int main() {
+  int sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sd < 0) { perror("rxbench: socket"); return 1; }
+  struct sockaddr_in addr = {};
+  addr.sin_len = sizeof(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) { perror("rxbench: bind"); return 1; }
+  if (listen(sd, 1) < 0) { perror("rxbench: listen"); return 1; }
+  for (;;) {
+    int fd = accept(sd, nullptr, nullptr);
+    if (fd < 0) { perror("rxbench: accept"); continue; }
+    mword bytes = 0;
+    mword start = get_time_usecs();
+    for (;;) {
+      ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+      if (n <= 0) break;
+      bytes += n;
+    }
+    mword usecs = get_time_usecs() - start;
+    if (usecs == 0) usecs = 1;
+    close(fd);
+    printf("rxbench: %s %lu bytes in %lu usecs, %lu MB/s\n", path, bytes, usecs, bytes / usecs);
+    pollstat(1);
+  }
+}
@@ -15,14 +15,65 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 #include "world/Access.h"
+#include "kernel/AddressSpace.h"
+#include "kernel/MemoryManager.h"
 
 #include <cstring>
 
-map<string,RamFile> kernelFS;
+SpinLock shmLock;
+map<string,PageFile*> shmFS;
 
+// Generic vectored I/O: stop at the first short transfer; an error is
+// only reported if nothing has been transferred.
+template<typename Op>
+static ssize_t iterate(const struct iovec* iov, int cnt, Op op) {
+  size_t total = 0;
+  for (int i = 0; i < cnt; i += 1) {
+    ssize_t len = op(iov[i], total);
+    if (len < 0) return total ? ssize_t(total) : len;
+    total += len;
+    if (size_t(len) < iov[i].iov_len) break;
+  }
+  return total;
+}
+
+ssize_t Access::preadv(const struct iovec* iov, int cnt, off_t o) {
+  return iterate(iov, cnt, [&](const struct iovec& v, size_t done) {
+    return pread(v.iov_base, v.iov_len, o + done);
+  });
+}
+
+ssize_t Access::pwritev(const struct iovec* iov, int cnt, off_t o) {
+  return iterate(iov, cnt, [&](const struct iovec& v, size_t done) {
+    return pwrite(v.iov_base, v.iov_len, o + done);
+  });
+}
+
+ssize_t Access::readv(const struct iovec* iov, int cnt) {
+  return iterate(iov, cnt, [&](const struct iovec& v, size_t) {
+    return read(v.iov_base, v.iov_len);
+  });
+}
+
+ssize_t Access::writev(const struct iovec* iov, int cnt) {
+  return iterate(iov, cnt, [&](const struct iovec& v, size_t) {
+    return write(v.iov_base, v.iov_len);
+  });
+}
+
+// Page-aligned reads into user memory map the module's frames
+// copy-on-write instead of copying; the unaligned tail is copied.
 ssize_t FileAccess::pread(void *buf, size_t nbyte, off_t o) {
-  if (o + nbyte > rf.size) nbyte = rf.size - o;
-  memcpy( buf, (bufptr_t)(rf.vma + o), nbyte );
+  if (o < 0) return -EINVAL;
+  if (size_t(o) >= rf.size) return 0;
+  if (nbyte > rf.size - o) nbyte = rf.size - o;
+  size_t mapped = align_down(nbyte, pagesize<1>());
+  if (mapped == 0 || !aligned(vaddr(buf), pagesize<1>())
+    || !aligned(rf.pma + o, pagesize<1>()) || vaddr(buf) >= usertop
+    || !CurrAS().user() || !CurrAS().mapCopyOnWrite(vaddr(buf), mapped, rf.pma + o)) {
+    mapped = 0;
+  }
+  memcpy( (bufptr_t)buf + mapped, (bufptr_t)(rf.vma + o + mapped), nbyte - mapped );
   return nbyte;
 }
 
@@ -34,6 +85,14 @@ ssize_t FileAccess::read(void *buf, size_t nbyte) {
   return len;
 }
 
+ssize_t FileAccess::readv(const struct iovec* iov, int cnt) {
+  olock.acquire();
+  ssize_t len = preadv(iov, cnt, offset);
+  if (len >= 0) offset += len;
+  olock.release();
+  return len;
+}
+
 off_t FileAccess::lseek(off_t o, int whence) {
   off_t new_o;
   switch (whence) {
@@ -46,3 +105,82 @@ off_t FileAccess::lseek(off_t o, int whence) {
   offset = new_o;
   return offset;
 }
+
+int FileAccess::mmap(AddressSpace& as, vaddr& addr, size_t len, bool writable, off_t o) {
+  if (writable) return -EACCES;              // boot module frames are shared
+  if (!aligned(rf.pma, pagesize<1>())) return -ENODEV;
+  if (o < 0 || o + len > align_up(rf.size, pagesize<1>())) return -ENXIO;
+  vaddr va = as.mapShared<1>(addr, len, writable, [&](size_t i) {
+    return rf.pma + o + i * pagesize<1>();   // ramdisk frames: no refcount
+  });
+  if (va == topaddr) return -ENOMEM;
+  addr = va;
+  return 0;
+}
+
+off_t DirAccess::lseek(off_t o, int whence) {
+  if (whence != SEEK_SET || o < 0) return -EINVAL;   // offset is entry index
+  ScopedLock<> sl(olock);
+  offset = o;
+  return offset;
+}
+
+int DirAccess::readdir(struct dirent& ent) {
+  static_assert(sizeof(ent.d_name) == Dentry::NameMax + 1, "dirent name size");
+  mword ino;
+  bool dir;
+  ScopedLock<> sl(olock);
+  if (!kernelFS.entry(de, offset, ino, dir, ent.d_name)) return 0;
+  ent.d_ino = ino;
+  ent.d_type = dir ? DT_DIR : DT_REG;
+  offset += 1;
+  return 1;
+}
+
+PageFileAccess::~PageFileAccess() {
+  if (pf.detach()) kdelete(&pf);
+}
+
+ssize_t PageFileAccess::read(void *buf, size_t nbyte) {
+  ScopedLock<Mutex> sl(olock);
+  ssize_t len = pread(buf, nbyte, offset);
+  if (len > 0) offset += len;
+  return len;
+}
+
+ssize_t PageFileAccess::write(const void *buf, size_t nbyte) {
+  ScopedLock<Mutex> sl(olock);
+  if (append) offset = pf.getSize();
+  ssize_t len = pwrite(buf, nbyte, offset);
+  if (len > 0) offset += len;
+  return len;
+}
+
+ssize_t PageFileAccess::readv(const struct iovec* iov, int cnt) {
+  ScopedLock<Mutex> sl(olock);
+  ssize_t len = preadv(iov, cnt, offset);
+  if (len > 0) offset += len;
+  return len;
+}
+
+ssize_t PageFileAccess::writev(const struct iovec* iov, int cnt) {
+  ScopedLock<Mutex> sl(olock);
+  if (append) offset = pf.getSize();
+  ssize_t len = pwritev(iov, cnt, offset);
+  if (len > 0) offset += len;
+  return len;
+}
+
+off_t PageFileAccess::lseek(off_t o, int whence) {
+  ScopedLock<Mutex> sl(olock);
+  off_t new_o;
+  switch (whence) {
+    case SEEK_SET: new_o = o; break;
+    case SEEK_CUR: new_o = offset + o; break;
+    case SEEK_END: new_o = pf.getSize() + o; break;
+    default: return -EINVAL;
+  }
+  if (new_o < 0) return -EINVAL;
+  offset = new_o;
+  return offset;
+}
@@ -19,13 +19,24 @@
 
 #include "runtime/SynchronizedArray.h"
 #include "kernel/Output.h"
+#include "world/KernelFS.h"
+#include "world/PageFile.h"
 #include "devices/Keyboard.h"
 
+#include "dirent.h"
+#include "uio.h"
+
 #include <map>
 #include <string>
+#include <vector>
 #include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <unistd.h> // SEEK_SET, SEEK_CUR, SEEK_END
 
+class AddressSpace;
+class SocketAccess;
+
 class Access : public SynchronizedElement {
 public:
   virtual ~Access() {}
@@ -33,27 +44,89 @@ public:
   virtual ssize_t pwrite(const void *buf, size_t nbyte, off_t o) { return -EBADF; }
   virtual ssize_t read(void *buf, size_t nbyte) { return -EBADF; }
   virtual ssize_t write(const void *buf, size_t nbyte) { return -EBADF; }
+  // vectored transfers; defaults loop over the scalar versions above
+  virtual ssize_t preadv(const struct iovec* iov, int cnt, off_t o);
+  virtual ssize_t pwritev(const struct iovec* iov, int cnt, off_t o);
+  virtual ssize_t readv(const struct iovec* iov, int cnt);
+  virtual ssize_t writev(const struct iovec* iov, int cnt);
   virtual off_t lseek(off_t o, int whence) { return -EBADF; }
+  virtual int ftruncate(off_t length) { return -EINVAL; }
+  // MAP_SHARED: map backing frames directly; 'addr' is hint and result
+  virtual int mmap(AddressSpace& as, vaddr& addr, size_t len, bool writable, off_t o) { return -ENODEV; }
+  virtual int fstat(struct stat& st) { return -EBADF; }
+  // next directory entry: 1 if found, 0 at end
+  virtual int readdir(struct dirent& ent) { return -ENOTDIR; }
+  // socket operations, see SocketAccess; no RTTI in kernel
+  virtual SocketAccess* socket() { return nullptr; }
 };
 
-struct RamFile {
-  vaddr vma;
-  paddr pma;
-  size_t size;
-  RamFile(vaddr v, paddr p, size_t s) : vma(v), pma(p), size(s) {}
-};
-
-extern map<string,RamFile> kernelFS;
-
 class FileAccess : public Access {
   SpinLock olock;
   off_t offset;
-  const RamFile &rf;
+  const Dentry& de;
+  const RamFile& rf;
 public:
-  FileAccess(const RamFile& rf) : offset(0), rf(rf) {}
+  FileAccess(const Dentry& de) : offset(0), de(de), rf(*de.file) {}
   virtual ssize_t pread(void *buf, size_t nbyte, off_t o);
   virtual ssize_t read(void *buf, size_t nbyte);
+  virtual ssize_t readv(const struct iovec* iov, int cnt);
   virtual off_t lseek(off_t o, int whence);
+  virtual int mmap(AddressSpace& as, vaddr& addr, size_t len, bool writable, off_t o);
+  virtual int fstat(struct stat& st) { de.stat(st); return 0; }
+};
+
+class DirAccess : public Access {
+  SpinLock olock;
+  size_t offset;            // index of next entry
+  Dentry& de;
+public:
+  DirAccess(Dentry& de) : offset(0), de(de) {}
+  virtual off_t lseek(off_t o, int whence);
+  virtual int fstat(struct stat& st) { de.stat(st); return 0; }
+  virtual int readdir(struct dirent& ent);
+};
+
+// named shared memory objects, see shm_open
+extern SpinLock shmLock;
+extern map<string,PageFile*> shmFS;
+
+// tmpfs file or shared memory object; reference taken by creator
+class PageFileAccess : public Access {
+  Mutex olock;              // held across PageFile operations
+  off_t offset;
+  PageFile& pf;
+  bool readable, writable, append;
+public:
+  PageFileAccess(PageFile& pf, int oflag) : offset(0), pf(pf),
+    readable((oflag & O_ACCMODE) != O_WRONLY),
+    writable((oflag & O_ACCMODE) != O_RDONLY),
+    append(oflag & O_APPEND) {}
+  virtual ~PageFileAccess();
+  virtual ssize_t pread(void *buf, size_t nbyte, off_t o) {
+    return readable ? pf.pread(buf, nbyte, o) : -EBADF;
+  }
+  virtual ssize_t pwrite(const void *buf, size_t nbyte, off_t o) {
+    return writable ? pf.pwrite(buf, nbyte, o) : -EBADF;
+  }
+  virtual ssize_t preadv(const struct iovec* iov, int cnt, off_t o) {
+    return readable ? pf.preadv(iov, cnt, o) : -EBADF;
+  }
+  virtual ssize_t pwritev(const struct iovec* iov, int cnt, off_t o) {
+    return writable ? pf.pwritev(iov, cnt, o) : -EBADF;
+  }
+  virtual ssize_t read(void *buf, size_t nbyte);
+  virtual ssize_t write(const void *buf, size_t nbyte);
+  virtual ssize_t readv(const struct iovec* iov, int cnt);
+  virtual ssize_t writev(const struct iovec* iov, int cnt);
+  virtual off_t lseek(off_t o, int whence);
+  virtual int ftruncate(off_t length) {
+    return writable ? pf.truncate(length) : -EINVAL;
+  }
+  virtual int mmap(AddressSpace& as, vaddr& addr, size_t len, bool w, off_t o) {
+    if (w && !writable) return -EACCES;
+    return pf.mmap(as, addr, len, w, o);
+  }
+  virtual int fstat(struct stat& st) { pf.stat(st); return 0; }
 };
 
 class KernelOutput;
@@ -64,6 +137,11 @@ public:
   virtual ssize_t write(const void *buf, size_t nbyte) {
     return ko.write(buf, nbyte);
   }
+  virtual int fstat(struct stat& st) {
+    memset(&st, 0, sizeof(struct stat));
+    st.st_mode = S_IFCHR | 0222;
+    return 0;
+  }
 };
 
 extern Keyboard keyboard;
@@ -80,6 +158,11 @@ public:
     }
     return nbyte;
   }
+  virtual int fstat(struct stat& st) {
+    memset(&st, 0, sizeof(struct stat));
+    st.st_mode = S_IFCHR | 0444;
+    return 0;
+  }
 };
 
 #endif /* _Access_h_ */
@@ -0,0 +1,237 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/MemoryManager.h"
+#include "world/KernelFS.h"
+#include "world/PageFile.h"
+
+#include <cstring>
+#include <fcntl.h>
+
+KernelFS kernelFS;
+
+void Dentry::stat(struct stat& st) const {
+  if (pfile) {
+    pfile->stat(st);
+    return;
+  }
+  memset(&st, 0, sizeof(struct stat));
+  st.st_ino = ino;
+  st.st_nlink = 1;
+  st.st_blksize = pagesize<1>();
+  if (isDir()) {
+    st.st_mode = S_IFDIR | 0555;
+  } else {
+    st.st_mode = S_IFREG | 0444;
+    st.st_size = file->size;
+    st.st_blocks = divup(file->size, size_t(512));
+  }
+}
+
+size_t KernelFS::hash(const Dentry* parent, const char* name, size_t len) {
+  mword h = 14695981039346656037ull ^ (mword(parent) >> 4);  // FNV-1a
+  for (size_t i = 0; i < len; i += 1) h = (h ^ uint8_t(name[i])) * 1099511628211ull;
+  return h % hashSize;
+}
+
+Dentry* KernelFS::find(const Dentry* parent, const char* name, size_t len) const {
+  if (len > Dentry::NameMax) return nullptr;
+  Dentry* d = __atomic_load_n(&table[hash(parent, name, len)], __ATOMIC_ACQUIRE);
+  while (d) {
+    if (d->parent == parent && !strncmp(d->name, name, len) && d->name[len] == 0) return d;
+    d = __atomic_load_n(&d->hnext, __ATOMIC_ACQUIRE);
+  }
+  return nullptr;
+}
+
+// writer holds 'seq'
+Dentry* KernelFS::create(Dentry* parent, const char* name, size_t len, RamFile* file, PageFile* pfile) {
+  Dentry* d = freeList;
+  if (d) freeList = d->hnext;
+  else d = knew<Dentry>();
+  memcpy(d->name, name, len);
+  d->name[len] = 0;
+  d->parent = parent;
+  d->child = nullptr;
+  d->file = file;
+  d->pfile = pfile;
+  inodes += 1;
+  d->ino = inodes;
+  size_t h = hash(parent, name, len);
+  d->hnext = table[h];
+  d->sibling = parent->child;
+  __atomic_store_n(&table[h], d, __ATOMIC_RELEASE);
+  __atomic_store_n(&parent->child, d, __ATOMIC_RELEASE);
+  return d;
+}
+
+// writer holds 'seq'; unlink from hash chain and parent, then recycle
+void KernelFS::remove(Dentry* d) {
+  Dentry** pp = &table[hash(d->parent, d->name, strlen(d->name))];
+  while (*pp != d) pp = &(*pp)->hnext;
+  __atomic_store_n(pp, d->hnext, __ATOMIC_RELEASE);
+  pp = &d->parent->child;
+  while (*pp != d) pp = &(*pp)->sibling;
+  __atomic_store_n(pp, d->sibling, __ATOMIC_RELEASE);
+  d->file = nullptr;
+  d->pfile = nullptr;
+  d->hnext = freeList;
+  freeList = d;
+}
+
+// writer holds 'seq': find directory holding last component of path,
+// optionally creating missing directories; 'path' and 'len' are set to
+// the last component
+Dentry* KernelFS::parentOf(const char*& path, size_t& len, bool mkdirs) {
+  Dentry* d = &root;
+  for (;;) {
+    while (*path == '/') path += 1;
+    len = strcspn(path, "/");
+    if (len == 0 || len > Dentry::NameMax || !d->isDir()) return nullptr;
+    const char* next = path + len;
+    while (*next == '/') next += 1;
+    if (*next == 0) return d;                 // last component
+    Dentry* sub = find(d, path, len);
+    if (!sub && mkdirs) sub = create(d, path, len, nullptr, nullptr);
+    if (!sub) return nullptr;
+    d = sub;
+    path = next;
+  }
+}
+
+// Resolve path one component at a time; empty components and "." are
+// skipped, ".." moves to parent.  'valid' is cleared, if a concurrent
+// update was detected and the caller needs to retry.
+Dentry* KernelFS::walk(const char* path, bool& valid) const {
+  mword s = seq.readBegin();
+  const Dentry* d = &root;
+  while (*path) {
+    if (*path == '/') { path += 1; continue; }
+    size_t len = strcspn(path, "/");
+    if (len == 1 && path[0] == '.') {
+      // stay
+    } else if (len == 2 && path[0] == '.' && path[1] == '.') {
+      d = d->parent;
+    } else if (!d->isDir()) {
+      d = nullptr;
+    } else {
+      d = find(d, path, len);
+    }
+    if (!d || seq.readRetry(s)) break;
+    path += len;
+  }
+  valid = !seq.readRetry(s);
+  return const_cast<Dentry*>(d);
+}
+
+Dentry* KernelFS::lookup(const char* path) {
+  for (;;) {
+    bool valid;
+    Dentry* d = walk(path, valid);
+    if (valid) return d;
+  }
+}
+
+// Boot modules and directories are never freed and are read lock-free.
+// A PageFile may be freed by a concurrent unlink, so it is read under the
+// lock, provided no writer has intervened since the walk.
+bool KernelFS::stat(const char* path, struct stat& st) {
+  for (;;) {
+    mword s = seq.readBegin();
+    bool valid;
+    Dentry* d = walk(path, valid);
+    if (!valid) continue;
+    if (!d) return false;
+    if (!d->pfile) {
+      d->stat(st);                // may read recycled data -> validate below
+      if (!seq.readRetry(s)) return true;
+      continue;
+    }
+    ScopedLock<SeqLock> sl(seq);
+    if (!seq.readRetry(s + 1)) {  // only this writer since the walk
+      d->stat(st);
+      return true;
+    }
+  }
+}
+
+bool KernelFS::insert(const char* path, RamFile* file) {
+  ScopedLock<SeqLock> sl(seq);
+  size_t len;
+  Dentry* dir = parentOf(path, len, true);
+  if (!dir || find(dir, path, len)) return false;
+  create(dir, path, len, file, nullptr);
+  if (file) files += 1;
+  return true;
+}
+
+int KernelFS::open(const char* path, int oflag, PageFile*& pfile) {
+  ScopedLock<SeqLock> sl(seq);
+  size_t len;
+  Dentry* dir = parentOf(path, len, false);
+  if (!dir) return -ENOENT;
+  Dentry* d = find(dir, path, len);
+  if (d) {
+    if ((oflag & O_CREAT) && (oflag & O_EXCL)) return -EEXIST;
+    if (d->isDir()) return -EISDIR;
+    if (!d->pfile) return -EROFS;             // boot module
+    pfile = d->pfile;
+    pfile->attach();
+    return 0;
+  }
+  if (!(oflag & O_CREAT)) return -ENOENT;
+  pfile = knew<PageFile>(inodes + 1);         // ino assigned by 'create'
+  create(dir, path, len, nullptr, pfile);
+  files += 1;
+  pfile->attach();
+  return 0;
+}
+
+int KernelFS::unlink(const char* path) {
+  PageFile* pfile;
+  {
+    ScopedLock<SeqLock> sl(seq);
+    size_t len;
+    Dentry* dir = parentOf(path, len, false);
+    if (!dir) return -ENOENT;
+    Dentry* d = find(dir, path, len);
+    if (!d) return -ENOENT;
+    if (d->isDir()) return -EISDIR;
+    if (!d->pfile) return -EPERM;             // boot module
+    pfile = d->pfile;
+    remove(d);
+    files -= 1;
+  }
+  if (pfile->detach()) kdelete(pfile);
+  return 0;
+}
+
+bool KernelFS::entry(Dentry& dir, size_t n, mword& ino, bool& isDir, char* name) {
+  for (;;) {
+    mword s = seq.readBegin();
+    Dentry* d = __atomic_load_n(&dir.child, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; d && i < n && !seq.readRetry(s); i += 1) {
+      d = __atomic_load_n(&d->sibling, __ATOMIC_ACQUIRE);
+    }
+    if (d) {
+      ino = d->ino;
+      isDir = d->isDir();
+      memcpy(name, d->name, Dentry::NameMax + 1);
+      name[Dentry::NameMax] = 0;
+    }
+    if (!seq.readRetry(s)) return d != nullptr;
+  }
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _KernelFS_h_
+#define _KernelFS_h_ 1
+
+#include "machine/SpinLock.h"
+
+#include <sys/stat.h>
+
+class ElfImage;
+class PageFile;
+
+struct RamFile {
+  vaddr vma;
+  paddr pma;
+  size_t size;
+  ElfImage* image;            // parsed ELF headers, set by first exec
+  RamFile(vaddr v, paddr p, size_t s) : vma(v), pma(p), size(s), image(nullptr) {}
+};
+
+// Directory entry.  Dentries are never returned to the heap (unlinked ones
+// are recycled), so lock-free readers can follow stale pointers; they
+// validate with the sequence lock.
+struct Dentry {
+  static const size_t NameMax = 63;
+  Dentry*   hnext;            // hash chain or free list
+  Dentry*   parent;
+  Dentry*   child;            // first child, if directory
+  Dentry*   sibling;          // next child of parent
+  RamFile*  file;             // boot module (read-only)
+  PageFile* pfile;            // tmpfs file
+  mword     ino;
+  char      name[NameMax+1];
+  Dentry() : hnext(nullptr), parent(this), child(nullptr), sibling(nullptr),
+    file(nullptr), pfile(nullptr), ino(0) { name[0] = 0; }
+  bool isDir() const { return !file && !pfile; }
+  void stat(struct stat& st) const;
+};
+
+// hierarchical name space for boot modules: lookups hash (parent, name)
+// per path component and run without locks under a sequence lock
+class KernelFS {
+  static const size_t hashSize = 1024;
+
+  SeqLock seq;                // writers serialize, readers validate
+  Dentry  root;
+  Dentry* table[hashSize];
+  Dentry* freeList;
+  mword   inodes;
+  mword   files;
+
+  static size_t hash(const Dentry* parent, const char* name, size_t len);
+  Dentry* find(const Dentry* parent, const char* name, size_t len) const;
+  Dentry* create(Dentry* parent, const char* name, size_t len, RamFile* file, PageFile* pfile);
+  void remove(Dentry* d);
+  Dentry* walk(const char* path, bool& valid) const;
+  Dentry* parentOf(const char*& path, size_t& len, bool mkdirs);
+
+public:
+  KernelFS() : freeList(nullptr), inodes(1), files(0) {
+    for (size_t i = 0; i < hashSize; i += 1) table[i] = nullptr;
+    root.ino = inodes;
+  }
+  Dentry* lookup(const char* path);
+  bool stat(const char* path, struct stat& st);
+  // create file and missing parent directories; directory, if 'file' null
+  bool insert(const char* path, RamFile* file);
+  bool mkdir(const char* path) { return insert(path, nullptr); }
+  // open or create (O_CREAT) tmpfs file; returns file with reference held
+  int open(const char* path, int oflag, PageFile*& pfile);
+  int unlink(const char* path);
+  // copy name of n-th entry of directory; false at end
+  bool entry(Dentry& dir, size_t n, mword& ino, bool& isDir, char* name);
+  size_t size() const { return files; }
+};
+
+extern KernelFS kernelFS;
+
+#endif /* _KernelFS_h_ */
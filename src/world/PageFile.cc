@@ -0,0 +1,158 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/AddressSpace.h"
+#include "kernel/FrameManager.h"
+#include "world/PageFile.h"
+
+#include <cstring>
+
+mword PageFile::cachePages = 0;
+
+bool PageFile::fill(Page& p) {
+  if (p.kva) return true;
+  FrameManager& fm = *LocalProcessor::getFrameManager();
+  paddr pma = fm.allocFrame<1>();
+  if (pma == topaddr) return false;
+  vaddr kva = kernelSpace.kmap<1,false>(0, pagesize<1>(), pma);
+  memset((ptr_t)kva, 0, pagesize<1>());
+  fm.shareFrame(pma);
+  p.kva = kva;
+  p.pma = pma;
+  allocated += 1;
+  __atomic_add_fetch(&cachePages, 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+void PageFile::release(Page& p) {
+  if (!p.kva) return;
+  kernelSpace.unmap<1,false>(p.kva, pagesize<1>());
+  LocalProcessor::getFrameManager()->releaseShared(p.pma);
+  p.kva = 0;
+  allocated -= 1;
+  __atomic_sub_fetch(&cachePages, 1, __ATOMIC_RELAXED);
+}
+
+PageFile::~PageFile() {
+  for (Page& p : pages) release(p);
+}
+
+// lock held
+size_t PageFile::readAt(void *buf, size_t nbyte, size_t o) {
+  if (o >= size) return 0;
+  if (nbyte > size - o) nbyte = size - o;
+  for (size_t done = 0; done < nbyte; ) {
+    size_t idx = (o + done) / pagesize<1>();
+    size_t off = (o + done) % pagesize<1>();
+    size_t len = min(pagesize<1>() - off, nbyte - done);
+    if (pages[idx].kva) memcpy((bufptr_t)buf + done, (bufptr_t)(pages[idx].kva + off), len);
+    else memset((bufptr_t)buf + done, 0, len);
+    done += len;
+  }
+  return nbyte;
+}
+
+// lock held
+size_t PageFile::writeAt(const void *buf, size_t nbyte, size_t o) {
+  if (o >= MaxSize) return 0;
+  if (nbyte > MaxSize - o) nbyte = MaxSize - o;
+  size_t end = o + nbyte;
+  if (end > pages.size() * pagesize<1>()) pages.resize(divup(end, pagesize<1>()), {0, 0});
+  size_t done = 0;
+  while (done < nbyte) {
+    size_t idx = (o + done) / pagesize<1>();
+    size_t off = (o + done) % pagesize<1>();
+    size_t len = min(pagesize<1>() - off, nbyte - done);
+    if (!fill(pages[idx])) break;
+    memcpy((bufptr_t)(pages[idx].kva + off), (bufptr_t)buf + done, len);
+    done += len;
+  }
+  if (o + done > size) size = o + done;
+  return done;
+}
+
+ssize_t PageFile::preadv(const struct iovec* iov, int cnt, off_t o) {
+  if (o < 0) return -EINVAL;
+  ScopedLock<Mutex> sl(lock);
+  size_t total = 0;
+  for (int i = 0; i < cnt; i += 1) {
+    size_t len = readAt(iov[i].iov_base, iov[i].iov_len, o + total);
+    total += len;
+    if (len < iov[i].iov_len) break;
+  }
+  return total;
+}
+
+ssize_t PageFile::pwritev(const struct iovec* iov, int cnt, off_t o) {
+  if (o < 0) return -EINVAL;
+  ScopedLock<Mutex> sl(lock);
+  size_t total = 0;
+  for (int i = 0; i < cnt; i += 1) {
+    size_t len = writeAt(iov[i].iov_base, iov[i].iov_len, o + total);
+    total += len;
+    if (len < iov[i].iov_len) {
+      if (total) return total;
+      return (size_t(o) >= MaxSize) ? -EFBIG : -ENOSPC;
+    }
+  }
+  return total;
+}
+
+int PageFile::truncate(off_t length) {
+  if (length < 0) return -EINVAL;
+  if (size_t(length) > MaxSize) return -EFBIG;
+  ScopedLock<Mutex> sl(lock);
+  size_t count = divup(size_t(length), pagesize<1>());
+  while (pages.size() > count) {
+    release(pages.back());
+    pages.pop_back();
+  }
+  if (count > pages.size()) pages.resize(count, {0, 0}); // sparse growth
+  size_t tail = length % pagesize<1>();    // zero beyond new end
+  if (tail && size_t(length) < size && pages[count-1].kva) {
+    memset((ptr_t)(pages[count-1].kva + tail), 0, pagesize<1>() - tail);
+  }
+  size = length;
+  return 0;
+}
+
+int PageFile::mmap(AddressSpace& as, vaddr& addr, size_t len, bool writable, off_t o) {
+  FrameManager& fm = *LocalProcessor::getFrameManager();
+  ScopedLock<Mutex> sl(lock);
+  if (o < 0 || o + len > pages.size() * pagesize<1>()) return -ENXIO;
+  size_t first = o / pagesize<1>();
+  for (size_t i = first; i < first + divup(len, pagesize<1>()); i += 1) {
+    if (!fill(pages[i])) return -ENOMEM;   // no holes in shared mapping
+  }
+  vaddr va = as.mapShared<1>(addr, len, writable, [&](size_t i) {
+    paddr f = pages[first + i].pma;
+    fm.shareFrame(f);                        // reference held by mapping
+    return f;
+  });
+  if (va == topaddr) return -ENOMEM;
+  addr = va;
+  return 0;
+}
+
+void PageFile::stat(struct stat& st) const {
+  memset(&st, 0, sizeof(struct stat));
+  st.st_ino = ino;
+  st.st_mode = S_IFREG | 0666;
+  st.st_nlink = 1;
+  st.st_size = size;
+  st.st_blksize = pagesize<1>();
+  st.st_blocks = allocated * (pagesize<1>() / 512);
+}
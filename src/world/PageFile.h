@@ -0,0 +1,78 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _PageFile_h_
+#define _PageFile_h_ 1
+
+#include "runtime/BlockingSync.h"
+
+#include "uio.h"
+
+#include <vector>
+#include <sys/stat.h>
+
+class AddressSpace;
+
+// In-memory file made of page-cache frames: backs tmpfs files and named
+// shared memory.  Frames are allocated on first write or mapping (holes
+// read as zero), kept mapped in kernelSpace for read/write, and
+// reference-counted by FrameManager, so mappings outlive the file.
+class PageFile {
+  struct Page {
+    vaddr kva;              // kernel mapping, 0: hole
+    paddr pma;
+  };
+
+  Mutex lock;
+  vector<Page> pages;
+  size_t size;
+  size_t allocated;         // pages filled
+  mword refs;               // open handles, plus one while name is linked
+  mword ino;
+
+  static mword cachePages;  // page-cache frames in use, for reclamation
+  static const size_t MaxSize = size_t(256) << 20; // bounds dense 'pages'
+
+  bool fill(Page& p);
+  void release(Page& p);
+  size_t readAt(void *buf, size_t nbyte, size_t o);
+  size_t writeAt(const void *buf, size_t nbyte, size_t o);
+
+public:
+  PageFile(mword ino = 0) : size(0), allocated(0), refs(1), ino(ino) {}
+  ~PageFile();
+  void attach() { __atomic_add_fetch(&refs, 1, __ATOMIC_RELAXED); }
+  bool detach() { return __atomic_sub_fetch(&refs, 1, __ATOMIC_ACQ_REL) == 0; }
+  size_t getSize() { return size; }
+  static mword getCachePages() { return cachePages; }
+
+  // vectors are transferred under one lock acquisition
+  ssize_t preadv(const struct iovec* iov, int cnt, off_t o);
+  ssize_t pwritev(const struct iovec* iov, int cnt, off_t o);
+  ssize_t pread(void *buf, size_t nbyte, off_t o) {
+    struct iovec iov = { buf, nbyte };
+    return preadv(&iov, 1, o);
+  }
+  ssize_t pwrite(const void *buf, size_t nbyte, off_t o) {
+    struct iovec iov = { const_cast<void*>(buf), nbyte };
+    return pwritev(&iov, 1, o);
+  }
+  int truncate(off_t length);
+  int mmap(AddressSpace& as, vaddr& addr, size_t len, bool writable, off_t o);
+  void stat(struct stat& st) const;     // lock-free, see KernelFS::stat
+};
+
+#endif /* _PageFile_h_ */
@@ -0,0 +1,92 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "kernel/MemoryManager.h"
+#include "world/SocketAccess.h"
+
+// pending error of failed call as negative errno
+int SocketAccess::error() {
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (lwip_getsockopt(sd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) return -EBADF;
+  return err ? -err : -EIO;
+}
+
+SocketAccess::~SocketAccess() {
+  lwip_close(sd);
+}
+
+int SocketAccess::create(int domain, int type, int protocol, SocketAccess*& sa) {
+  if (domain != AF_INET) return -EAFNOSUPPORT;
+  if (type != SOCK_STREAM && type != SOCK_DGRAM && type != SOCK_RAW) return -EINVAL;
+  int sd = lwip_socket(domain, type, protocol);
+  if (sd < 0) return -ENOBUFS;                // no netconn or socket left
+  sa = knew<SocketAccess>(sd);
+  return 0;
+}
+
+int SocketAccess::fstat(struct stat& st) {
+  memset(&st, 0, sizeof(st));
+  st.st_mode = S_IFSOCK | 0666;
+  return 0;
+}
+
+int SocketAccess::bind(const struct sockaddr* addr, socklen_t addrlen) {
+  if (lwip_bind(sd, addr, addrlen) < 0) return error();
+  return 0;
+}
+
+int SocketAccess::listen(int backlog) {
+  if (lwip_listen(sd, backlog) < 0) return error();
+  return 0;
+}
+
+int SocketAccess::accept(struct sockaddr* addr, socklen_t* addrlen, SocketAccess*& sa) {
+  int nsd = lwip_accept(sd, addr, addrlen);
+  if (nsd < 0) return error();
+  sa = knew<SocketAccess>(nsd);
+  return 0;
+}
+
+int SocketAccess::connect(const struct sockaddr* addr, socklen_t addrlen) {
+  if (lwip_connect(sd, addr, addrlen) < 0) return error();
+  return 0;
+}
+
+ssize_t SocketAccess::send(const void* buf, size_t len, int flags) {
+  int ret = lwip_send(sd, buf, len, flags);
+  return ret < 0 ? error() : ret;
+}
+
+ssize_t SocketAccess::recv(void* buf, size_t len, int flags) {
+  int ret = lwip_recv(sd, buf, len, flags);
+  return ret < 0 ? error() : ret;
+}
+
+ssize_t SocketAccess::sendto(const void* buf, size_t len, int flags, const struct sockaddr* addr, socklen_t addrlen) {
+  int ret = lwip_sendto(sd, buf, len, flags, addr, addrlen);
+  return ret < 0 ? error() : ret;
+}
+
+ssize_t SocketAccess::recvfrom(void* buf, size_t len, int flags, struct sockaddr* addr, socklen_t* addrlen) {
+  int ret = lwip_recvfrom(sd, buf, len, flags, addr, addrlen);
+  return ret < 0 ? error() : ret;
+}
+
+int SocketAccess::setsockopt(int level, int optname, const void* optval, socklen_t optlen) {
+  if (lwip_setsockopt(sd, level, optname, optval, optlen) < 0) return error();
+  return 0;
+}
@@ -0,0 +1,49 @@
+/******************************************************************************
+    Copyright  2012-2015 Martin Karsten
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef _SocketAccess_h_
+#define _SocketAccess_h_ 1
+
+#include "world/Access.h"
+
+#include "socket.h"
+
+// socket descriptor backed by an lwIP socket; lwIP reports errors through
+// a global 'errno', so they are retrieved per socket via SO_ERROR instead
+class SocketAccess : public Access {
+  int sd;                     // lwIP socket descriptor
+  int error();
+public:
+  SocketAccess(int sd) : sd(sd) {}
+  virtual ~SocketAccess();
+  static int create(int domain, int type, int protocol, SocketAccess*& sa);
+  virtual SocketAccess* socket() { return this; }
+  virtual ssize_t read(void *buf, size_t nbyte) { return recv(buf, nbyte, 0); }
+  virtual ssize_t write(const void *buf, size_t nbyte) { return send(buf, nbyte, 0); }
+  virtual int fstat(struct stat& st);
+
+  int bind(const struct sockaddr* addr, socklen_t addrlen);
+  int listen(int backlog);
+  int accept(struct sockaddr* addr, socklen_t* addrlen, SocketAccess*& sa);
+  int connect(const struct sockaddr* addr, socklen_t addrlen);
+  ssize_t send(const void* buf, size_t len, int flags);
+  ssize_t recv(void* buf, size_t len, int flags);
+  ssize_t sendto(const void* buf, size_t len, int flags, const struct sockaddr* addr, socklen_t addrlen);
+  ssize_t recvfrom(void* buf, size_t len, int flags, struct sockaddr* addr, socklen_t* addrlen);
+  int setsockopt(int level, int optname, const void* optval, socklen_t optlen);
+};
+
+#endif /* _SocketAccess_h_ */